@@ -0,0 +1,42 @@
+/**
+ * @file allocation_counter.hpp
+ * @brief Definition of the AllocationCounter class.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#ifndef ORB_WRAPPER_ALLOCATION_COUNTER_HPP_
+#define ORB_WRAPPER_ALLOCATION_COUNTER_HPP_
+
+namespace ORB_SLAM3_Wrapper
+{
+    /**
+     * @brief Number and size of heap allocations.
+     */
+    struct AllocationCount
+    {
+        unsigned long long allocations = 0;
+        unsigned long long bytes = 0;
+    };
+
+    /**
+     * @brief Counts the heap allocations of every thread.
+     * The global operator new is replaced in the executables which link allocation_counter.cpp, so the
+     * allocations of ORB-SLAM3, OpenCV, Eigen and rclcpp through new are all counted, on the thread which made
+     * them. Buffers allocated with malloc directly (e.g. cv::Mat data) are not counted.
+     * Counting is off by default, then the only cost per allocation is reading a flag.
+     */
+    class AllocationCounter
+    {
+    public:
+        static void setEnabled(bool enabled);
+
+        static bool isEnabled();
+
+        /**
+         * @brief Returns the allocations made by the calling thread while counting was enabled.
+         */
+        static AllocationCount thread();
+    };
+}
+
+#endif
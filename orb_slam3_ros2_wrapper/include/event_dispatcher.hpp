@@ -0,0 +1,220 @@
+/**
+ * @file event_dispatcher.hpp
+ * @brief Definition of the EventDispatcher class and the events of the in-process subscriber API.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#ifndef ORB_WRAPPER_EVENT_DISPATCHER_HPP_
+#define ORB_WRAPPER_EVENT_DISPATCHER_HPP_
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include <sensor_msgs/msg/image.hpp>
+
+#include "occupancy_grid_builder.hpp"
+
+namespace ORB_SLAM3_Wrapper
+{
+    /**
+     * @brief Camera pose of a tracked frame in the global frame.
+     */
+    struct TrackedPoseEvent
+    {
+        double stamp = 0.0;
+        Eigen::Affine3d pose;
+
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    };
+
+    /**
+     * @brief A keyframe was inserted. The images are the messages the keyframe was created from.
+     */
+    struct KeyFrameEvent
+    {
+        long unsigned int kFId = 0;
+        double stamp = 0.0;
+        Eigen::Affine3d pose;
+        sensor_msgs::msg::Image::ConstSharedPtr rgb;
+        sensor_msgs::msg::Image::ConstSharedPtr depth;
+
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    };
+
+    /**
+     * @brief Loop closure, map merge or global BA changed the current map.
+     * The poses are shared by all subscribers and must not be modified.
+     */
+    struct MapCorrectedEvent
+    {
+        unsigned long referencePosesVersion = 0;
+        std::shared_ptr<const KeyFramePoses> keyFramePoses;
+    };
+
+    /**
+     * @brief The tracking state or the mode of the tracker changed.
+     */
+    struct StatusEvent
+    {
+        // ORB_SLAM3::Tracking::eTrackingState
+        int trackingState = 0;
+        bool localizationMode = false;
+        int trackedInliers = 0;
+    };
+
+    /**
+     * @brief Statistics of a subscription.
+     */
+    struct SubscriptionStatistics
+    {
+        unsigned long delivered = 0;
+        unsigned long dropped = 0;
+    };
+
+    /**
+     * @brief Delivers tracker events to in-process consumers without serialization.
+     * Every subscription has a bounded queue. Publishing never blocks: if a queue is full, its oldest event is dropped.
+     * All callbacks are invoked from one dispatch thread, taking turns between the subscriptions, so a slow consumer
+     * only delays the other consumers and never the tracking thread.
+     */
+    class EventDispatcher
+    {
+    public:
+        typedef uint64_t SubscriptionId;
+
+        EventDispatcher();
+        ~EventDispatcher();
+
+        SubscriptionId subscribe(std::function<void(const TrackedPoseEvent &)> callback, size_t queueSize);
+        SubscriptionId subscribe(std::function<void(const KeyFrameEvent &)> callback, size_t queueSize);
+        SubscriptionId subscribe(std::function<void(const MapCorrectedEvent &)> callback, size_t queueSize);
+        SubscriptionId subscribe(std::function<void(const StatusEvent &)> callback, size_t queueSize);
+
+        /**
+         * @brief Removes a subscription. Its callback is not invoked anymore once this returns,
+         * unless it is running at the moment.
+         */
+        void unsubscribe(SubscriptionId id);
+
+        void publish(const TrackedPoseEvent &event);
+        void publish(const KeyFrameEvent &event);
+        void publish(const MapCorrectedEvent &event);
+        void publish(const StatusEvent &event);
+
+        /**
+         * @brief True if anybody listens to the events of the given type, to skip building unused events.
+         */
+        template <typename Event>
+        bool hasSubscribers()
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return channel<Event>().size() > 0;
+        }
+
+        std::map<SubscriptionId, SubscriptionStatistics> getStatistics();
+
+    private:
+        struct Subscription
+        {
+            SubscriptionId id;
+            size_t queueSize;
+            std::deque<std::function<void()>> pending;
+            SubscriptionStatistics statistics;
+        };
+
+        template <typename Event>
+        using Channel = std::vector<std::pair<std::shared_ptr<Subscription>, std::function<void(const Event &)>>>;
+
+        template <typename Event>
+        Channel<Event> &channel();
+
+        template <typename Event>
+        SubscriptionId addSubscription(std::function<void(const Event &)> callback, size_t queueSize)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto subscription = std::make_shared<Subscription>();
+            subscription->id = nextId_++;
+            subscription->queueSize = std::max<size_t>(1, queueSize);
+            channel<Event>().emplace_back(subscription, callback);
+            subscriptions_[subscription->id] = subscription;
+            return subscription->id;
+        }
+
+        template <typename Event>
+        void enqueue(const Event &event)
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            Channel<Event> &subscribers = channel<Event>();
+            if (subscribers.empty())
+            {
+                return;
+            }
+            // one copy of the event is shared by all subscribers.
+            std::shared_ptr<const Event> shared = std::allocate_shared<Event>(Eigen::aligned_allocator<Event>(), event);
+            for (auto &subscriber : subscribers)
+            {
+                Subscription &subscription = *subscriber.first;
+                if (subscription.pending.size() >= subscription.queueSize)
+                {
+                    subscription.pending.pop_front();
+                    subscription.statistics.dropped++;
+                }
+                auto callback = subscriber.second;
+                subscription.pending.emplace_back([callback, shared]()
+                                                  { callback(*shared); });
+            }
+            lock.unlock();
+            condition_.notify_one();
+        }
+
+        void run();
+
+        std::mutex mutex_;
+        std::condition_variable condition_;
+        SubscriptionId nextId_;
+        std::map<SubscriptionId, std::shared_ptr<Subscription>> subscriptions_;
+        Channel<TrackedPoseEvent> trackedPoseSubscribers_;
+        Channel<KeyFrameEvent> keyFrameSubscribers_;
+        Channel<MapCorrectedEvent> mapCorrectedSubscribers_;
+        Channel<StatusEvent> statusSubscribers_;
+        bool stop_;
+        std::thread worker_;
+    };
+
+    template <>
+    inline EventDispatcher::Channel<TrackedPoseEvent> &EventDispatcher::channel<TrackedPoseEvent>()
+    {
+        return trackedPoseSubscribers_;
+    }
+
+    template <>
+    inline EventDispatcher::Channel<KeyFrameEvent> &EventDispatcher::channel<KeyFrameEvent>()
+    {
+        return keyFrameSubscribers_;
+    }
+
+    template <>
+    inline EventDispatcher::Channel<MapCorrectedEvent> &EventDispatcher::channel<MapCorrectedEvent>()
+    {
+        return mapCorrectedSubscribers_;
+    }
+
+    template <>
+    inline EventDispatcher::Channel<StatusEvent> &EventDispatcher::channel<StatusEvent>()
+    {
+        return statusSubscribers_;
+    }
+}
+
+#endif
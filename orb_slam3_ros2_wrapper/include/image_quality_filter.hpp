@@ -0,0 +1,95 @@
+/**
+ * @file image_quality_filter.hpp
+ * @brief Definition of the ImageQualityFilter class.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#ifndef ORB_WRAPPER_IMAGE_QUALITY_FILTER_HPP_
+#define ORB_WRAPPER_IMAGE_QUALITY_FILTER_HPP_
+
+#include <opencv2/core/core.hpp>
+
+namespace ORB_SLAM3_Wrapper
+{
+    /**
+     * @brief Quality measures of a single frame.
+     */
+    struct ImageQuality
+    {
+        // variance of the Laplacian, low for motion blur and defocus.
+        double sharpness = 0.0;
+        // fraction of the pixels which are saturated or black.
+        double clipped = 0.0;
+        // fraction of the grid cells with enough contrast for features.
+        double textured = 0.0;
+        // fraction of the depth pixels with a valid reading.
+        double validDepth = 0.0;
+    };
+
+    /**
+     * @brief Statistics of the image quality filter.
+     */
+    struct ImageQualityStatistics
+    {
+        unsigned long frames = 0;
+        unsigned long skipped = 0;
+        // a frame may fail several checks, it is counted for each.
+        unsigned long blurred = 0;
+        unsigned long badExposure = 0;
+        unsigned long textureless = 0;
+        unsigned long badDepth = 0;
+        ImageQuality last;
+    };
+
+    /**
+     * @brief Rejects frames which are too blurred, badly exposed, textureless or without depth to be tracked.
+     * The measures are computed on a nearest neighbour downsampled gray image (and depth image) with the
+     * vectorized OpenCV primitives, which takes a small fraction of a millisecond at VGA. The sharpness is judged
+     * relative to its running average over the accepted frames, as its absolute value depends on the scene.
+     * At most maxConsecutiveSkips frames are rejected in a row, so a lasting bad condition (e.g. a dark room)
+     * degrades to tracking at a lower rate instead of not tracking at all.
+     */
+    class ImageQualityFilter
+    {
+    public:
+        /**
+         * @param minSharpnessRatio Minimum sharpness relative to the running average.
+         * @param maxClipped Maximum fraction of saturated or black pixels.
+         * @param minTextured Minimum fraction of grid cells with contrast.
+         * @param minValidDepth Minimum fraction of pixels with valid depth.
+         * @param maxConsecutiveSkips Maximum number of frames rejected in a row.
+         */
+        ImageQualityFilter(double minSharpnessRatio, double maxClipped, double minTextured, double minValidDepth, int maxConsecutiveSkips);
+
+        /**
+         * @brief Measures the frame and decides whether it is tracked.
+         * @param image Color or gray image (8 bit).
+         * @param depth Depth image (16 bit in millimeters or 32 bit float in meters).
+         * @return True if the frame should be passed to ORB-SLAM3.
+         */
+        bool admitFrame(const cv::Mat &image, const cv::Mat &depth);
+
+        ImageQualityStatistics getStatistics();
+
+    private:
+        void measure(const cv::Mat &image, const cv::Mat &depth, ImageQuality &quality);
+
+        double minSharpnessRatio_;
+        double maxClipped_;
+        double minTextured_;
+        double minValidDepth_;
+        int maxConsecutiveSkips_;
+
+        int consecutiveSkips_;
+        double averageSharpness_;
+        bool hasAverageSharpness_;
+        ImageQualityStatistics statistics_;
+        // reused for every frame.
+        cv::Mat small_;
+        cv::Mat gray_;
+        cv::Mat laplacian_;
+        cv::Mat smallDepth_;
+    };
+}
+
+#endif
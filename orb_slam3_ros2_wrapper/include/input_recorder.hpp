@@ -0,0 +1,147 @@
+/**
+ * @file input_recorder.hpp
+ * @brief Definition of the InputRecorder and InputLogReader classes.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#ifndef ORB_WRAPPER_INPUT_RECORDER_HPP_
+#define ORB_WRAPPER_INPUT_RECORDER_HPP_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/StdDeque>
+
+#include "sensor_msgs/msg/image.hpp"
+#include "sophus/se3.hpp"
+#include "ImuTypes.h"
+
+namespace ORB_SLAM3_Wrapper
+{
+    /**
+     * @brief Everything ORB-SLAM3 got for a single TrackRGBD call and what it returned.
+     */
+    struct RecordedFrame
+    {
+        // position of the frame in the recording, gaps are frames dropped by a full queue.
+        uint64_t sequence = 0;
+        // steady clock time the frame was handed to the tracker, relative to the first frame.
+        int64_t receiveNs = 0;
+        sensor_msgs::msg::Image::ConstSharedPtr rgb;
+        sensor_msgs::msg::Image::ConstSharedPtr depth;
+        // the IMU measurements of the frame, as passed to TrackRGBD.
+        std::vector<ORB_SLAM3::IMU::Point> imu;
+        double imuSlicingMs = 0.0;
+        double trackMs = 0.0;
+        // ORB_SLAM3::Tracking::eTrackingState after the frame.
+        int trackingState = 0;
+        // pose returned by TrackRGBD, before it is moved to the global frame.
+        Sophus::SE3f Tcw;
+
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    };
+
+    /**
+     * @brief Statistics of the input recorder.
+     */
+    struct InputRecorderStatistics
+    {
+        unsigned long frames = 0;
+        unsigned long dropped = 0;
+        unsigned long pending = 0;
+        unsigned long long bytes = 0;
+        bool failed = false;
+    };
+
+    /**
+     * @brief Records the inputs of the tracker after synchronization, so a run can be replayed offline with exactly
+     * the same images, IMU slices and stamps.
+     * The frames are queued by the tracking thread and encoded and written by a background thread. If the disk can
+     * not keep up, frames are dropped (and show up as gaps in the sequence numbers) instead of delaying the tracking.
+     *
+     * File format, in host byte order: the header "ORBREC01" followed by one record per frame of
+     *  - sequence (uint64), receive time (int64 ns), IMU slicing and tracking time (2 float64 ms),
+     *    tracking state (int32), Tcw (7 float32 in Sophus order qx qy qz qw tx ty tz),
+     *  - the number of IMU measurements (uint32) and per measurement t (float64), a and w (3 float32 each),
+     *  - the RGB and the depth image: stamp (int32 sec, uint32 nanosec), frame_id, encoding (uint32 length and
+     *    characters each), height, width, step (uint32), is_bigendian (uint8), codec (uint8, 0 raw, 1 PNG),
+     *    payload size (uint64) and payload.
+     * PNG is lossless, the payload always decodes to the original bytes of the message data.
+     */
+    class InputRecorder
+    {
+    public:
+        /**
+         * @param path File the frames are written to, an existing file is renamed to path.old.
+         * @param compressionLevel PNG compression level (0-9) of the images, negative stores them raw.
+         * @param maxQueuedFrames Frames waiting to be written before new frames are dropped.
+         */
+        InputRecorder(const std::string &path, int compressionLevel, size_t maxQueuedFrames);
+        ~InputRecorder();
+
+        /**
+         * @brief Queues a frame. Never blocks on the disk.
+         * @param frame The frame, sequence and receiveNs are assigned by the recorder.
+         * @param receiveTime Time the frame was handed to the tracker.
+         */
+        void record(RecordedFrame &frame, std::chrono::steady_clock::time_point receiveTime);
+
+        InputRecorderStatistics getStatistics();
+
+    private:
+        void run();
+        void writeFrame(const RecordedFrame &frame, std::vector<unsigned char> &buffer);
+        void appendImage(const sensor_msgs::msg::Image &image, std::vector<unsigned char> &buffer);
+
+        std::string path_;
+        int compressionLevel_;
+        size_t maxQueuedFrames_;
+        std::FILE *file_;
+        uint64_t nextSequence_;
+        bool started_;
+        std::chrono::steady_clock::time_point startTime_;
+
+        std::mutex queueMutex_;
+        std::condition_variable queueCondition_;
+        std::deque<RecordedFrame, Eigen::aligned_allocator<RecordedFrame>> queue_;
+        InputRecorderStatistics statistics_;
+        bool stop_;
+        std::thread worker_;
+    };
+
+    /**
+     * @brief Reads the frames of a file written by the InputRecorder.
+     */
+    class InputLogReader
+    {
+    public:
+        InputLogReader();
+        ~InputLogReader();
+
+        /**
+         * @return False if the file can not be opened or is not an input recording.
+         */
+        bool open(const std::string &path);
+
+        /**
+         * @brief Reads and decodes the next frame.
+         * @return False at the end of the file or if the record is truncated.
+         */
+        bool next(RecordedFrame &frame);
+
+    private:
+        bool readImage(sensor_msgs::msg::Image::ConstSharedPtr &image);
+
+        std::FILE *file_;
+    };
+}
+
+#endif
@@ -0,0 +1,156 @@
+/**
+ * @file keyframe_image_cache.hpp
+ * @brief Definition of the KeyFrameImageCache class.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#ifndef ORB_WRAPPER_KEYFRAME_IMAGE_CACHE_HPP_
+#define ORB_WRAPPER_KEYFRAME_IMAGE_CACHE_HPP_
+
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+namespace ORB_SLAM3_Wrapper
+{
+    /**
+     * @brief Decoded images of a keyframe.
+     */
+    struct KeyFrameImages
+    {
+        long unsigned int kFId = 0;
+        double stamp = 0.0;
+        std::string rgbEncoding;
+        std::string depthEncoding;
+        cv::Mat rgb;
+        cv::Mat depth;
+    };
+
+    /**
+     * @brief Statistics of the keyframe image cache.
+     */
+    struct KeyFrameImageCacheStatistics
+    {
+        unsigned long entries = 0;
+        unsigned long spilledEntries = 0;
+        size_t bytes = 0;
+        // uncompressed and compressed size of all images inserted so far.
+        size_t insertedRawBytes = 0;
+        size_t insertedBytes = 0;
+        unsigned long hits = 0;
+        unsigned long misses = 0;
+        // keyframes waiting for the compression, and keyframes dropped because the queue was full.
+        unsigned long pending = 0;
+        unsigned long dropped = 0;
+    };
+
+    /**
+     * @brief Bounded LRU cache of the RGB-D input images behind each keyframe.
+     * The images are PNG compressed, which is lossless for 8 bit colour and 16 bit depth images. Float depth images
+     * are stored bit exact by compressing their bytes as a 4 channel image. When the memory budget is exceeded the
+     * least recently used entries are written to the spill directory, or dropped if there is none.
+     * The compression and the spilling run on a background thread, the caller only copies the raw images. The cache
+     * lock is held for the updates of the index, readers are never blocked by the encoder or by a spill file.
+     */
+    class KeyFrameImageCache
+    {
+    public:
+        /**
+         * @param maxBytes Memory budget of the compressed images, 0 disables the cache.
+         * @param spillDirectory Directory for entries evicted from memory, empty drops them.
+         * @param compressionLevel PNG compression level (0-9).
+         */
+        KeyFrameImageCache(size_t maxBytes, const std::string &spillDirectory, int compressionLevel = 1);
+        ~KeyFrameImageCache();
+
+        bool isEnabled();
+
+        /**
+         * @brief Queues the images of a keyframe for the compression. Never blocks on the encoder or the disk.
+         * @return False if the cache is disabled or the queue is full.
+         */
+        bool insert(long unsigned int kFId, double stamp,
+                    const cv::Mat &rgb, const std::string &rgbEncoding,
+                    const cv::Mat &depth, const std::string &depthEncoding);
+
+        /**
+         * @brief Decodes the images of a keyframe, reading them back from the spill directory if needed.
+         * @return False if the keyframe is not cached.
+         */
+        bool get(long unsigned int kFId, KeyFrameImages &images);
+
+        KeyFrameImageCacheStatistics getStatistics();
+
+    private:
+        struct Entry
+        {
+            long unsigned int kFId = 0;
+            double stamp = 0.0;
+            std::string rgbEncoding;
+            std::string depthEncoding;
+            int rgbType = 0;
+            int depthType = 0;
+            std::vector<uchar> rgb;
+            std::vector<uchar> depth;
+            std::string spillPath;
+            // evicted, but the spill file is not written yet, the buffers are still valid.
+            bool spilling = false;
+
+            size_t bytes() const
+            {
+                return rgb.size() + depth.size();
+            }
+        };
+
+        struct Job
+        {
+            long unsigned int kFId;
+            double stamp;
+            cv::Mat rgb;
+            std::string rgbEncoding;
+            cv::Mat depth;
+            std::string depthEncoding;
+        };
+
+        void run();
+        void store(const Job &job);
+        bool encode(const cv::Mat &image, std::vector<uchar> &buffer);
+        bool decode(const std::vector<uchar> &buffer, int type, cv::Mat &image);
+        void touch(long unsigned int kFId);
+        /**
+         * @brief Evicts entries until the budget is met and spills them outside of the cache lock.
+         * @note Only called by the worker thread.
+         */
+        void evict();
+        bool spill(const Entry &entry);
+        bool unspill(Entry &entry);
+
+        size_t maxBytes_;
+        std::string spillDirectory_;
+        int compressionLevel_;
+
+        std::mutex queueMutex_;
+        std::condition_variable queueCondition_;
+        std::deque<Job> queue_;
+        // a reader brought a spilled entry back, the worker evicts again.
+        bool evictRequested_;
+        bool stop_;
+        unsigned long dropped_;
+        std::thread worker_;
+
+        std::mutex cacheMutex_;
+        // most recently used keyframe first.
+        std::list<long unsigned int> lru_;
+        std::unordered_map<long unsigned int, std::pair<Entry, std::list<long unsigned int>::iterator>> entries_;
+        KeyFrameImageCacheStatistics statistics_;
+    };
+}
+
+#endif
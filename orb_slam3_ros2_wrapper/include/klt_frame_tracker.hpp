@@ -0,0 +1,104 @@
+/**
+ * @file klt_frame_tracker.hpp
+ * @brief Definition of the KltFrameTracker class.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#ifndef ORB_WRAPPER_KLT_FRAME_TRACKER_HPP_
+#define ORB_WRAPPER_KLT_FRAME_TRACKER_HPP_
+
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "sophus/se3.hpp"
+
+namespace ORB_SLAM3_Wrapper
+{
+    /**
+     * @brief Statistics of the intermediate frame tracking.
+     */
+    struct KltTrackerStatistics
+    {
+        unsigned long frames = 0;
+        // frames handed back to ORB-SLAM3 because too few points survived.
+        unsigned long failed = 0;
+        unsigned long lastPoints = 0;
+        unsigned long lastInliers = 0;
+    };
+
+    /**
+     * @brief Tracks the frames between two ORB-SLAM3 frames by optical flow.
+     * After every frame tracked by ORB-SLAM3 the tracked map points and their keypoints become the reference. The
+     * following frames follow the points with pyramidal Lucas-Kanade from the previous frame and solve the
+     * camera pose from the 2D-3D matches with RANSAC PnP, starting from the previous pose. Only the inliers are
+     * followed into the next frame, so the point set shrinks until the next ORB-SLAM3 frame refreshes it.
+     * The keypoints are the undistorted ones of ORB-SLAM3, so the images are expected to be rectified, which is
+     * the case for the usual RGB-D drivers.
+     */
+    class KltFrameTracker
+    {
+    public:
+        /**
+         * @param fx Focal length in pixels.
+         * @param fy Focal length in pixels.
+         * @param cx Principal point in pixels.
+         * @param cy Principal point in pixels.
+         * @param minInliers Below this number of PnP inliers the frame is not tracked.
+         * @param maxReprojectionError RANSAC inlier threshold in pixels.
+         */
+        KltFrameTracker(float fx, float fy, float cx, float cy, int minInliers, double maxReprojectionError);
+
+        /**
+         * @brief Sets a frame tracked by ORB-SLAM3 as the reference of the following frames.
+         * @param image Color or gray image of the frame.
+         * @param Tcw Tracked pose of the camera (ORB-SLAM3 convention, world to camera).
+         * @param keyPoints Positions of the tracked map points in the image.
+         * @param mapPoints World positions of the tracked map points.
+         */
+        void setReference(const cv::Mat &image, const Sophus::SE3f &Tcw, const std::vector<cv::Point2f> &keyPoints,
+                          const std::vector<cv::Point3f> &mapPoints);
+
+        /**
+         * @brief Forgets the reference, e.g. when ORB-SLAM3 lost tracking.
+         */
+        void reset();
+
+        bool hasReference();
+
+        /**
+         * @brief Tracks a frame following the reference.
+         * @param image Color or gray image of the frame.
+         * @param Tcw Pose of the camera if tracked.
+         * @return False if too few points could be followed, the frame then needs ORB-SLAM3.
+         */
+        bool track(const cv::Mat &image, Sophus::SE3f &Tcw);
+
+        KltTrackerStatistics getStatistics();
+
+    private:
+        void toGray(const cv::Mat &image, cv::Mat &gray);
+
+        cv::Mat cameraMatrix_;
+        int minInliers_;
+        double maxReprojectionError_;
+
+        bool hasReference_;
+        Sophus::SE3f lastTcw_;
+        std::vector<cv::Mat> lastPyramid_;
+        std::vector<cv::Point2f> lastPoints_;
+        std::vector<cv::Point3f> mapPoints_;
+        KltTrackerStatistics statistics_;
+        // reused for every frame.
+        cv::Mat gray_;
+        std::vector<cv::Mat> pyramid_;
+        std::vector<cv::Point2f> points_;
+        std::vector<unsigned char> status_;
+        std::vector<float> error_;
+        std::vector<cv::Point2f> matchedPoints_;
+        std::vector<cv::Point3f> matchedMapPoints_;
+        std::vector<int> inliers_;
+    };
+}
+
+#endif
@@ -0,0 +1,73 @@
+/**
+ * @file map_output_cache.hpp
+ * @brief Definition of the MapOutputCache class.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#ifndef ORB_WRAPPER_MAP_OUTPUT_CACHE_HPP_
+#define ORB_WRAPPER_MAP_OUTPUT_CACHE_HPP_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <rclcpp/rclcpp.hpp>
+
+#include "map_type_adapters.hpp"
+
+namespace ORB_SLAM3_Wrapper
+{
+    /**
+     * @brief The map point and keyframe pose exports, kept across publishes and shared with intra-process subscribers.
+     * They are only rebuilt for a new version of the reference poses. A publish then only allocates the two published
+     * arrays (header and pointer), rclcpp hands them to the subscriptions, which free them.
+     */
+    class MapOutputCache
+    {
+    public:
+        /**
+         * @brief Rebuilds the exports if the version changed since the last call.
+         * @param version Version of the reference poses, see ORBSLAM3Interface::getReferencePosesVersion.
+         * @param exportMap Called as exportMap(points, poses) to fill the map points and the keyframe poses in the
+         * global frame. The points are those of the last export if no subscriber holds them anymore.
+         */
+        template <typename ExportMap>
+        void update(unsigned long version, ExportMap exportMap)
+        {
+            if (version == version_)
+            {
+                return;
+            }
+            std::vector<Eigen::Vector3f> &points = preparePoints();
+            // a new map of poses, the previous one may still be held by intra-process subscribers.
+            auto poses = std::make_shared<KeyFramePoses>();
+            exportMap(points, *poses);
+            mapPoints_.points = points_;
+            keyFramePoses_.poses = poses;
+            version_ = version;
+        }
+
+        /**
+         * @brief Publishes the exports, only the headers and the pointers to the points and the poses are copied.
+         */
+        void publish(const rclcpp::Time &stamp, const std::string &frameId,
+                     rclcpp::Publisher<MapPointArrayAdapter> &mapPointsPub,
+                     rclcpp::Publisher<KeyFramePoseArrayAdapter> &keyFramePosesPub);
+
+        const MapPointArray &getMapPoints();
+        const KeyFramePoseArray &getKeyFramePoses();
+
+    private:
+        /**
+         * @brief Returns the points of the last export, or new ones with the same capacity if subscribers still hold them.
+         */
+        std::vector<Eigen::Vector3f> &preparePoints();
+
+        unsigned long version_ = 0;
+        std::shared_ptr<std::vector<Eigen::Vector3f>> points_;
+        MapPointArray mapPoints_;
+        KeyFramePoseArray keyFramePoses_;
+    };
+}
+
+#endif
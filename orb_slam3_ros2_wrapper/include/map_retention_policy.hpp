@@ -0,0 +1,116 @@
+/**
+ * @file map_retention_policy.hpp
+ * @brief Definition of the MapRetentionPolicy class.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#ifndef ORB_WRAPPER_MAP_RETENTION_POLICY_HPP_
+#define ORB_WRAPPER_MAP_RETENTION_POLICY_HPP_
+
+#include <cstddef>
+#include <vector>
+
+#include "Atlas.h"
+#include "Map.h"
+#include "KeyFrame.h"
+#include "MapPoint.h"
+
+namespace ORB_SLAM3_Wrapper
+{
+    /**
+     * @brief Estimated memory footprint of the live atlas, i.e. of the elements which are not flagged bad.
+     */
+    struct MemoryUsage
+    {
+        unsigned long maps = 0;
+        unsigned long keyFrames = 0;
+        unsigned long mapPoints = 0;
+        size_t keyFrameBytes = 0;
+        size_t mapPointBytes = 0;
+
+        size_t totalBytes() const
+        {
+            return keyFrameBytes + mapPointBytes;
+        }
+    };
+
+    /**
+     * @brief Statistics of the evictions done by the retention policy.
+     */
+    struct RetentionStatistics
+    {
+        unsigned long evictedKeyFrames = 0;
+        unsigned long evictedMapPoints = 0;
+        // estimated size of the evicted elements. ORB-SLAM3 never deletes bad elements, so it is still allocated.
+        size_t evictedBytes = 0;
+        unsigned long runs = 0;
+    };
+
+    /**
+     * @brief Keeps the atlas within a memory budget.
+     * When the budget is exceeded, weak landmarks (seen by few keyframes) are removed first, then redundant keyframes,
+     * i.e. keyframes whose map points are mostly seen by other keyframes, as it happens in densely revisited areas.
+     * Keyframes are removed through KeyFrame::SetBadFlag, which reconnects the spanning tree the same way the
+     * keyframe culling of LocalMapping does. Origin keyframes, keyframes with loop edges and the recent keyframes
+     * LocalMapping still works on are never removed.
+     * Like the culling of ORB-SLAM3, SetBadFlag only detaches the elements from the maps, the tracker and the loop
+     * closing may still point to them. The budget therefore bounds the live atlas, which drives the per frame cost
+     * of the reference poses and the exports, not the resident memory of the process.
+     */
+    class MapRetentionPolicy
+    {
+    public:
+        /**
+         * @param memoryBudgetBytes Memory budget of the atlas, 0 disables the eviction.
+         * @param redundancyThreshold Fraction of map points seen by other keyframes above which a keyframe is redundant.
+         * @param minObservations Landmarks observed by fewer keyframes are evicted.
+         * @param protectedKeyFrames Number of most recent keyframes of the current map which are never touched.
+         */
+        MapRetentionPolicy(size_t memoryBudgetBytes, double redundancyThreshold, int minObservations, int protectedKeyFrames);
+
+        /**
+         * @brief Estimates the memory used by the keyframes and map points of all maps.
+         */
+        MemoryUsage estimateUsage(ORB_SLAM3::Atlas *atlas);
+
+        /**
+         * @brief Returns true if the usage is above the budget.
+         */
+        bool exceedsBudget(const MemoryUsage &usage);
+
+        /**
+         * @brief Evicts landmarks and keyframes until the atlas fits into the budget.
+         * @note LocalMapping has to be stopped, it culls and optimizes the same keyframes.
+         * @return True if anything was evicted.
+         */
+        bool enforce(ORB_SLAM3::Atlas *atlas);
+
+        RetentionStatistics getStatistics();
+        size_t getMemoryBudget();
+
+    private:
+        size_t estimateKeyFrameBytes(ORB_SLAM3::KeyFrame *pKF);
+        size_t estimateMapPointBytes(ORB_SLAM3::MapPoint *pMP);
+
+        /**
+         * @brief Fraction of the map points of a keyframe which are observed by at least three other keyframes.
+         */
+        double redundancy(ORB_SLAM3::KeyFrame *pKF);
+
+        /**
+         * @brief Checks if a keyframe may be removed without breaking the graph or the local window.
+         */
+        bool isEvictable(ORB_SLAM3::KeyFrame *pKF, ORB_SLAM3::Map *pMap, bool isCurrentMap);
+
+        size_t evictMapPoints(ORB_SLAM3::Map *pMap, bool isCurrentMap, size_t bytesToEvict);
+        size_t evictKeyFrames(ORB_SLAM3::Map *pMap, bool isCurrentMap, size_t bytesToEvict);
+
+        size_t memoryBudgetBytes_;
+        double redundancyThreshold_;
+        int minObservations_;
+        int protectedKeyFrames_;
+        RetentionStatistics stats_;
+    };
+}
+
+#endif
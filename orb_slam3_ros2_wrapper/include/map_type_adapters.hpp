@@ -0,0 +1,109 @@
+/**
+ * @file map_type_adapters.hpp
+ * @brief rclcpp type adapters for the internal map point and keyframe pose arrays and the keyframe images.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#ifndef ORB_WRAPPER_MAP_TYPE_ADAPTERS_HPP_
+#define ORB_WRAPPER_MAP_TYPE_ADAPTERS_HPP_
+
+#include <memory>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include <rclcpp/type_adapter.hpp>
+#include <std_msgs/msg/header.hpp>
+#include <sensor_msgs/msg/image.hpp>
+#include <sensor_msgs/msg/point_cloud2.hpp>
+#include <slam_msgs/msg/map_graph.hpp>
+
+#include "occupancy_grid_builder.hpp"
+
+namespace ORB_SLAM3_Wrapper
+{
+    /**
+     * @brief Map points in the global frame, as the wrapper keeps them.
+     * The points are shared and never modified, like the poses of KeyFramePoseArray.
+     */
+    struct MapPointArray
+    {
+        std_msgs::msg::Header header;
+        std::shared_ptr<const std::vector<Eigen::Vector3f>> points;
+    };
+
+    /**
+     * @brief Keyframe poses in the global frame, ordered by keyframe ID.
+     * The poses are shared and never modified, so copies of the array, e.g. for intra-process peers, are cheap.
+     */
+    struct KeyFramePoseArray
+    {
+        std_msgs::msg::Header header;
+        std::shared_ptr<const KeyFramePoses> poses;
+    };
+
+    /**
+     * @brief An input image, shared with the tracking and never modified.
+     */
+    struct SharedImage
+    {
+        std::shared_ptr<const sensor_msgs::msg::Image> image;
+    };
+}
+
+/**
+ * Publishers and subscriptions of these adapters exchange the structures above with intra-process peers.
+ * The ROS message is only built for inter-process subscribers.
+ */
+template <>
+struct rclcpp::TypeAdapter<ORB_SLAM3_Wrapper::MapPointArray, sensor_msgs::msg::PointCloud2>
+{
+    using is_specialized = std::true_type;
+    using custom_type = ORB_SLAM3_Wrapper::MapPointArray;
+    using ros_message_type = sensor_msgs::msg::PointCloud2;
+
+    static void convert_to_ros_message(const custom_type &source, ros_message_type &destination);
+
+    /**
+     * @note Only clouds with float32 x, y and z fields can be converted, other clouds give no points.
+     */
+    static void convert_to_custom(const ros_message_type &source, custom_type &destination);
+};
+
+/**
+ * The keyframe poses are exchanged as a MapGraph, which keeps the keyframe IDs next to the poses.
+ */
+template <>
+struct rclcpp::TypeAdapter<ORB_SLAM3_Wrapper::KeyFramePoseArray, slam_msgs::msg::MapGraph>
+{
+    using is_specialized = std::true_type;
+    using custom_type = ORB_SLAM3_Wrapper::KeyFramePoseArray;
+    using ros_message_type = slam_msgs::msg::MapGraph;
+
+    static void convert_to_ros_message(const custom_type &source, ros_message_type &destination);
+    static void convert_to_custom(const ros_message_type &source, custom_type &destination);
+};
+
+/**
+ * Intra-process peers get the image the wrapper received, only inter-process subscribers copy it.
+ */
+template <>
+struct rclcpp::TypeAdapter<ORB_SLAM3_Wrapper::SharedImage, sensor_msgs::msg::Image>
+{
+    using is_specialized = std::true_type;
+    using custom_type = ORB_SLAM3_Wrapper::SharedImage;
+    using ros_message_type = sensor_msgs::msg::Image;
+
+    static void convert_to_ros_message(const custom_type &source, ros_message_type &destination);
+    static void convert_to_custom(const ros_message_type &source, custom_type &destination);
+};
+
+namespace ORB_SLAM3_Wrapper
+{
+    typedef rclcpp::TypeAdapter<MapPointArray, sensor_msgs::msg::PointCloud2> MapPointArrayAdapter;
+    typedef rclcpp::TypeAdapter<KeyFramePoseArray, slam_msgs::msg::MapGraph> KeyFramePoseArrayAdapter;
+    typedef rclcpp::TypeAdapter<SharedImage, sensor_msgs::msg::Image> SharedImageAdapter;
+}
+
+#endif
@@ -0,0 +1,82 @@
+/**
+ * @file map_visualizer.hpp
+ * @brief Definition of the MapVisualizer class.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#ifndef ORB_WRAPPER_MAP_VISUALIZER_HPP_
+#define ORB_WRAPPER_MAP_VISUALIZER_HPP_
+
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include <tf2_eigen/tf2_eigen.hpp>
+
+#include <geometry_msgs/msg/pose.hpp>
+#include <visualization_msgs/msg/marker.hpp>
+#include <visualization_msgs/msg/marker_array.hpp>
+
+#include <slam_msgs/msg/map_graph.hpp>
+
+namespace ORB_SLAM3_Wrapper
+{
+    /**
+     * @brief Builds RViz markers for the keyframes, the current camera and the covisibility graph.
+     * This replaces the Pangolin viewer for headless runs. The updates are incremental, only keyframes
+     * which were added, moved or removed since the last update are part of the marker array.
+     */
+    class MapVisualizer
+    {
+    public:
+        /**
+         * @param globalFrame Frame in which the markers are expressed.
+         * @param fullRefreshInterval Number of updates after which all keyframes are sent again (for late subscribers).
+         */
+        MapVisualizer(const std::string &globalFrame, int fullRefreshInterval = 50);
+
+        /**
+         * @brief Builds the marker updates from a map data snapshot.
+         * @param graph Pose graph of the map data snapshot.
+         * @param covisibilityEdges Covisibility edges between the keyframes of the snapshot.
+         * @param cameraPose Latest tracked camera pose in the global frame.
+         * @param stamp Stamp of the markers.
+         * @param markers Output marker array. It only contains the changed markers.
+         */
+        void buildMarkers(const slam_msgs::msg::MapGraph &graph,
+                          const std::vector<std::pair<int, int>> &covisibilityEdges,
+                          const Eigen::Affine3d &cameraPose,
+                          const builtin_interfaces::msg::Time &stamp,
+                          visualization_msgs::msg::MarkerArray &markers);
+
+        /**
+         * @brief Forgets all published markers. The next update will contain the complete map.
+         */
+        void reset();
+
+    private:
+        bool hasMoved(const geometry_msgs::msg::Pose &previous, const geometry_msgs::msg::Pose &current);
+
+        /**
+         * @brief Checksum of the edge set, independent of the order of the edges.
+         */
+        uint64_t edgesChecksum(const std::vector<std::pair<int, int>> &covisibilityEdges);
+
+        visualization_msgs::msg::Marker makeMarker(const std::string &ns, int id, int type, const builtin_interfaces::msg::Time &stamp);
+
+        std::string globalFrame_;
+        int fullRefreshInterval_;
+        int updatesSinceRefresh_;
+        // checksum of the last sent covisibility graph, edges can be rewired without changing their number.
+        uint64_t lastEdgesChecksum_;
+        // last pose of every keyframe marker which was sent out.
+        std::map<int, geometry_msgs::msg::Pose> publishedKeyFrames_;
+    };
+}
+
+#endif
@@ -0,0 +1,145 @@
+/**
+ * @file occupancy_grid_builder.hpp
+ * @brief Definition of the OccupancyGridBuilder class.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#ifndef ORB_WRAPPER_OCCUPANCY_GRID_BUILDER_HPP_
+#define ORB_WRAPPER_OCCUPANCY_GRID_BUILDER_HPP_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <Eigen/StdVector>
+
+#include <nav_msgs/msg/occupancy_grid.hpp>
+#include <map_msgs/msg/occupancy_grid_update.hpp>
+
+namespace ORB_SLAM3_Wrapper
+{
+    typedef std::map<long unsigned int, Eigen::Affine3d, std::less<long unsigned int>,
+                     Eigen::aligned_allocator<std::pair<const long unsigned int, Eigen::Affine3d>>>
+        KeyFramePoses;
+
+    /**
+     * @brief Map points observed by a keyframe, in the global frame.
+     */
+    struct KeyFrameLandmarks
+    {
+        long unsigned int kFId = 0;
+        Eigen::Affine3d pose;
+        std::vector<Eigen::Vector3f> points;
+
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    };
+
+    typedef std::vector<KeyFrameLandmarks, Eigen::aligned_allocator<KeyFrameLandmarks>> KeyFrameLandmarksList;
+
+    /**
+     * @brief Incremental 2D occupancy grid built from the map points of the keyframes.
+     * Every keyframe adds hits at its landmarks within the height band and free space along the rays from the camera
+     * to them. The contribution of a keyframe is kept, so when it moves (e.g. after a loop correction) or is culled,
+     * only its old contribution is subtracted and the new one added. The cells touched since the last publish form
+     * the dirty region, which is published as an OccupancyGridUpdate instead of the complete map.
+     */
+    class OccupancyGridBuilder
+    {
+    public:
+        /**
+         * @param resolution Size of a cell in meters.
+         * @param minHeight Landmarks below this height in the global frame are ignored.
+         * @param maxHeight Landmarks above this height in the global frame are ignored.
+         * @param hitThreshold Number of landmarks after which a cell is occupied.
+         * @param maxRange Landmarks further away from the keyframe are ignored.
+         * @param recentKeyFrames Number of newest keyframes which are always reintegrated, as local mapping still refines them.
+         * @param fullRefreshInterval Number of updates after which the complete map is published again.
+         */
+        OccupancyGridBuilder(double resolution, double minHeight, double maxHeight, int hitThreshold,
+                             double maxRange, size_t recentKeyFrames = 10, int fullRefreshInterval = 30);
+
+        /**
+         * @brief Compares the keyframe poses with the integrated ones.
+         * Keyframes which do not exist anymore are removed from the grid.
+         * @param poses Current poses of all keyframes in the global frame.
+         * @param changed Output IDs of the keyframes which have to be (re)integrated.
+         */
+        void findChanged(const KeyFramePoses &poses, std::vector<long unsigned int> &changed);
+
+        /**
+         * @brief Replaces the contribution of the given keyframes.
+         */
+        void integrate(const KeyFrameLandmarksList &landmarks);
+
+        /**
+         * @brief Forgets everything, e.g. after the atlas was reset.
+         */
+        void reset();
+
+        bool hasDirtyRegion();
+
+        /**
+         * @brief Makes the next publish send the complete map, e.g. for subscribers which missed the updates.
+         */
+        void requestFullMap();
+
+        /**
+         * @brief True if the complete map should be published, i.e. the grid was resized or the refresh interval passed.
+         */
+        bool needsFullMap();
+
+        /**
+         * @brief Writes the complete grid and clears the dirty region.
+         */
+        void toMsg(nav_msgs::msg::OccupancyGrid &grid);
+
+        /**
+         * @brief Writes the dirty region and clears it.
+         */
+        void dirtyRegionToMsg(map_msgs::msg::OccupancyGridUpdate &update);
+
+    private:
+        struct Contribution
+        {
+            Eigen::Affine3d pose;
+            std::vector<Eigen::Vector3f> points;
+
+            EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+        };
+
+        bool hasMoved(const Eigen::Affine3d &previous, const Eigen::Affine3d &current);
+        void ensureContains(const Eigen::Affine3d &pose, const std::vector<Eigen::Vector3f> &points);
+        void rasterize(const Contribution &contribution, int sign);
+        void markDirty(int x, int y);
+        int8_t cellValue(size_t index);
+
+        double resolution_;
+        double minHeight_;
+        double maxHeight_;
+        int hitThreshold_;
+        double maxRange_;
+        size_t recentKeyFrames_;
+        int fullRefreshInterval_;
+
+        // grid geometry, cell (0, 0) starts at the origin.
+        double originX_;
+        double originY_;
+        int width_;
+        int height_;
+        std::vector<int> hits_;
+        std::vector<int> free_;
+
+        std::map<long unsigned int, Contribution, std::less<long unsigned int>,
+                 Eigen::aligned_allocator<std::pair<const long unsigned int, Contribution>>>
+            contributions_;
+
+        // dirty region in cells, empty if minX > maxX.
+        int dirtyMinX_, dirtyMinY_, dirtyMaxX_, dirtyMaxY_;
+        bool fullMapPending_;
+        int updatesSinceFullMap_;
+    };
+}
+
+#endif
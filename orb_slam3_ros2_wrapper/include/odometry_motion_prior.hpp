@@ -0,0 +1,125 @@
+/**
+ * @file odometry_motion_prior.hpp
+ * @brief Definition of the OdometryMotionPrior class.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#ifndef ORB_WRAPPER_ODOMETRY_MOTION_PRIOR_HPP_
+#define ORB_WRAPPER_ODOMETRY_MOTION_PRIOR_HPP_
+
+#include <deque>
+#include <mutex>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <Eigen/StdDeque>
+
+#include "sophus/se3.hpp"
+
+namespace ORB_SLAM3_Wrapper
+{
+    /**
+     * @brief Result of the motion model of the tracker on a frame (System::GetMotionModelResult of the hook).
+     */
+    enum class MotionModelResult
+    {
+        // the tracker did not try the motion model, e.g. right after a relocalization.
+        NotUsed = 0,
+        Tracked = 1,
+        // tracked, but only with the wider window search.
+        WideSearch = 2,
+        // failed, the tracker fell back to the reference keyframe.
+        Failed = 3
+    };
+
+    /**
+     * @brief Outcomes of the tracker on the frames after a tracked frame.
+     */
+    struct MotionModelOutcomes
+    {
+        unsigned long frames = 0;
+        unsigned long tracked = 0;
+        unsigned long wideSearches = 0;
+        unsigned long referenceKeyFrameFallbacks = 0;
+        // frames lost, the tracker relocalizes from the next frame on.
+        unsigned long lostFrames = 0;
+    };
+
+    struct MotionPriorStatistics
+    {
+        // frames after a tracked frame without odometry around both stamps, they keep the constant velocity.
+        unsigned long missingOdometry = 0;
+        // frames started from the odometry prior and from the constant velocity model.
+        MotionModelOutcomes withPrior;
+        MotionModelOutcomes withoutPrior;
+    };
+
+    /**
+     * @brief Camera motion between two frames from the wheel odometry.
+     * The odometry poses are kept in a buffer sorted by stamp and interpolated at the frame stamps. Their
+     * increment is moved from the robot base into the camera frame of ORB-SLAM3 (x right, y down, z forward)
+     * and replaces the constant velocity of the tracker (System::SetMotionPrior, patched into the fork, see
+     * patches/orb_slam3). The outcomes of the tracker are counted separately for the frames with and without
+     * the prior, a run with motion_prior_feed_tracker off gives the baseline.
+     */
+    class OdometryMotionPrior
+    {
+    public:
+        /**
+         * @param baseToCamera Pose of the camera (optical frame) in the robot base frame.
+         * @param maxTimeDifference Maximum distance in seconds of a frame from the odometry around it.
+         */
+        OdometryMotionPrior(const Eigen::Affine3d &baseToCamera, double maxTimeDifference);
+
+        void addOdometry(double stamp, const Eigen::Affine3d &pose);
+
+        /**
+         * @brief Camera motion between two stamps.
+         * @param increment Pose of the camera at to in the camera frame at from.
+         * @return False if there is no odometry around both stamps.
+         */
+        bool cameraIncrement(double from, double to, Sophus::SE3f &increment);
+
+        /**
+         * @brief Camera motion from the last frame to the next one, in the convention of the tracker.
+         * @param stamp Stamp of the next frame.
+         * @param velocity Tcw of the next frame times the inverse Tcw of the last frame.
+         * @return False if the last frame was not tracked or there is no odometry around both stamps.
+         */
+        bool predict(double stamp, Sophus::SE3f &velocity);
+
+        /**
+         * @brief Counts the outcome of the tracker on a frame.
+         * @param stamp Stamp of the frame.
+         * @param tracked True if tracking was OK.
+         * @param priorUsed True if the frame was started from the prediction.
+         * @param result Result of the motion model, NotUsed without the hook.
+         */
+        void addFrame(double stamp, bool tracked, bool priorUsed, MotionModelResult result);
+
+        MotionPriorStatistics getStatistics();
+
+    private:
+        struct StampedPose
+        {
+            double stamp;
+            Eigen::Affine3d pose;
+
+            EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+        };
+
+        bool interpolateOdometry(double stamp, Eigen::Affine3d &pose);
+
+        std::mutex mutex_;
+        Eigen::Affine3d baseToCamera_;
+        double maxTimeDifference_;
+        std::deque<StampedPose, Eigen::aligned_allocator<StampedPose>> odometry_;
+        // the last frame, as the tracker sees it.
+        bool hasLastFrame_ = false;
+        bool lastTracked_ = false;
+        double lastStamp_ = 0.0;
+        MotionPriorStatistics statistics_;
+    };
+}
+
+#endif
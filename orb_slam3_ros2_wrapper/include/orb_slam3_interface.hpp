@@ -8,6 +8,8 @@
 
 #include <iostream>
 #include <algorithm>
+#include <chrono>
+#include <set>
 
 #include <Eigen/Core>
 #include <Eigen/Geometry>
@@ -33,10 +35,39 @@
 #include "Frame.h"
 #include "Map.h"
 #include "Atlas.h"
+#include "KeyFrame.h"
+#include "KeyFrameDatabase.h"
 #include "type_conversion.hpp"
+#include "stage_timer.hpp"
+#include "map_retention_policy.hpp"
+#include "keyframe_image_cache.hpp"
+#include "occupancy_grid_builder.hpp"
+#include "event_dispatcher.hpp"
+#include "input_recorder.hpp"
+#include "odometry_motion_prior.hpp"
+#include "klt_frame_tracker.hpp"
+#include "tracking_load_controller.hpp"
 
 namespace ORB_SLAM3_Wrapper
 {
+    /**
+     * @brief Statistics of the recoveries from lost tracking.
+     */
+    struct PosePriorStatistics
+    {
+        // recoveries by relocalization in the map which was lost.
+        unsigned long relocalizations = 0;
+        // recoveries by starting a new map.
+        unsigned long newMaps = 0;
+        // maps which were placed at a pose prior.
+        unsigned long seededMaps = 0;
+        // keyframes currently hidden from the relocalization.
+        unsigned long maskedKeyFrames = 0;
+        double lastRecoveryMs = 0.0;
+        double totalRecoveryMs = 0.0;
+        bool hasPrior = false;
+    };
+
     class ORBSLAM3Interface
     {
     public:
@@ -64,6 +95,11 @@ namespace ORB_SLAM3_Wrapper
          */
         void calculateReferencePoses();
 
+        /**
+         * @brief Recalculates the reference poses unless they are known to be unchanged.
+         */
+        void updateReferencePoses();
+
         /**
          * @brief Converts the entire map data into a ROS Message.
          * @param orbAtlas Pointer to the Atlas object.
@@ -79,13 +115,313 @@ namespace ORB_SLAM3_Wrapper
 
         void getCurrentMapPoints(sensor_msgs::msg::PointCloud2 &mapPointCloud);
 
+        /**
+         * @brief Returns the map points of all keyframes in the global frame.
+         * @param trackedMapPoints Output points, the vector keeps its capacity.
+         */
+        void getCurrentMapPoints(std::vector<Eigen::Vector3f> &trackedMapPoints);
+
+        /**
+         * @brief Collects the covisibility edges between the keyframes of a pose graph.
+         * @param graph Pose graph (snapshot) whose keyframes are considered.
+         * @param edges Output list of keyframe ID pairs. Every edge is listed once.
+         * @param minWeight Minimum number of shared map points for an edge.
+         */
+        void getCovisibilityGraph(const slam_msgs::msg::MapGraph &graph, std::vector<std::pair<int, int>> &edges, int minWeight);
+
+        /**
+         * @brief Returns the latest tracked camera pose in the global frame.
+         */
+        Eigen::Affine3d getLatestTrackedPose();
+
+        /**
+         * @brief Returns the number of map points tracked in the last frame.
+         */
+        int getTrackedInliers();
+
+        /**
+         * @brief Returns the latency statistics of the tracking stages.
+         */
+        StageTimer &getStageTimer();
+
+        /**
+         * @brief Sets the policy used to keep the atlas within its memory budget.
+         */
+        void setRetentionPolicy(std::shared_ptr<MapRetentionPolicy> retentionPolicy);
+
+        /**
+         * @brief Updates the memory accounting and evicts map elements if the budget is exceeded.
+         * Outside of localization mode the eviction is deferred to the next tracked frame, which stops LocalMapping.
+         * @note Skipped while a merge or a global BA is running.
+         */
+        void enforceMemoryBudget();
+
+        /**
+         * @brief Returns the memory usage measured by the last call of enforceMemoryBudget.
+         */
+        MemoryUsage getMemoryUsage();
+
+        /**
+         * @brief Returns the eviction statistics of the retention policy.
+         */
+        RetentionStatistics getRetentionStatistics();
+
+        /**
+         * @brief Sets the cache which keeps the input images of new keyframes.
+         */
+        void setKeyFrameImageCache(std::shared_ptr<KeyFrameImageCache> keyFrameImageCache);
+
+        /**
+         * @brief Returns the ID of the keyframe created from the last tracked frame, -1 if there was none.
+         */
+        long getNewKeyFrameId();
+
+        /**
+         * @brief Sets the recorder which gets the inputs of every tracked frame, nullptr stops the recording.
+         */
+        void setInputRecorder(std::shared_ptr<InputRecorder> inputRecorder);
+
+        /**
+         * @brief Sets the odometry motion prior which gets the outcome of every tracked frame, nullptr disables it.
+         * @param feedTracker Replaces the constant velocity of the tracker by the odometry.
+         * @return False if feedTracker is set, but ORB-SLAM3 has no motion prior hook. The tracker keeps its constant velocity then.
+         */
+        bool setMotionPrior(std::shared_ptr<OdometryMotionPrior> motionPrior, bool feedTracker);
+
+        /**
+         * @brief Replaces the ORB extractor of the tracker for the next frames, call it between two tracked frames.
+         * @return False if ORB-SLAM3 has no ORB extractor hook, the extractor of the settings file stays then.
+         */
+        bool setORBExtractor(const OrbExtractorSettings &settings);
+
+        /**
+         * @brief Returns the poses of all keyframes in the global frame.
+         */
+        void getKeyFramePoses(KeyFramePoses &poses);
+
+        /**
+         * @brief Starts or stops collecting the IDs of keyframes which were culled or belonged to a cleared map.
+         */
+        void setCollectRemovedKeyFrames(bool enable);
+
+        /**
+         * @brief Returns the keyframes removed since the last call and forgets them.
+         * @param kFIds Output IDs, replaced.
+         */
+        void takeRemovedKeyFrames(std::vector<long unsigned int> &kFIds);
+
+        /**
+         * @brief Returns the map points of the given keyframes in the global frame.
+         */
+        void getKeyFrameLandmarks(const std::vector<long unsigned int> &kFIds, KeyFrameLandmarksList &landmarks);
+
         void handleIMU(const sensor_msgs::msg::Imu::SharedPtr msgIMU);
 
         bool trackRGBDi(const sensor_msgs::msg::Image::SharedPtr msgRGB, const sensor_msgs::msg::Image::SharedPtr msgD, Sophus::SE3f &Tcw);
 
+        /**
+         * @brief Tracks a frame with the given IMU measurements instead of the ones in the IMU buffer.
+         * Used to replay recorded inputs, the measurements must be the ones the frame was originally tracked with.
+         */
+        bool trackRGBDi(const sensor_msgs::msg::Image::SharedPtr msgRGB, const sensor_msgs::msg::Image::SharedPtr msgD,
+                        const std::vector<ORB_SLAM3::IMU::Point> &vImuMeas, Sophus::SE3f &Tcw);
+
         bool trackRGBD(const sensor_msgs::msg::Image::SharedPtr msgRGB, const sensor_msgs::msg::Image::SharedPtr msgD, Sophus::SE3f &Tcw);
 
+        /**
+         * @brief Tracks a frame between two ORB-SLAM3 frames with the intermediate frame tracker.
+         * The frame is not passed to ORB-SLAM3, only the latest tracked pose and the pose event are updated.
+         * @return False if there is no tracker, tracking is not OK or the tracker failed. The frame then needs trackRGBDi.
+         */
+        bool trackIntermediateFrame(const sensor_msgs::msg::Image::SharedPtr msgRGB, Sophus::SE3f &Tcw);
+
+        /**
+         * @brief Sets the tracker of the intermediate frames, which takes every frame tracked by ORB-SLAM3 as its
+         * reference. nullptr disables it.
+         */
+        void setIntermediateFrameTracker(std::shared_ptr<KltFrameTracker> kltTracker);
+
+        /**
+         * @brief Switches ORB-SLAM3 between SLAM and localization-only mode.
+         * @param enable True to stop LocalMapping and only track against the existing atlas.
+         * @note The switch is applied by ORB-SLAM3 on the next tracked frame.
+         */
+        void setLocalizationMode(bool enable);
+
+        /**
+         * @brief Returns true if mapping is currently turned off.
+         */
+        bool isLocalizationMode();
+
+        /**
+         * @brief Returns a counter that changes every time the reference poses are recalculated.
+         * @note Exports built for the same version are identical and can be reused.
+         */
+        unsigned long getReferencePosesVersion();
+
+        /**
+         * @brief Registers in-process callbacks for tracker events.
+         * The callbacks run on the dispatch thread and receive the events without any serialization.
+         * @param callback Callback, must not call back into the interface while holding its own locks.
+         * @param queueSize Number of events kept for a slow subscriber, older ones are dropped.
+         * @return ID to unsubscribe with.
+         */
+        EventDispatcher::SubscriptionId subscribeTrackedPose(std::function<void(const TrackedPoseEvent &)> callback, size_t queueSize = 10);
+        EventDispatcher::SubscriptionId subscribeKeyFrames(std::function<void(const KeyFrameEvent &)> callback, size_t queueSize = 10);
+        EventDispatcher::SubscriptionId subscribeMapCorrections(std::function<void(const MapCorrectedEvent &)> callback, size_t queueSize = 2);
+        EventDispatcher::SubscriptionId subscribeStatus(std::function<void(const StatusEvent &)> callback, size_t queueSize = 10);
+
+        void unsubscribe(EventDispatcher::SubscriptionId id);
+
+        /**
+         * @brief Returns the delivered and dropped events of every subscription.
+         */
+        std::map<EventDispatcher::SubscriptionId, SubscriptionStatistics> getSubscriptionStatistics();
+
+        /**
+         * @brief Returns the ORB-SLAM3 tracking state after the last frame, -1 before the first one.
+         */
+        int getTrackingState();
+
+        /**
+         * @brief Returns the keyframe the last tracked pose is anchored to (the newest keyframe) and its current pose.
+         * Storing the pose relative to the anchor allows to apply later loop corrections to the frame.
+         * @param kFId Output ID of the anchor keyframe.
+         * @param anchorPose Output pose of the anchor keyframe in the global frame.
+         * @return False if there is no keyframe yet.
+         */
+        bool getTrajectoryAnchor(long unsigned int &kFId, Eigen::Affine3d &anchorPose);
+
+        /**
+         * @brief Returns the current poses of anchor keyframes in the global frame.
+         * Culled keyframes are resolved through their parents, so every anchor which was handed out has a pose.
+         */
+        void getAnchorPoses(KeyFramePoses &poses);
+
+        /**
+         * @brief Sets a prior of the robot pose in the global frame, e.g. a known start pose or an operator estimate.
+         * While tracking is lost, relocalization only considers the keyframes within radius of the prior. The next
+         * map which starts tracking is placed at the prior instead of at the last keyframe of the previous map.
+         * The prior is used up once tracking recovers from a loss or a map was seeded with it, a prior set while
+         * tracking is kept until then.
+         * @param radius Maximum distance in meters of the relocalization candidates from the prior.
+         */
+        void setPosePrior(const Eigen::Affine3d &pose, double radius);
+
+        /**
+         * @brief Continuously derives the pose prior from the odometry while tracking is lost, by applying the
+         * odometry since the last tracked frame to the last tracked pose.
+         */
+        void setOdometryPosePrior(bool enable, double radius);
+
+        PosePriorStatistics getPosePriorStatistics();
+
     private:
+        /**
+         * @brief Bookkeeping of the keyframe table of a single map.
+         */
+        struct MapCacheEntry
+        {
+            // signature of the map, if it changes the keyframe table is rebuilt.
+            unsigned long keyFrames = 0;
+            int changeIndex = -1;
+            long unsigned int maxKFid = 0;
+            std::vector<long unsigned int> keyFrameIds;
+        };
+
+        /**
+         * @brief Tracks the converted images of a frame and handles the result, shared by all track functions.
+         * @param vImuMeas IMU measurements of the frame, empty without IMU.
+         * @param imuSlicingMs Time spent collecting vImuMeas, only recorded.
+         * @param receiveTime Time the frame was handed to the interface, only recorded.
+         */
+        bool trackImages(const sensor_msgs::msg::Image::SharedPtr msgRGB, const sensor_msgs::msg::Image::SharedPtr msgD,
+                         const cv::Mat &rgb, const cv::Mat &depth, const std::vector<ORB_SLAM3::IMU::Point> &vImuMeas,
+                         double imuSlicingMs, std::chrono::steady_clock::time_point receiveTime, Sophus::SE3f &Tcw);
+
+        /**
+         * @brief Hides the keyframes of the current map which are far from the pose prior from the relocalization
+         * while tracking is lost, and shows them again once it is not.
+         * @param trackingState ORB-SLAM3 tracking state after the last frame.
+         */
+        void applyPosePrior(int trackingState);
+
+        /**
+         * @brief Books a recovery and places a map which starts tracking at the pose prior.
+         * @param trackingState ORB-SLAM3 tracking state after the current frame.
+         */
+        void handlePosePrior(int trackingState);
+
+        /**
+         * @brief Adds the masked keyframes back to the keyframe database. Requires posePriorMutex_.
+         */
+        void unmaskKeyFrames();
+
+        /**
+         * @brief Lets the retention policy evict map elements. LocalMapping has to be stopped.
+         */
+        void evictMapElements();
+
+        /**
+         * @brief Requests the localization mode of the user or of a pending eviction from ORB-SLAM3.
+         * Called right before TrackRGBD, which applies the request.
+         */
+        void applyLocalizationMode();
+
+        /**
+         * @brief Counts the valid map points tracked in the last frame.
+         */
+        void countTrackedInliers();
+
+        /**
+         * @brief Hands the outcome of the tracker on the current frame to the motion prior.
+         */
+        void evaluateMotionPrior(double stamp, int trackingState);
+
+        /**
+         * @brief Makes the current frame the reference of the intermediate frame tracker if it was tracked.
+         */
+        void updateIntermediateFrameReference(const cv::Mat &rgb, int trackingState, const Sophus::SE3f &Tcw);
+
+        /**
+         * @brief Hands the events of the last tracked frame to the dispatcher.
+         * @param trackingState ORB-SLAM3 tracking state after the frame.
+         * @param tracked True if the frame was tracked and the pose corrected.
+         */
+        void publishTrackingEvents(int trackingState, bool tracked, const sensor_msgs::msg::Image::SharedPtr msgRGB,
+                                   const sensor_msgs::msg::Image::SharedPtr msgD);
+
+        /**
+         * @brief Detects if the last TrackRGBD call created a keyframe and caches its input images.
+         * @param nextKFIdBefore Value of KeyFrame::nNextId before the frame was tracked.
+         */
+        void handleNewKeyFrame(long unsigned int nextKFIdBefore, const sensor_msgs::msg::Image::SharedPtr msgRGB,
+                               const sensor_msgs::msg::Image::SharedPtr msgD, const cv::Mat &rgb, const cv::Mat &depth);
+
+        /**
+         * @brief Updates allKFs_ for the maps whose signature changed.
+         * @param mapsList List of all maps in the atlas.
+         */
+        void refreshKeyFrameTables(const std::vector<ORB_SLAM3::Map *> &mapsList);
+
+        /**
+         * @brief Removes the keyframes of a map from allKFs_, including those whose map is not in the atlas anymore.
+         * @param liveMaps All maps in the atlas.
+         */
+        void forgetKeyFrames(ORB_SLAM3::Map *pMap, const MapCacheEntry &entry, const std::set<ORB_SLAM3::Map *> &liveMaps);
+
+        /**
+         * @brief Looks up the ORB pose and the map of a keyframe.
+         * @return False if the keyframe is not known.
+         */
+        bool findKeyFrame(long unsigned int kFId, Sophus::SE3f &pose, ORB_SLAM3::Map *&pMap);
+
+        /**
+         * @brief Computes the global pose of a keyframe, following the parents of culled keyframes.
+         * @note Call with mapDataMutex_ locked.
+         */
+        bool resolveKeyFramePose(ORB_SLAM3::KeyFrame *pKF, Eigen::Affine3d &pose);
+
         std::shared_ptr<ORB_SLAM3::System> mSLAM_;
         std::shared_ptr<WrapperTypeConversions> typeConversions_;
         ORB_SLAM3::Atlas *orbAtlas_;
@@ -103,6 +439,63 @@ namespace ORB_SLAM3_Wrapper
         std::map<long unsigned int, ORB_SLAM3::KeyFrame *> allKFs_;
         Eigen::Affine3d latestTrackedPose_;
         bool hasTracked_ = false;
+        // While mapping is off no keyframes or maps are created, so the reference poses stay valid.
+        bool localizationMode_ = false;
+        bool referencePosesValid_ = false;
+        int lastMapChangeIndex_ = -1;
+        ORB_SLAM3::Map *lastCurrentMap_ = nullptr;
+        unsigned long referencePosesVersion_ = 0;
+        int trackedInliers_ = 0;
+        StageTimer stageTimer_;
+        std::shared_ptr<MapRetentionPolicy> retentionPolicy_;
+        MemoryUsage memoryUsage_;
+        // LocalMapping is being stopped for an eviction.
+        bool evictionPending_ = false;
+        // mode last requested from ORB-SLAM3, the localization mode or a pending eviction.
+        bool orbLocalizationMode_ = false;
+        // LocalMapping was stopped by the last TrackRGBD.
+        bool localMappingStopped_ = false;
+        std::vector<Eigen::Vector3f> mapPointsBuffer_;
+        std::shared_ptr<KeyFrameImageCache> keyFrameImageCache_;
+        long newKeyFrameId_ = -1;
+        std::map<ORB_SLAM3::Map *, MapCacheEntry> mapCache_;
+        bool collectRemovedKeyFrames_ = false;
+        std::vector<long unsigned int> removedKeyFrames_;
+        // state of the last status event, the event is only sent on changes.
+        int lastTrackingState_ = -1;
+        bool lastLocalizationMode_ = false;
+        std::unique_ptr<EventDispatcher> eventDispatcher_;
+        std::shared_ptr<InputRecorder> inputRecorder_;
+        std::shared_ptr<OdometryMotionPrior> motionPrior_;
+        bool feedMotionPrior_ = false;
+        // true if the current frame was started from the motion prior.
+        bool motionPriorUsed_ = false;
+        std::shared_ptr<KltFrameTracker> kltTracker_;
+        std::vector<cv::Point2f> kltKeyPoints_;
+        std::vector<cv::Point3f> kltMapPoints_;
+        // keyframes which anchor logged trajectory poses. Keyframes are never deleted by ORB-SLAM3, only flagged bad.
+        std::map<long unsigned int, ORB_SLAM3::KeyFrame *> anchorKeyFrames_;
+        ORB_SLAM3::KeyFrame *trajectoryAnchor_ = nullptr;
+        // pose prior of the relocalization, guarded by posePriorMutex_.
+        std::mutex posePriorMutex_;
+        Eigen::Affine3d posePrior_;
+        double posePriorRadius_ = 0.0;
+        bool hasPosePrior_ = false;
+        bool odometryPosePrior_ = false;
+        double odometryPriorRadius_ = 0.0;
+        // map -> odom at the last tracked frame, the base of the odometry prior.
+        Eigen::Affine3d trackedMapToOdom_;
+        bool hasTrackedMapToOdom_ = false;
+        std::vector<ORB_SLAM3::KeyFrame *> maskedKeyFrames_;
+        Eigen::Vector3d maskCenter_;
+        ORB_SLAM3::Map *maskedMap_ = nullptr;
+        // maps which tracked at least once, the first tracked frame of a map may place it at the prior.
+        std::set<ORB_SLAM3::Map *> trackedMaps_;
+        ORB_SLAM3::Map *lostMap_ = nullptr;
+        std::chrono::steady_clock::time_point lostSince_;
+        PosePriorStatistics posePriorStatistics_;
+        // reference poses of maps placed at a pose prior, guarded by mapDataMutex_.
+        std::map<ORB_SLAM3::Map *, Eigen::Affine3d> mapSeeds_;
         double robotX_, robotY_;
         std::string globalFrame_;
         std::string odomFrame_;
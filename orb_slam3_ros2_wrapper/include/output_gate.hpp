@@ -0,0 +1,60 @@
+/**
+ * @file output_gate.hpp
+ * @brief Definition of the OutputGate class.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#ifndef ORB_WRAPPER_OUTPUT_GATE_HPP_
+#define ORB_WRAPPER_OUTPUT_GATE_HPP_
+
+#include <cstddef>
+
+namespace ORB_SLAM3_Wrapper
+{
+    /**
+     * @brief Counters of an output gate.
+     */
+    struct OutputGateStatistics
+    {
+        unsigned long runs = 0;
+        // skipped because nobody subscribed.
+        unsigned long idleSkips = 0;
+        // skipped because the last run is more recent than the rate allows.
+        unsigned long rateSkips = 0;
+    };
+
+    /**
+     * @brief Decides per tracked frame whether an output is computed at all.
+     * An output without subscribers is not computed, and one with subscribers at most at its rate.
+     */
+    class OutputGate
+    {
+    public:
+        OutputGate();
+
+        /**
+         * @param now Current time in seconds.
+         * @param rate Maximum rate of the output in Hz. 0 computes it on every call.
+         * @param subscribers Number of subscribers of the output.
+         * @return True if the output should be computed now.
+         */
+        bool admit(double now, double rate, size_t subscribers);
+
+        /**
+         * @brief True if the last admitted run is the first one after a period without subscribers,
+         * i.e. incremental outputs have to send their complete state again.
+         */
+        bool resumed();
+
+        OutputGateStatistics getStatistics();
+
+    private:
+        double lastRun_;
+        bool hasRun_;
+        bool idle_;
+        bool resumed_;
+        OutputGateStatistics statistics_;
+    };
+}
+
+#endif
@@ -0,0 +1,58 @@
+/**
+ * @file performance_profile.hpp
+ * @brief Definition of the PerformanceProfile struct.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#ifndef ORB_WRAPPER_PERFORMANCE_PROFILE_HPP_
+#define ORB_WRAPPER_PERFORMANCE_PROFILE_HPP_
+
+#include <string>
+#include <vector>
+
+#include <rclcpp/rclcpp.hpp>
+
+namespace ORB_SLAM3_Wrapper
+{
+    /**
+     * @brief A named set of runtime settings of the node, e.g. "patrol" or "mapping".
+     * Every field maps to a node parameter of the same name. Switching a profile sets these parameters.
+     * A profile only changes the effort spent on tracking and outputs, not what the node does. Mapping vs.
+     * localization has its own service. The effort of the local bundle adjustment is not part of a profile,
+     * ORB-SLAM3 has no hook for it (see patches/orb_slam3), and there is no IMU decimation as the RGB-D tracker
+     * ignores the IMU.
+     */
+    struct PerformanceProfile
+    {
+        // outputs
+        bool rosVisualization = false;
+        double rosVisualizationRate = 2.0;
+        double mapDataRate = 0.0;
+        double mapPointsRate = 0.0;
+        // tracking load (frame stride, see TrackingLoadController)
+        bool adaptiveTrackingLoad = false;
+        int maxFrameStride = 3;
+        int minTrackedInliers = 80;
+        // ORB extractor of the tracker, 0 uses the settings file, the load controller lowers it to the minimums
+        int orbFeatures = 0;
+        int orbLevels = 0;
+        int minOrbFeatures = 400;
+        int minOrbLevels = 4;
+
+        /**
+         * @brief Declares the parameters "profiles.<name>.<field>" of a profile and reads them.
+         * @param node Node on which the parameters are declared.
+         * @param name Name of the profile.
+         * @param defaults Values used for fields not set in the parameter file.
+         * @return The declared profile.
+         */
+        static PerformanceProfile declare(rclcpp::Node *node, const std::string &name, const PerformanceProfile &defaults);
+
+        /**
+         * @brief Converts the profile into the node parameters it stands for.
+         */
+        std::vector<rclcpp::Parameter> toParameters() const;
+    };
+}
+
+#endif
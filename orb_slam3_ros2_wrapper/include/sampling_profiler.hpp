@@ -0,0 +1,60 @@
+/**
+ * @file sampling_profiler.hpp
+ * @brief Definition of the SamplingProfiler class.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#ifndef ORB_WRAPPER_SAMPLING_PROFILER_HPP_
+#define ORB_WRAPPER_SAMPLING_PROFILER_HPP_
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <time.h>
+
+namespace ORB_SLAM3_Wrapper
+{
+    /**
+     * @brief In-process sampling CPU profiler for systems where perf can not be attached.
+     * Every thread of the process (the ROS executor as well as the ORB-SLAM3 LocalMapping, LoopClosing and
+     * viewer threads) gets a timer on its own CPU clock, which sends SIGPROF to exactly that thread. The signal
+     * handler unwinds the stack into a preallocated buffer. After the profiling period the stacks are
+     * symbolized and written in the folded format ("thread;outer;...;inner count" per line), which
+     * flamegraph.pl and speedscope read directly.
+     * Threads started while profiling are not sampled. Only one profile can run at a time in a process.
+     * @note Linux only, it relies on the per-thread CPU clocks and SIGEV_THREAD_ID.
+     */
+    class SamplingProfiler
+    {
+    public:
+        SamplingProfiler();
+        ~SamplingProfiler();
+
+        /**
+         * @brief Starts sampling all threads. Returns immediately, the profile is written by a background thread.
+         * @param duration Profiling period in seconds.
+         * @param frequency Samples per second of CPU time per thread.
+         * @param path Destination of the folded stacks.
+         * @param message Reason if the profiler could not be started.
+         * @return False if a profile is already running or the timers could not be created.
+         */
+        bool start(double duration, int frequency, const std::string &path, std::string &message);
+
+        bool isRunning();
+
+    private:
+        void run(double duration, std::string path);
+        void stopTimers();
+        void writeFoldedStacks(const std::string &path);
+
+        std::mutex mutex_;
+        std::atomic<bool> running_;
+        std::vector<timer_t> timers_;
+        std::thread worker_;
+    };
+}
+
+#endif
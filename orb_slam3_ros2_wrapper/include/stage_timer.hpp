@@ -0,0 +1,96 @@
+/**
+ * @file stage_timer.hpp
+ * @brief Definition of the StageTimer class used to measure the latency of named processing stages.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#ifndef ORB_WRAPPER_STAGE_TIMER_HPP_
+#define ORB_WRAPPER_STAGE_TIMER_HPP_
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "allocation_counter.hpp"
+
+namespace ORB_SLAM3_Wrapper
+{
+    /**
+     * @brief Latency statistics of a single stage.
+     */
+    struct StageStatistics
+    {
+        unsigned long count = 0;
+        double lastMs = 0.0;
+        double maxMs = 0.0;
+        double totalMs = 0.0;
+        // heap allocations of the stage, only counted while the AllocationCounter is enabled.
+        unsigned long long lastAllocations = 0;
+        unsigned long long totalAllocations = 0;
+        unsigned long long totalAllocatedBytes = 0;
+
+        double averageMs() const
+        {
+            return count > 0 ? totalMs / count : 0.0;
+        }
+    };
+
+    /**
+     * @brief Thread safe registry of the latency statistics of named stages (e.g. "track_rgbd").
+     */
+    class StageTimer
+    {
+    public:
+        /**
+         * @brief Adds a measurement to a stage.
+         * @param stage Name of the stage.
+         * @param elapsedMs Duration of the stage in milliseconds.
+         * @param allocations Heap allocations of the stage.
+         */
+        void record(const std::string &stage, double elapsedMs, const AllocationCount &allocations = AllocationCount());
+
+        /**
+         * @brief Returns the statistics of a stage. Empty statistics if the stage never ran.
+         */
+        StageStatistics get(const std::string &stage);
+
+        /**
+         * @brief Returns a copy of the statistics of all stages.
+         */
+        std::map<std::string, StageStatistics> snapshot();
+
+        /**
+         * @brief Clears all the statistics.
+         */
+        void reset();
+
+    private:
+        std::mutex statsMutex_;
+        std::map<std::string, StageStatistics> stats_;
+    };
+
+    /**
+     * @brief Measures the lifetime of the object and records it as a stage in a StageTimer, together with the
+     * allocations the thread made meanwhile.
+     */
+    class ScopedStage
+    {
+    public:
+        ScopedStage(StageTimer &timer, const std::string &stage);
+        ~ScopedStage();
+
+        /**
+         * @brief Returns the time since the stage started in milliseconds.
+         */
+        double elapsedMs();
+
+    private:
+        StageTimer &timer_;
+        std::string stage_;
+        std::chrono::steady_clock::time_point start_;
+        AllocationCount startAllocations_;
+    };
+}
+
+#endif
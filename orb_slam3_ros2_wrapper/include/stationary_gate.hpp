@@ -0,0 +1,78 @@
+/**
+ * @file stationary_gate.hpp
+ * @brief Definition of the StationaryGate class.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#ifndef ORB_WRAPPER_STATIONARY_GATE_HPP_
+#define ORB_WRAPPER_STATIONARY_GATE_HPP_
+
+#include <opencv2/core/core.hpp>
+
+namespace ORB_SLAM3_Wrapper
+{
+    /**
+     * @brief Skips the tracking of frames while the robot stands still.
+     * A frame counts as stationary if the odometry twist and the IMU rates are below their thresholds and a
+     * thumbnail of the image hardly differs from the one of the last tracked frame. Sensors which did not
+     * report recently are left out. After standing still for the hold time only one frame per track interval
+     * is tracked. The decision is made for every frame, so any motion is tracked from the frame it shows up in.
+     */
+    class StationaryGate
+    {
+    public:
+        /**
+         * @param maxLinearSpeed Odometry speed in m/s below which the robot is considered stationary.
+         * @param maxAngularSpeed Odometry and gyroscope rate in rad/s below which the robot is considered stationary.
+         * @param maxImageDifference Mean absolute difference of the thumbnails in gray levels.
+         * @param holdTime Time in seconds the robot has to be stationary before frames are skipped.
+         * @param trackInterval Time in seconds between the frames still tracked while stationary.
+         */
+        StationaryGate(double maxLinearSpeed, double maxAngularSpeed, double maxImageDifference, double holdTime, double trackInterval);
+
+        void addOdometry(double stamp, double linearSpeed, double angularSpeed);
+
+        void addImu(double stamp, double angularSpeed);
+
+        /**
+         * @brief Decides whether the frame is tracked.
+         * @param stamp Stamp of the frame.
+         * @param image Color or gray image of the frame.
+         * @return True if the frame should be passed to ORB-SLAM3.
+         */
+        bool admitFrame(double stamp, const cv::Mat &image);
+
+        /**
+         * @brief Forgets the stationary period, e.g. when tracking is not OK. The next frame is admitted.
+         */
+        void reset();
+
+        bool isStationary();
+        unsigned long getSkippedFrames();
+
+    private:
+        bool sensorsMoving(double stamp);
+
+        double maxLinearSpeed_;
+        double maxAngularSpeed_;
+        double maxImageDifference_;
+        double holdTime_;
+        double trackInterval_;
+
+        double odometryStamp_;
+        bool odometryMoving_;
+        double imuStamp_;
+        bool imuMoving_;
+        // thumbnail of the last tracked frame, the reference of the image difference.
+        cv::Mat referenceThumbnail_;
+        cv::Mat thumbnail_;
+        cv::Mat difference_;
+        bool hasStationarySince_;
+        double stationarySince_;
+        double lastTrackedStamp_;
+        bool stationary_;
+        unsigned long skippedFrames_;
+    };
+}
+
+#endif
@@ -0,0 +1,112 @@
+/**
+ * @file tracking_load_controller.hpp
+ * @brief Definition of the TrackingLoadController class.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#ifndef ORB_WRAPPER_TRACKING_LOAD_CONTROLLER_HPP_
+#define ORB_WRAPPER_TRACKING_LOAD_CONTROLLER_HPP_
+
+#include <string>
+
+namespace ORB_SLAM3_Wrapper
+{
+    /**
+     * @brief Settings of the ORB extractor of the tracker, see ORBextractor::ORBextractor.
+     */
+    struct OrbExtractorSettings
+    {
+        int nFeatures = 1000;
+        float scaleFactor = 1.2f;
+        int nLevels = 8;
+        int iniThFAST = 20;
+        int minThFAST = 7;
+
+        /**
+         * @brief Reads the ORBextractor.* entries of an ORB-SLAM3 settings file.
+         * @return False if the file can not be read or has no feature count.
+         */
+        static bool fromSettingsFile(const std::string &settingsFile, OrbExtractorSettings &settings);
+
+        bool operator==(const OrbExtractorSettings &other) const;
+    };
+
+    /**
+     * @brief Closed loop controller for the tracking load.
+     * It adjusts the feature budget and then the pyramid levels of the ORB extractor (System::SetORBExtractor,
+     * patched into the fork, see patches/orb_slam3) to keep the tracking latency within the frame budget, and
+     * raises them again when the number of tracked inliers gets low. Only with the extractor at its minimum it
+     * tracks every n-th camera frame (stride), which is also all it can do without the extractor hook.
+     */
+    class TrackingLoadController
+    {
+    public:
+        /**
+         * @param latencyBudgetMs Time available per camera frame in milliseconds.
+         * @param minInliers Below this number of tracked map points the extractor is raised and every frame is tracked.
+         * @param maxStride Upper bound of the stride.
+         */
+        TrackingLoadController(double latencyBudgetMs, int minInliers, int maxStride);
+
+        /**
+         * @brief Decides whether the incoming frame is tracked.
+         * @return True if the frame should be passed to ORB-SLAM3.
+         */
+        bool admitFrame();
+
+        /**
+         * @brief Feeds back the measurements of a tracked frame.
+         * @param trackingLatencyMs Time spent in tracking the frame.
+         * @param trackedInliers Number of map points tracked in the frame.
+         */
+        void update(double trackingLatencyMs, int trackedInliers);
+
+        /**
+         * @brief Enables the control of the extractor, from maxSettings (the settings file) down to the minimums.
+         */
+        void setExtractorBounds(const OrbExtractorSettings &maxSettings, int minFeatures, int minLevels);
+
+        /**
+         * @brief Returns the extractor settings if they changed since the last call.
+         */
+        bool takeExtractorChange(OrbExtractorSettings &settings);
+
+        /**
+         * @brief Goes back to every frame and the full extractor, e.g. when the control is turned off.
+         */
+        void reset();
+
+        int getStride();
+        OrbExtractorSettings getExtractor();
+        double getFilteredLatencyMs();
+        unsigned long getSkippedFrames();
+
+        void setBounds(double latencyBudgetMs, int minInliers, int maxStride);
+
+    private:
+        // cheaper settings, false if the extractor is already at its minimum.
+        bool lowerExtractor();
+        // more expensive settings, false if the extractor is already at its maximum.
+        bool raiseExtractor();
+
+        double latencyBudgetMs_;
+        int minInliers_;
+        int maxStride_;
+
+        bool extractorControl_;
+        OrbExtractorSettings maxExtractor_;
+        int minFeatures_;
+        int minLevels_;
+        OrbExtractorSettings extractor_;
+        bool extractorChanged_;
+
+        int stride_;
+        int framesSinceTracked_;
+        int framesSinceAdjustment_;
+        double filteredLatencyMs_;
+        bool hasLatency_;
+        unsigned long skippedFrames_;
+    };
+}
+
+#endif
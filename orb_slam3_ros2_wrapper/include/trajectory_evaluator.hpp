@@ -0,0 +1,129 @@
+/**
+ * @file trajectory_evaluator.hpp
+ * @brief Definition of the TrajectoryEvaluator class.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#ifndef ORB_WRAPPER_TRAJECTORY_EVALUATOR_HPP_
+#define ORB_WRAPPER_TRAJECTORY_EVALUATOR_HPP_
+
+#include <deque>
+#include <mutex>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <Eigen/StdDeque>
+
+namespace ORB_SLAM3_Wrapper
+{
+    /**
+     * @brief Running accuracy of the tracked trajectory.
+     */
+    struct TrajectoryErrorStatistics
+    {
+        unsigned long pairs = 0;
+        // estimates without ground truth close enough in time.
+        unsigned long unmatched = 0;
+        // absolute trajectory error after aligning the estimates to the ground truth.
+        double ateRmse = 0.0;
+        // error of the latest estimate under the same alignment.
+        double ateLast = 0.0;
+        unsigned long rpePairs = 0;
+        double rpeTranslationRmse = 0.0;
+        // in radians.
+        double rpeRotationRmse = 0.0;
+        // maps the estimates onto the ground truth.
+        Eigen::Affine3d alignment = Eigen::Affine3d::Identity();
+
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    };
+
+    /**
+     * @brief Measures ATE and RPE of the tracked poses against a ground truth stream while running.
+     * The ground truth is kept in a buffer sorted by stamp, so an estimate is associated by a binary search and
+     * interpolated between its neighbours. Estimates wait until ground truth past their stamp arrived.
+     * The ATE uses the rigid alignment of Umeyama. Its inputs (means, cross covariance and spread of the positions)
+     * are running sums, so adding a pair is O(1) and an evaluation is a single 3x3 SVD.
+     * As the poses are evaluated when tracked, later loop corrections are not part of the result.
+     */
+    class TrajectoryEvaluator
+    {
+    public:
+        /**
+         * @param maxTimeDifference Maximum distance in seconds between an estimate and its ground truth.
+         * @param rpeDelta Time in seconds between the two poses of a relative pose error.
+         */
+        TrajectoryEvaluator(double maxTimeDifference, double rpeDelta);
+
+        void addGroundTruth(double stamp, const Eigen::Affine3d &pose);
+
+        void addEstimate(double stamp, const Eigen::Affine3d &pose);
+
+        TrajectoryErrorStatistics getStatistics();
+
+        /**
+         * @brief Forgets all poses, e.g. when the ground truth was reset.
+         */
+        void reset();
+
+        double getRpeDelta();
+
+    private:
+        struct StampedPose
+        {
+            double stamp;
+            Eigen::Affine3d pose;
+
+            EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+        };
+
+        struct PosePair
+        {
+            double stamp;
+            Eigen::Affine3d estimate;
+            Eigen::Affine3d groundTruth;
+
+            EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+        };
+
+        /**
+         * @brief Associates the pending estimates which are covered by the ground truth.
+         */
+        void associate();
+
+        /**
+         * @return 1 if associated, 0 if not yet covered by the ground truth, -1 if it can not be associated.
+         */
+        int interpolateGroundTruth(double stamp, Eigen::Affine3d &pose);
+
+        void addPair(const PosePair &pair);
+
+        double maxTimeDifference_;
+        double rpeDelta_;
+
+        std::mutex mutex_;
+        std::deque<StampedPose, Eigen::aligned_allocator<StampedPose>> groundTruth_;
+        std::deque<StampedPose, Eigen::aligned_allocator<StampedPose>> pendingEstimates_;
+        // associated pairs of the last rpeDelta seconds.
+        std::deque<PosePair, Eigen::aligned_allocator<PosePair>> recentPairs_;
+        double lastEstimateStamp_;
+
+        // running sums of the alignment, p are the estimated and q the ground truth positions.
+        unsigned long pairs_;
+        unsigned long unmatched_;
+        Eigen::Vector3d sumP_;
+        Eigen::Vector3d sumQ_;
+        // sum of q * p^T.
+        Eigen::Matrix3d sumQP_;
+        double sumPP_;
+        double sumQQ_;
+        Eigen::Vector3d lastP_;
+        Eigen::Vector3d lastQ_;
+
+        unsigned long rpePairs_;
+        double sumRpeTranslation2_;
+        double sumRpeRotation2_;
+    };
+}
+
+#endif
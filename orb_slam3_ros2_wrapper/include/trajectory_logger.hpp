@@ -0,0 +1,127 @@
+/**
+ * @file trajectory_logger.hpp
+ * @brief Definition of the TrajectoryLogger class.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#ifndef ORB_WRAPPER_TRAJECTORY_LOGGER_HPP_
+#define ORB_WRAPPER_TRAJECTORY_LOGGER_HPP_
+
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <Eigen/StdVector>
+
+#include "occupancy_grid_builder.hpp"
+
+namespace ORB_SLAM3_Wrapper
+{
+    /**
+     * @brief Pose of a single frame as it was tracked.
+     */
+    struct TrajectoryRecord
+    {
+        double stamp = 0.0;
+        // ORB_SLAM3::Tracking::eTrackingState
+        int trackingState = 0;
+        // keyframe the pose is anchored to, -1 if the frame was not tracked.
+        long anchorId = -1;
+        // pose of the camera in the global frame.
+        Eigen::Affine3d pose;
+        // pose of the camera relative to the anchor keyframe.
+        Eigen::Affine3d anchorRelative;
+
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    };
+
+    /**
+     * @brief Statistics of the trajectory logger.
+     */
+    struct TrajectoryLoggerStatistics
+    {
+        unsigned long records = 0;
+        unsigned long written = 0;
+        unsigned long pending = 0;
+        unsigned long batches = 0;
+        unsigned long exports = 0;
+        bool failed = false;
+    };
+
+    /**
+     * @brief Appends the pose of every frame to a file from a background thread.
+     * The records are written in batches and flushed after every batch, so a crash loses at most the last batch.
+     * Formats:
+     *  - "tum": "stamp tx ty tz qx qy qz qw" per tracked frame, frames which were not tracked are "#" comment lines
+     *    with their tracking state.
+     *  - "binary": the header "ORBTRAJ1" followed by little endian records of the stamp (float64), the tracking
+     *    state (int32), the anchor keyframe (int64) and the pose and the anchor relative pose
+     *    (7 float64 each: tx ty tz qx qy qz qw). It keeps everything needed to re-export the trajectory offline.
+     * As the log only holds the poses at tracking time, exportCorrected re-exports the trajectory with the latest
+     * poses of the anchor keyframes, i.e. including loop closures and global BAs.
+     */
+    class TrajectoryLogger
+    {
+    public:
+        /**
+         * @param path File the records are appended to.
+         * @param binary True for the binary format, false for the TUM format.
+         * @param flushPeriod Maximum time in seconds between a record and the write of its batch.
+         */
+        TrajectoryLogger(const std::string &path, bool binary, double flushPeriod);
+        ~TrajectoryLogger();
+
+        /**
+         * @brief Queues the record of a frame. Never blocks on the disk.
+         */
+        void log(const TrajectoryRecord &record);
+
+        /**
+         * @brief Queues the export of all records so far in TUM format, with their poses corrected by the current
+         * poses of the anchor keyframes. Records whose anchor has no pose keep their logged pose.
+         * @param path Destination file, it is replaced.
+         * @param anchorPoses Current poses of the anchor keyframes in the global frame.
+         */
+        void exportCorrected(const std::string &path, std::shared_ptr<const KeyFramePoses> anchorPoses);
+
+        TrajectoryLoggerStatistics getStatistics();
+
+    private:
+        struct ExportJob
+        {
+            std::string path;
+            std::shared_ptr<const KeyFramePoses> anchorPoses;
+        };
+
+        typedef std::vector<TrajectoryRecord, Eigen::aligned_allocator<TrajectoryRecord>> Records;
+
+        void run();
+        void writeBatch(const Records &batch);
+        void writeCorrected(const ExportJob &job);
+
+        std::string path_;
+        bool binary_;
+        double flushPeriod_;
+        std::FILE *file_;
+
+        std::mutex queueMutex_;
+        std::condition_variable queueCondition_;
+        Records queue_;
+        std::deque<ExportJob> exports_;
+        TrajectoryLoggerStatistics statistics_;
+        bool stop_;
+
+        // all written records, only used by the writer thread.
+        Records history_;
+        std::thread worker_;
+    };
+}
+
+#endif
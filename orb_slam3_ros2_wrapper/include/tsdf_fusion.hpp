@@ -0,0 +1,185 @@
+/**
+ * @file tsdf_fusion.hpp
+ * @brief Definition of the TsdfFusion class.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#ifndef ORB_WRAPPER_TSDF_FUSION_HPP_
+#define ORB_WRAPPER_TSDF_FUSION_HPP_
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include <opencv2/core/core.hpp>
+#include <sensor_msgs/msg/image.hpp>
+
+#include "occupancy_grid_builder.hpp"
+
+namespace ORB_SLAM3_Wrapper
+{
+    /**
+     * @brief Pinhole intrinsics of the depth camera.
+     */
+    struct DepthCameraIntrinsics
+    {
+        float fx = 0.0f;
+        float fy = 0.0f;
+        float cx = 0.0f;
+        float cy = 0.0f;
+        // raw depth values are divided by this factor to get meters (ORB-SLAM3 DepthMapFactor).
+        float depthMapFactor = 1.0f;
+
+        /**
+         * @brief Reads the intrinsics from an ORB-SLAM3 settings file (old and new format).
+         * @return False if the file has no pinhole intrinsics.
+         */
+        static bool fromSettingsFile(const std::string &settingsFile, DepthCameraIntrinsics &intrinsics);
+    };
+
+    /**
+     * @brief Statistics of the TSDF fusion.
+     */
+    struct TsdfStatistics
+    {
+        unsigned long blocks = 0;
+        unsigned long keyFrames = 0;
+        unsigned long pendingJobs = 0;
+        unsigned long reintegratedKeyFrames = 0;
+        unsigned long removedKeyFrames = 0;
+        // keyframes whose depth was dropped to bound the memory, their geometry stays in the volume as it is.
+        unsigned long frozenKeyFrames = 0;
+        double lastIntegrationMs = 0.0;
+    };
+
+    /**
+     * @brief Fuses the depth images of the keyframes into a voxel hashed TSDF in a background thread.
+     * The volume is split into blocks of 8x8x8 voxels which are allocated around the observed surfaces. A block is
+     * updated as a whole with fixed size Eigen array expressions, which the compiler turns into SIMD code. The
+     * subsampled depth and the pose of the most recent keyframes are kept, so that a keyframe which moved (loop
+     * closure, merge) is removed from the blocks it touched by integrating it again with negative weight, and added
+     * at its new pose. Keyframes reported as removed (culled, or of a cleared map) are only subtracted. Keyframes
+     * missing from a pose update (not inserted into a map yet) keep their geometry.
+     * Beyond maxKeyFrames the depth of the oldest keyframe is dropped, its geometry is frozen in the volume.
+     * The tracking thread only enqueues the shared depth message.
+     */
+    class TsdfFusion
+    {
+    public:
+        /**
+         * @param intrinsics Intrinsics of the depth camera.
+         * @param voxelSize Edge length of a voxel in meters.
+         * @param truncation Truncation distance of the signed distance in meters.
+         * @param maxDepth Depth readings beyond this range are ignored.
+         * @param pixelStride Only every n-th pixel in both directions is used.
+         * @param maxKeyFrames Number of keyframes whose depth is kept for corrections, 0 keeps all.
+         */
+        TsdfFusion(const DepthCameraIntrinsics &intrinsics, float voxelSize, float truncation, float maxDepth, int pixelStride,
+                   size_t maxKeyFrames);
+        ~TsdfFusion();
+
+        /**
+         * @brief Queues the depth image of a new keyframe.
+         * @param kFId ID of the keyframe.
+         * @param pose Pose of the keyframe in the global frame (ROS convention).
+         * @param depth Depth image of the keyframe.
+         */
+        void addKeyFrame(long unsigned int kFId, const Eigen::Affine3d &pose, const sensor_msgs::msg::Image::SharedPtr depth);
+
+        /**
+         * @brief Queues the current poses of all keyframes. Moved keyframes are reintegrated, removed ones subtracted.
+         * A pose update which is still queued is replaced, the removed keyframes of both are kept.
+         * @param poses Poses of the keyframes in the global frame.
+         * @param removedKeyFrames IDs of keyframes which do not exist anymore.
+         */
+        void updatePoses(const KeyFramePoses &poses, const std::vector<long unsigned int> &removedKeyFrames);
+
+        /**
+         * @brief Returns the voxel centers close to the surface (zero crossing) in the global frame.
+         * @param points Output points.
+         * @param minWeight Minimum integration weight of a voxel.
+         */
+        void extractSurfacePoints(std::vector<Eigen::Vector3f> &points, float minWeight);
+
+        TsdfStatistics getStatistics();
+
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    private:
+        static const int blockSide = 8;
+        static const int blockVoxels = blockSide * blockSide * blockSide;
+
+        struct Block
+        {
+            Eigen::Vector3i index;
+            Eigen::Array<float, blockVoxels, 1> tsdf;
+            Eigen::Array<float, blockVoxels, 1> weight;
+
+            EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+        };
+
+        struct KeyFrameDepth
+        {
+            Eigen::Affine3d pose;
+            // subsampled depth in meters.
+            cv::Mat depth;
+
+            EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+        };
+
+        struct Job
+        {
+            long unsigned int kFId = 0;
+            Eigen::Affine3d pose;
+            sensor_msgs::msg::Image::SharedPtr depth;
+            std::shared_ptr<KeyFramePoses> poses;
+            std::vector<long unsigned int> removedKeyFrames;
+
+            EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+        };
+
+        void run();
+        void processPoses(const KeyFramePoses &poses, const std::vector<long unsigned int> &removedKeyFrames);
+        bool prepareDepth(const sensor_msgs::msg::Image::SharedPtr msg, cv::Mat &depth);
+        void integrate(const KeyFrameDepth &keyFrame, float sign);
+        int64_t blockKey(const Eigen::Vector3i &index);
+
+        DepthCameraIntrinsics intrinsics_;
+        float voxelSize_;
+        float truncation_;
+        float maxDepth_;
+        int pixelStride_;
+        size_t maxKeyFrames_;
+        // voxel centers of a block relative to the block origin.
+        Eigen::Matrix<float, 3, blockVoxels> voxelOffsets_;
+        // reused by integrate, only used by the worker thread.
+        std::unordered_set<int64_t> touched_;
+        std::vector<Eigen::Vector3i> touchedIndices_;
+
+        std::mutex volumeMutex_;
+        std::unordered_map<int64_t, std::unique_ptr<Block>> blocks_;
+        std::map<long unsigned int, KeyFrameDepth, std::less<long unsigned int>,
+                 Eigen::aligned_allocator<std::pair<const long unsigned int, KeyFrameDepth>>>
+            keyFrames_;
+        TsdfStatistics statistics_;
+
+        std::mutex queueMutex_;
+        std::condition_variable queueCondition_;
+        std::deque<std::shared_ptr<Job>> jobs_;
+        bool stop_;
+        std::thread worker_;
+    };
+}
+
+#endif
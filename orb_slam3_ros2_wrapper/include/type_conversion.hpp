@@ -93,6 +93,13 @@ namespace ORB_SLAM3_Wrapper
 
         sensor_msgs::msg::PointCloud2 MapPointsToPCL(std::vector<Eigen::Vector3f>& mapPoints);
 
+        /**
+         * @brief Writes map points into an existing point cloud, reusing its buffers.
+         * @param mapPoints Map points in the global frame.
+         * @param cloud Output point cloud.
+         */
+        void MapPointsToPCL(const std::vector<Eigen::Vector3f> &mapPoints, sensor_msgs::msg::PointCloud2 &cloud);
+
         // **************************************TRANSFORMATIONS*************************************
         /**
          * @brief Transforms a pose using a reference pose and SE3 transform.
@@ -0,0 +1,92 @@
+#!/usr/bin/python3
+# -*- coding: utf-8 -*-
+# Test bench: the rgbd node fed by the synthetic load generator, measured by the latency probe.
+# Example:
+#   ros2 launch orb_slam3_ros2_wrapper load_test.launch.py image_rate:=60.0 burst_period:=2.0 output_file:=/tmp/run.csv
+import os
+
+from ament_index_python.packages import get_package_share_directory
+from launch import LaunchDescription
+from launch.actions import DeclareLaunchArgument, OpaqueFunction
+from launch_ros.actions import Node
+from nav2_common.launch import RewrittenYaml
+
+def generate_launch_description():
+
+#---------------------------------------------
+
+    #Essential_paths
+    orb_wrapper_pkg = get_package_share_directory('orb_slam3_ros2_wrapper')
+#---------------------------------------------
+
+    # LAUNCH ARGS
+    launch_args = [
+        DeclareLaunchArgument('namespace', default_value='load_test',
+            description='Namespace of the node, the generator and the probe'),
+        DeclareLaunchArgument('vocabulary_file', default_value='/home/orb/ORB_SLAM3/Vocabulary/ORBvoc.txt',
+            description='ORB vocabulary'),
+        DeclareLaunchArgument('config_file', default_value=os.path.join(orb_wrapper_pkg, 'params', 'scout_v2_rgbd.yaml'),
+            description='ORB-SLAM3 settings, the camera size has to match width and height'),
+        DeclareLaunchArgument('params_file', default_value=os.path.join(orb_wrapper_pkg, 'params', 'rgbd-ros-params.yaml'),
+            description='ROS2 parameters of the rgbd node'),
+        DeclareLaunchArgument('image_rate', default_value='30.0', description='RGB-D pairs per second'),
+        DeclareLaunchArgument('imu_rate', default_value='200.0', description='IMU messages per second'),
+        DeclareLaunchArgument('odom_rate', default_value='50.0', description='Odometry messages per second'),
+        DeclareLaunchArgument('width', default_value='640', description='Image width'),
+        DeclareLaunchArgument('height', default_value='480', description='Image height'),
+        DeclareLaunchArgument('burst_period', default_value='0.0', description='Seconds between image bursts, 0 disables them'),
+        DeclareLaunchArgument('burst_size', default_value='5', description='Images per burst'),
+        DeclareLaunchArgument('jitter_ms', default_value='0.0', description='Standard deviation of the publish times'),
+        DeclareLaunchArgument('get_map_rate', default_value='2.0', description='GetMap calls per second, 0 disables them'),
+        DeclareLaunchArgument('output_file', default_value='', description='CSV file the probe appends its reports to'),
+    ]
+#---------------------------------------------
+
+    def all_nodes_launch(context):
+        config = context.launch_configurations
+        namespace = config['namespace']
+
+        configured_params = RewrittenYaml(
+            source_file=config['params_file'],
+            root_key=namespace,
+            param_rewrites={},
+            convert_types=True)
+
+        orb_slam3_node = Node(
+            package='orb_slam3_ros2_wrapper',
+            executable='rgbd',
+            output='screen',
+            namespace=namespace,
+            arguments=[config['vocabulary_file'], config['config_file']],
+            parameters=[configured_params])
+
+        load_generator = Node(
+            package='orb_slam3_ros2_wrapper',
+            executable='load_generator.py',
+            output='screen',
+            namespace=namespace,
+            parameters=[{
+                'image_rate': float(config['image_rate']),
+                'imu_rate': float(config['imu_rate']),
+                'odom_rate': float(config['odom_rate']),
+                'width': int(config['width']),
+                'height': int(config['height']),
+                'burst_period': float(config['burst_period']),
+                'burst_size': int(config['burst_size']),
+                'jitter_ms': float(config['jitter_ms']),
+                'get_map_rate': float(config['get_map_rate']),
+            }])
+
+        latency_probe = Node(
+            package='orb_slam3_ros2_wrapper',
+            executable='latency_probe.py',
+            output='screen',
+            namespace=namespace,
+            parameters=[{'output_file': config['output_file']}])
+
+        return [orb_slam3_node, load_generator, latency_probe]
+
+    opaque_function = OpaqueFunction(function=all_nodes_launch)
+#---------------------------------------------
+
+    return LaunchDescription(launch_args + [opaque_function])
@@ -0,0 +1,140 @@
+#!/usr/bin/python3
+# -*- coding: utf-8 -*-
+# Measures the rgbd node under the load of load_generator.py: stage latencies from the diagnostics, image
+# transport latency, frames which were published but not tracked and the freshness of the map -> odom TF.
+# Every report period a line is logged and, with output_file set, appended as CSV so runs can be compared.
+import os
+import threading
+
+import numpy as np
+import rclpy
+from rclpy.node import Node
+from diagnostic_msgs.msg import DiagnosticArray
+from sensor_msgs.msg import Image
+from std_msgs.msg import UInt64
+from tf2_msgs.msg import TFMessage
+
+CSV_COLUMNS = ['time', 'published_frames', 'tracked_frames', 'dropped_frames', 'skipped_frames',
+               'image_latency_p50_ms', 'image_latency_p99_ms', 'track_rgbd_avg_ms', 'track_rgbd_max_ms',
+               'imu_slicing_avg_ms', 'tf_age_p50_ms', 'tf_age_max_ms', 'tf_rate_hz']
+
+
+def percentile(values, q):
+    return float(np.percentile(values, q)) if values else float('nan')
+
+
+class LatencyProbe(Node):
+
+    def __init__(self):
+        super().__init__('latency_probe')
+        self.declare_parameter('odom_frame', 'odom')
+        # the node stamps map -> odom this far ahead of the odometry it was computed from.
+        self.declare_parameter('tf_future_offset', 0.5)
+        self.declare_parameter('report_period', 5.0)
+        self.declare_parameter('output_file', '')
+        self.odom_frame = self.get_parameter('odom_frame').value
+        self.tf_offset = self.get_parameter('tf_future_offset').value
+        self.report_period = self.get_parameter('report_period').value
+        self.output_file = self.get_parameter('output_file').value
+
+        self.lock = threading.Lock()
+        self.published_frames = 0
+        self.tracked_frames = 0
+        self.skipped_frames = 0
+        self.stages = {}
+        self.image_latencies = []
+        self.tf_ages = []
+        self.tf_updates = 0
+
+        self.create_subscription(UInt64, 'load_generator/published_frames', self.count_callback, 10)
+        self.create_subscription(Image, 'camera/image_raw', self.image_callback, 10)
+        self.create_subscription(TFMessage, '/tf', self.tf_callback, 100)
+        self.create_subscription(DiagnosticArray, '/diagnostics', self.diagnostics_callback, 10)
+        if self.output_file and not os.path.exists(self.output_file):
+            with open(self.output_file, 'w') as output:
+                output.write(','.join(CSV_COLUMNS) + '\n')
+        self.create_timer(self.report_period, self.report)
+
+    def now(self):
+        return self.get_clock().now().nanoseconds * 1e-9
+
+    @staticmethod
+    def stamp_to_sec(stamp):
+        return stamp.sec + stamp.nanosec * 1e-9
+
+    def count_callback(self, msg):
+        with self.lock:
+            self.published_frames = msg.data
+
+    def image_callback(self, msg):
+        latency = (self.now() - self.stamp_to_sec(msg.header.stamp)) * 1000.0
+        with self.lock:
+            self.image_latencies.append(latency)
+
+    def tf_callback(self, msg):
+        now = self.now()
+        for transform in msg.transforms:
+            # the node sends map -> odom once per tracked frame.
+            if transform.child_frame_id.split('/')[-1] != self.odom_frame.split('/')[-1]:
+                continue
+            age = (now - self.stamp_to_sec(transform.header.stamp) + self.tf_offset) * 1000.0
+            with self.lock:
+                self.tf_ages.append(age)
+                self.tf_updates += 1
+                self.tracked_frames += 1
+
+    def diagnostics_callback(self, msg):
+        for status in msg.status:
+            if not status.name.endswith(': tracking'):
+                continue
+            values = {value.key: value.value for value in status.values}
+            with self.lock:
+                self.skipped_frames = int(values.get('skipped frames', 0))
+                for key, value in values.items():
+                    if key.endswith('[ms]'):
+                        try:
+                            self.stages[key] = float(value)
+                        except ValueError:
+                            pass
+
+    def report(self):
+        with self.lock:
+            image_latencies, self.image_latencies = self.image_latencies, []
+            tf_ages, self.tf_ages = self.tf_ages, []
+            tf_updates, self.tf_updates = self.tf_updates, 0
+            row = {
+                'time': self.now(),
+                'published_frames': self.published_frames,
+                'tracked_frames': self.tracked_frames,
+                # frames which were published but did not lead to a map -> odom update, incl. skipped ones.
+                'dropped_frames': max(0, self.published_frames - self.tracked_frames),
+                'skipped_frames': self.skipped_frames,
+                'track_rgbd_avg_ms': self.stages.get('track_rgbd avg [ms]', float('nan')),
+                'track_rgbd_max_ms': self.stages.get('track_rgbd max [ms]', float('nan')),
+                'imu_slicing_avg_ms': self.stages.get('imu_slicing avg [ms]', float('nan')),
+            }
+        row['image_latency_p50_ms'] = percentile(image_latencies, 50)
+        row['image_latency_p99_ms'] = percentile(image_latencies, 99)
+        row['tf_age_p50_ms'] = percentile(tf_ages, 50)
+        row['tf_age_max_ms'] = max(tf_ages) if tf_ages else float('nan')
+        row['tf_rate_hz'] = tf_updates / self.report_period
+        self.get_logger().info(
+            'frames published {published_frames} tracked {tracked_frames} dropped {dropped_frames} | '
+            'image latency p50 {image_latency_p50_ms:.1f} p99 {image_latency_p99_ms:.1f} ms | '
+            'track_rgbd avg {track_rgbd_avg_ms:.1f} max {track_rgbd_max_ms:.1f} ms | '
+            'tf age p50 {tf_age_p50_ms:.1f} max {tf_age_max_ms:.1f} ms at {tf_rate_hz:.1f} Hz'.format(**row))
+        if self.output_file:
+            with open(self.output_file, 'a') as output:
+                output.write(','.join(str(row[column]) for column in CSV_COLUMNS) + '\n')
+
+
+def main(args=None):
+    rclpy.init(args=args)
+    latency_probe = LatencyProbe()
+    rclpy.spin(latency_probe)
+    latency_probe.destroy_node()
+    rclpy.shutdown()
+
+
+if __name__ == '__main__':
+    main()
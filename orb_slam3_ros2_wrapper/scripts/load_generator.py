@@ -0,0 +1,194 @@
+#!/usr/bin/python3
+# -*- coding: utf-8 -*-
+# Publishes synthetic RGB-D, IMU and odometry at configurable rates, bursts and jitter and calls the
+# GetMap service in a loop, to load the rgbd node for latency tests (see load_test.launch.py).
+import random
+import threading
+import time
+
+import numpy as np
+import rclpy
+from rclpy.node import Node
+from nav_msgs.msg import Odometry
+from sensor_msgs.msg import Image, Imu
+from std_msgs.msg import UInt64
+from slam_msgs.srv import GetMap
+
+
+class LoadGenerator(Node):
+
+    def __init__(self):
+        super().__init__('load_generator')
+        self.declare_parameter('image_rate', 30.0)
+        self.declare_parameter('imu_rate', 200.0)
+        self.declare_parameter('odom_rate', 50.0)
+        self.declare_parameter('width', 640)
+        self.declare_parameter('height', 480)
+        # every burst_period seconds burst_size images are sent back to back, 0 disables the bursts.
+        self.declare_parameter('burst_period', 0.0)
+        self.declare_parameter('burst_size', 5)
+        # standard deviation of the publish times in milliseconds.
+        self.declare_parameter('jitter_ms', 0.0)
+        # GetMap calls per second, 0 disables them.
+        self.declare_parameter('get_map_rate', 2.0)
+        self.declare_parameter('camera_frame', 'camera_link')
+        self.declare_parameter('odom_frame', 'odom')
+        self.declare_parameter('base_frame', 'base_footprint')
+
+        self.width = self.get_parameter('width').value
+        self.height = self.get_parameter('height').value
+        self.jitter = self.get_parameter('jitter_ms').value / 1000.0
+        self.camera_frame = self.get_parameter('camera_frame').value
+        self.odom_frame = self.get_parameter('odom_frame').value
+        self.base_frame = self.get_parameter('base_frame').value
+
+        self.rgb_pub = self.create_publisher(Image, 'camera/image_raw', 10)
+        self.depth_pub = self.create_publisher(Image, 'camera/depth/image_raw', 10)
+        self.imu_pub = self.create_publisher(Imu, 'imu', 1000)
+        self.odom_pub = self.create_publisher(Odometry, 'odom', 1000)
+        # number of published RGB-D pairs, the probe compares it with the tracked frames.
+        self.count_pub = self.create_publisher(UInt64, 'load_generator/published_frames', 10)
+        self.get_map_client = self.create_client(GetMap, 'orb_slam3_get_map_data')
+
+        # a random texture which slides through the image, so ORB finds features which move between frames.
+        rng = np.random.default_rng(0)
+        texture = rng.integers(0, 256, size=(self.height // 4, (self.width + 2 * self.height) // 4), dtype=np.uint8)
+        self.texture = np.kron(texture, np.ones((4, 4), dtype=np.uint8))
+        columns = np.arange(self.width, dtype=np.uint16)
+        self.depth = np.tile(1500 + columns, (self.height, 1)).astype('<u2')
+        self.published_frames = 0
+        self.get_map_latencies = []
+        self.lock = threading.Lock()
+        self.running = True
+
+        self.threads = [
+            threading.Thread(target=self.image_loop, daemon=True),
+            threading.Thread(target=self.stream_loop, args=(self.get_parameter('imu_rate').value, self.publish_imu), daemon=True),
+            threading.Thread(target=self.stream_loop, args=(self.get_parameter('odom_rate').value, self.publish_odom), daemon=True),
+        ]
+        if self.get_parameter('get_map_rate').value > 0.0:
+            self.threads.append(threading.Thread(target=self.get_map_loop, daemon=True))
+        for thread in self.threads:
+            thread.start()
+        self.create_timer(5.0, self.report)
+
+    def stamp(self):
+        return self.get_clock().now().to_msg()
+
+    def sleep_until(self, deadline):
+        # the jitter shifts single publishes, the schedule itself does not drift.
+        delay = deadline - time.monotonic()
+        if self.jitter > 0.0:
+            delay += random.gauss(0.0, self.jitter)
+        if delay > 0.0:
+            time.sleep(delay)
+
+    def stream_loop(self, rate, publish):
+        if rate <= 0.0:
+            return
+        period = 1.0 / rate
+        deadline = time.monotonic()
+        while self.running and rclpy.ok():
+            deadline += period
+            self.sleep_until(deadline)
+            publish()
+
+    def image_loop(self):
+        period = 1.0 / self.get_parameter('image_rate').value
+        burst_period = self.get_parameter('burst_period').value
+        burst_size = self.get_parameter('burst_size').value
+        deadline = time.monotonic()
+        next_burst = deadline + burst_period
+        while self.running and rclpy.ok():
+            deadline += period
+            self.sleep_until(deadline)
+            frames = 1
+            if burst_period > 0.0 and time.monotonic() >= next_burst:
+                frames = burst_size
+                next_burst += burst_period
+            for _ in range(frames):
+                self.publish_rgbd()
+
+    def publish_rgbd(self):
+        stamp = self.stamp()
+        offset = (self.published_frames * 2) % (self.texture.shape[1] - self.width)
+        gray = self.texture[:, offset:offset + self.width]
+        rgb = Image()
+        rgb.header.stamp = stamp
+        rgb.header.frame_id = self.camera_frame
+        rgb.height = self.height
+        rgb.width = self.width
+        rgb.encoding = 'rgb8'
+        rgb.step = self.width * 3
+        rgb.data = np.repeat(gray[:, :, np.newaxis], 3, axis=2).tobytes()
+        depth = Image()
+        depth.header = rgb.header
+        depth.height = self.height
+        depth.width = self.width
+        depth.encoding = '16UC1'
+        depth.step = self.width * 2
+        depth.data = self.depth.tobytes()
+        self.rgb_pub.publish(rgb)
+        self.depth_pub.publish(depth)
+        with self.lock:
+            self.published_frames += 1
+            count = self.published_frames
+        self.count_pub.publish(UInt64(data=count))
+
+    def publish_imu(self):
+        imu = Imu()
+        imu.header.stamp = self.stamp()
+        imu.header.frame_id = self.camera_frame
+        imu.linear_acceleration.z = 9.81
+        imu.orientation.w = 1.0
+        self.imu_pub.publish(imu)
+
+    def publish_odom(self):
+        odom = Odometry()
+        odom.header.stamp = self.stamp()
+        odom.header.frame_id = self.odom_frame
+        odom.child_frame_id = self.base_frame
+        odom.pose.pose.orientation.w = 1.0
+        self.odom_pub.publish(odom)
+
+    def get_map_loop(self):
+        period = 1.0 / self.get_parameter('get_map_rate').value
+        while self.running and rclpy.ok() and not self.get_map_client.wait_for_service(timeout_sec=1.0):
+            self.get_logger().info('orb_slam3_get_map_data not available, waiting again...')
+        deadline = time.monotonic()
+        while self.running and rclpy.ok():
+            deadline += period
+            self.sleep_until(deadline)
+            request = GetMap.Request()
+            request.tracked_points = True
+            start = time.monotonic()
+            future = self.get_map_client.call_async(request)
+            future.add_done_callback(lambda _, start=start: self.get_map_done(start))
+
+    def get_map_done(self, start):
+        with self.lock:
+            self.get_map_latencies.append((time.monotonic() - start) * 1000.0)
+
+    def report(self):
+        with self.lock:
+            latencies = self.get_map_latencies
+            self.get_map_latencies = []
+            frames = self.published_frames
+        message = 'published frames: {}'.format(frames)
+        if latencies:
+            message += ', GetMap calls: {}, p50 {:.1f} ms, p99 {:.1f} ms'.format(
+                len(latencies), np.percentile(latencies, 50), np.percentile(latencies, 99))
+        self.get_logger().info(message)
+
+
+def main(args=None):
+    rclpy.init(args=args)
+    load_generator = LoadGenerator()
+    rclpy.spin(load_generator)
+    load_generator.running = False
+    load_generator.destroy_node()
+    rclpy.shutdown()
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,183 @@
+/**
+ * @file allocation_counter.cpp
+ * @brief Implementation of the AllocationCounter class and the replacement of the global operator new.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#include "allocation_counter.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+    std::atomic<bool> countingEnabled(false);
+    // constant initialized, so the thread local storage needs no initialization call inside operator new.
+    thread_local ORB_SLAM3_Wrapper::AllocationCount threadCount;
+
+    inline void count(std::size_t size)
+    {
+        if (countingEnabled.load(std::memory_order_relaxed))
+        {
+            threadCount.allocations++;
+            threadCount.bytes += size;
+        }
+    }
+
+    void *allocate(std::size_t size)
+    {
+        count(size);
+        void *pointer = std::malloc(size ? size : 1);
+        if (!pointer)
+        {
+            throw std::bad_alloc();
+        }
+        return pointer;
+    }
+
+    void *allocateAligned(std::size_t size, std::align_val_t alignment)
+    {
+        count(size);
+        std::size_t align = std::max(static_cast<std::size_t>(alignment), sizeof(void *));
+        void *pointer = nullptr;
+        if (posix_memalign(&pointer, align, size ? size : 1) != 0)
+        {
+            throw std::bad_alloc();
+        }
+        return pointer;
+    }
+}
+
+namespace ORB_SLAM3_Wrapper
+{
+    void AllocationCounter::setEnabled(bool enabled)
+    {
+        countingEnabled = enabled;
+    }
+
+    bool AllocationCounter::isEnabled()
+    {
+        return countingEnabled;
+    }
+
+    AllocationCount AllocationCounter::thread()
+    {
+        return threadCount;
+    }
+}
+
+void *operator new(std::size_t size)
+{
+    return allocate(size);
+}
+
+void *operator new[](std::size_t size)
+{
+    return allocate(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+    try
+    {
+        return allocate(size);
+    }
+    catch (std::bad_alloc &)
+    {
+        return nullptr;
+    }
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept
+{
+    return operator new(size, std::nothrow);
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment)
+{
+    return allocateAligned(size, alignment);
+}
+
+void *operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return allocateAligned(size, alignment);
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+    try
+    {
+        return allocateAligned(size, alignment);
+    }
+    catch (std::bad_alloc &)
+    {
+        return nullptr;
+    }
+}
+
+void *operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+    return operator new(size, alignment, std::nothrow);
+}
+
+void operator delete(void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void *pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, const std::nothrow_t &) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void *pointer, const std::nothrow_t &) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, std::align_val_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void *pointer, std::align_val_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, std::size_t, std::align_val_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void *pointer, std::size_t, std::align_val_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, std::align_val_t, const std::nothrow_t &) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void *pointer, std::align_val_t, const std::nothrow_t &) noexcept
+{
+    std::free(pointer);
+}
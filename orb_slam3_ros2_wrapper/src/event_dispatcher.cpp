@@ -0,0 +1,138 @@
+/**
+ * @file event_dispatcher.cpp
+ * @brief Implementation of the EventDispatcher class.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#include "event_dispatcher.hpp"
+
+namespace ORB_SLAM3_Wrapper
+{
+    EventDispatcher::EventDispatcher()
+        : nextId_(1),
+          stop_(false)
+    {
+        worker_ = std::thread(&EventDispatcher::run, this);
+    }
+
+    EventDispatcher::~EventDispatcher()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        condition_.notify_all();
+        worker_.join();
+    }
+
+    EventDispatcher::SubscriptionId EventDispatcher::subscribe(std::function<void(const TrackedPoseEvent &)> callback, size_t queueSize)
+    {
+        return addSubscription<TrackedPoseEvent>(callback, queueSize);
+    }
+
+    EventDispatcher::SubscriptionId EventDispatcher::subscribe(std::function<void(const KeyFrameEvent &)> callback, size_t queueSize)
+    {
+        return addSubscription<KeyFrameEvent>(callback, queueSize);
+    }
+
+    EventDispatcher::SubscriptionId EventDispatcher::subscribe(std::function<void(const MapCorrectedEvent &)> callback, size_t queueSize)
+    {
+        return addSubscription<MapCorrectedEvent>(callback, queueSize);
+    }
+
+    EventDispatcher::SubscriptionId EventDispatcher::subscribe(std::function<void(const StatusEvent &)> callback, size_t queueSize)
+    {
+        return addSubscription<StatusEvent>(callback, queueSize);
+    }
+
+    void EventDispatcher::unsubscribe(SubscriptionId id)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto isSubscription = [id](const auto &subscriber)
+        { return subscriber.first->id == id; };
+        trackedPoseSubscribers_.erase(std::remove_if(trackedPoseSubscribers_.begin(), trackedPoseSubscribers_.end(), isSubscription),
+                                      trackedPoseSubscribers_.end());
+        keyFrameSubscribers_.erase(std::remove_if(keyFrameSubscribers_.begin(), keyFrameSubscribers_.end(), isSubscription),
+                                   keyFrameSubscribers_.end());
+        mapCorrectedSubscribers_.erase(std::remove_if(mapCorrectedSubscribers_.begin(), mapCorrectedSubscribers_.end(), isSubscription),
+                                       mapCorrectedSubscribers_.end());
+        statusSubscribers_.erase(std::remove_if(statusSubscribers_.begin(), statusSubscribers_.end(), isSubscription),
+                                 statusSubscribers_.end());
+        auto subscription = subscriptions_.find(id);
+        if (subscription != subscriptions_.end())
+        {
+            subscription->second->pending.clear();
+            subscriptions_.erase(subscription);
+        }
+    }
+
+    void EventDispatcher::publish(const TrackedPoseEvent &event)
+    {
+        enqueue(event);
+    }
+
+    void EventDispatcher::publish(const KeyFrameEvent &event)
+    {
+        enqueue(event);
+    }
+
+    void EventDispatcher::publish(const MapCorrectedEvent &event)
+    {
+        enqueue(event);
+    }
+
+    void EventDispatcher::publish(const StatusEvent &event)
+    {
+        enqueue(event);
+    }
+
+    std::map<EventDispatcher::SubscriptionId, SubscriptionStatistics> EventDispatcher::getStatistics()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::map<SubscriptionId, SubscriptionStatistics> statistics;
+        for (const auto &subscription : subscriptions_)
+        {
+            statistics[subscription.first] = subscription.second->statistics;
+        }
+        return statistics;
+    }
+
+    void EventDispatcher::run()
+    {
+        // subscription which is served first in the next round.
+        SubscriptionId nextServed = 0;
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true)
+        {
+            condition_.wait(lock, [this]()
+                            { return stop_ || std::any_of(subscriptions_.begin(), subscriptions_.end(),
+                                                          [](const auto &subscription)
+                                                          { return !subscription.second->pending.empty(); }); });
+            if (stop_)
+            {
+                return;
+            }
+            // one event per subscription and round, so a busy subscription cannot starve the others.
+            auto subscription = subscriptions_.lower_bound(nextServed);
+            for (size_t checked = 0; checked < subscriptions_.size(); checked++, ++subscription)
+            {
+                if (subscription == subscriptions_.end())
+                {
+                    subscription = subscriptions_.begin();
+                }
+                if (!subscription->second->pending.empty())
+                {
+                    break;
+                }
+            }
+            std::shared_ptr<Subscription> served = subscription->second;
+            nextServed = served->id + 1;
+            std::function<void()> dispatch = std::move(served->pending.front());
+            served->pending.pop_front();
+            lock.unlock();
+            dispatch();
+            lock.lock();
+            served->statistics.delivered++;
+        }
+    }
+}
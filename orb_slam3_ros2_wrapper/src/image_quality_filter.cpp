@@ -0,0 +1,122 @@
+/**
+ * @file image_quality_filter.cpp
+ * @brief Implementation of the ImageQualityFilter class.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#include "image_quality_filter.hpp"
+
+#include <algorithm>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+namespace ORB_SLAM3_Wrapper
+{
+    namespace
+    {
+        // half of VGA, fine enough for the blur of the full image to show in the Laplacian.
+        const cv::Size imageSize(320, 240);
+        const cv::Size depthSize(80, 60);
+        // the image is split into gridCols x gridRows cells for the texture check.
+        const int gridCols = 8;
+        const int gridRows = 6;
+        // standard deviation of the gray values in a cell with enough contrast for FAST corners.
+        const double minCellContrast = 8.0;
+        const int darkLevel = 5;
+        const int brightLevel = 250;
+    }
+
+    ImageQualityFilter::ImageQualityFilter(double minSharpnessRatio, double maxClipped, double minTextured, double minValidDepth, int maxConsecutiveSkips)
+        : minSharpnessRatio_(minSharpnessRatio),
+          maxClipped_(maxClipped),
+          minTextured_(minTextured),
+          minValidDepth_(minValidDepth),
+          maxConsecutiveSkips_(std::max(0, maxConsecutiveSkips)),
+          consecutiveSkips_(0),
+          averageSharpness_(0.0),
+          hasAverageSharpness_(false)
+    {
+    }
+
+    void ImageQualityFilter::measure(const cv::Mat &image, const cv::Mat &depth, ImageQuality &quality)
+    {
+        cv::resize(image, small_, imageSize, 0.0, 0.0, cv::INTER_NEAREST);
+        if (small_.channels() == 3)
+        {
+            cv::cvtColor(small_, gray_, cv::COLOR_RGB2GRAY);
+        }
+        else if (small_.channels() == 4)
+        {
+            cv::cvtColor(small_, gray_, cv::COLOR_RGBA2GRAY);
+        }
+        else
+        {
+            gray_ = small_;
+        }
+
+        cv::Scalar mean, stdDev;
+        cv::Laplacian(gray_, laplacian_, CV_16S);
+        cv::meanStdDev(laplacian_, mean, stdDev);
+        quality.sharpness = stdDev[0] * stdDev[0];
+
+        int clipped = cv::countNonZero(gray_ <= darkLevel) + cv::countNonZero(gray_ >= brightLevel);
+        quality.clipped = static_cast<double>(clipped) / gray_.total();
+
+        int texturedCells = 0;
+        int cellWidth = gray_.cols / gridCols;
+        int cellHeight = gray_.rows / gridRows;
+        for (int row = 0; row < gridRows; row++)
+        {
+            for (int col = 0; col < gridCols; col++)
+            {
+                cv::meanStdDev(gray_(cv::Rect(col * cellWidth, row * cellHeight, cellWidth, cellHeight)), mean, stdDev);
+                texturedCells += stdDev[0] > minCellContrast ? 1 : 0;
+            }
+        }
+        quality.textured = static_cast<double>(texturedCells) / (gridCols * gridRows);
+
+        quality.validDepth = 1.0;
+        if (!depth.empty())
+        {
+            cv::resize(depth, smallDepth_, depthSize, 0.0, 0.0, cv::INTER_NEAREST);
+            // NaN compares false, so it is not counted as valid.
+            int valid = depth.depth() == CV_32F ? cv::countNonZero(smallDepth_ > 0.0f) : cv::countNonZero(smallDepth_);
+            quality.validDepth = static_cast<double>(valid) / smallDepth_.total();
+        }
+    }
+
+    bool ImageQualityFilter::admitFrame(const cv::Mat &image, const cv::Mat &depth)
+    {
+        ImageQuality quality;
+        measure(image, depth, quality);
+        statistics_.frames++;
+        statistics_.last = quality;
+
+        bool blurred = hasAverageSharpness_ && quality.sharpness < minSharpnessRatio_ * averageSharpness_;
+        bool badExposure = quality.clipped > maxClipped_;
+        bool textureless = quality.textured < minTextured_;
+        bool badDepth = quality.validDepth < minValidDepth_;
+        statistics_.blurred += blurred ? 1 : 0;
+        statistics_.badExposure += badExposure ? 1 : 0;
+        statistics_.textureless += textureless ? 1 : 0;
+        statistics_.badDepth += badDepth ? 1 : 0;
+
+        if ((blurred || badExposure || textureless || badDepth) && consecutiveSkips_ < maxConsecutiveSkips_)
+        {
+            consecutiveSkips_++;
+            statistics_.skipped++;
+            return false;
+        }
+        consecutiveSkips_ = 0;
+        // the average follows the tracked frames, so it adapts to a scene with less detail within a few skip limits.
+        const double alpha = 0.1;
+        averageSharpness_ = hasAverageSharpness_ ? (1.0 - alpha) * averageSharpness_ + alpha * quality.sharpness : quality.sharpness;
+        hasAverageSharpness_ = true;
+        return true;
+    }
+
+    ImageQualityStatistics ImageQualityFilter::getStatistics()
+    {
+        return statistics_;
+    }
+}
@@ -0,0 +1,354 @@
+/**
+ * @file input_recorder.cpp
+ * @brief Implementation of the InputRecorder and InputLogReader classes.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#include "input_recorder.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#include <opencv2/imgcodecs.hpp>
+#include <sensor_msgs/image_encodings.hpp>
+
+namespace ORB_SLAM3_Wrapper
+{
+    namespace
+    {
+        const char fileMagic[] = "ORBREC01";
+        const uint8_t codecRaw = 0;
+        const uint8_t codecPng = 1;
+
+        template <typename T>
+        void append(std::vector<unsigned char> &buffer, const T &value)
+        {
+            const unsigned char *bytes = reinterpret_cast<const unsigned char *>(&value);
+            buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+        }
+
+        void appendString(std::vector<unsigned char> &buffer, const std::string &value)
+        {
+            append(buffer, static_cast<uint32_t>(value.size()));
+            buffer.insert(buffer.end(), value.begin(), value.end());
+        }
+
+        template <typename T>
+        bool read(std::FILE *file, T &value)
+        {
+            return std::fread(&value, sizeof(T), 1, file) == 1;
+        }
+
+        bool readString(std::FILE *file, std::string &value)
+        {
+            uint32_t size;
+            if (!read(file, size))
+            {
+                return false;
+            }
+            value.resize(size);
+            return size == 0 || std::fread(&value[0], 1, size, file) == size;
+        }
+
+        /**
+         * @brief Wraps the data of an image message, 16 bit depth images as 16 bit so PNG compresses them well,
+         * everything else as rows of bytes. Either way the decoded matrix holds the original bytes.
+         */
+        cv::Mat messageView(const sensor_msgs::msg::Image &image)
+        {
+            if (image.height == 0 || image.step == 0 || image.data.size() != static_cast<size_t>(image.height) * image.step)
+            {
+                return cv::Mat();
+            }
+            unsigned char *data = const_cast<unsigned char *>(image.data.data());
+            bool sixteenBit = false;
+            try
+            {
+                sixteenBit = sensor_msgs::image_encodings::bitDepth(image.encoding) == 16 &&
+                             sensor_msgs::image_encodings::numChannels(image.encoding) == 1;
+            }
+            catch (std::runtime_error &)
+            {
+                // unknown encodings are stored as bytes.
+            }
+            if (sixteenBit && !image.is_bigendian && image.step % 2 == 0)
+            {
+                return cv::Mat(image.height, image.step / 2, CV_16UC1, data, image.step);
+            }
+            return cv::Mat(image.height, image.step, CV_8UC1, data, image.step);
+        }
+    }
+
+    InputRecorder::InputRecorder(const std::string &path, int compressionLevel, size_t maxQueuedFrames)
+        : path_(path),
+          compressionLevel_(std::min(compressionLevel, 9)),
+          maxQueuedFrames_(std::max<size_t>(maxQueuedFrames, 1)),
+          file_(nullptr),
+          nextSequence_(0),
+          started_(false),
+          stop_(false)
+    {
+        std::rename(path_.c_str(), (path_ + ".old").c_str());
+        file_ = std::fopen(path_.c_str(), "wb");
+        if (!file_)
+        {
+            std::cerr << "Could not open the input recording " << path_ << ": " << std::strerror(errno) << std::endl;
+            statistics_.failed = true;
+        }
+        else
+        {
+            std::fwrite(fileMagic, 1, sizeof(fileMagic) - 1, file_);
+        }
+        worker_ = std::thread(&InputRecorder::run, this);
+    }
+
+    InputRecorder::~InputRecorder()
+    {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex_);
+            stop_ = true;
+        }
+        queueCondition_.notify_all();
+        worker_.join();
+        if (file_)
+        {
+            std::fclose(file_);
+        }
+    }
+
+    void InputRecorder::record(RecordedFrame &frame, std::chrono::steady_clock::time_point receiveTime)
+    {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex_);
+            if (!started_)
+            {
+                startTime_ = receiveTime;
+                started_ = true;
+            }
+            frame.sequence = nextSequence_++;
+            frame.receiveNs = std::chrono::duration_cast<std::chrono::nanoseconds>(receiveTime - startTime_).count();
+            if (queue_.size() >= maxQueuedFrames_ || statistics_.failed)
+            {
+                statistics_.dropped++;
+                return;
+            }
+            // the messages are shared, they are not modified after the tracking.
+            queue_.push_back(frame);
+            statistics_.frames++;
+            statistics_.pending = queue_.size();
+        }
+        queueCondition_.notify_one();
+    }
+
+    InputRecorderStatistics InputRecorder::getStatistics()
+    {
+        std::lock_guard<std::mutex> lock(queueMutex_);
+        return statistics_;
+    }
+
+    void InputRecorder::run()
+    {
+        std::vector<unsigned char> buffer;
+        std::unique_lock<std::mutex> lock(queueMutex_);
+        while (true)
+        {
+            queueCondition_.wait(lock, [this]()
+                                 { return stop_ || !queue_.empty(); });
+            if (queue_.empty())
+            {
+                return;
+            }
+            RecordedFrame frame = queue_.front();
+            queue_.pop_front();
+            lock.unlock();
+
+            // the encoding is the expensive part, it is done outside of the lock.
+            buffer.clear();
+            writeFrame(frame, buffer);
+            bool written = file_ && std::fwrite(buffer.data(), 1, buffer.size(), file_) == buffer.size();
+
+            lock.lock();
+            statistics_.pending = queue_.size();
+            if (written)
+            {
+                statistics_.bytes += buffer.size();
+            }
+            else
+            {
+                statistics_.failed = true;
+            }
+        }
+    }
+
+    void InputRecorder::writeFrame(const RecordedFrame &frame, std::vector<unsigned char> &buffer)
+    {
+        append(buffer, frame.sequence);
+        append(buffer, frame.receiveNs);
+        append(buffer, frame.imuSlicingMs);
+        append(buffer, frame.trackMs);
+        append(buffer, static_cast<int32_t>(frame.trackingState));
+        const float *pose = frame.Tcw.data();
+        for (int i = 0; i < Sophus::SE3f::num_parameters; i++)
+        {
+            append(buffer, pose[i]);
+        }
+        append(buffer, static_cast<uint32_t>(frame.imu.size()));
+        for (const auto &point : frame.imu)
+        {
+            append(buffer, point.t);
+            for (int i = 0; i < 3; i++)
+            {
+                append(buffer, point.a[i]);
+            }
+            for (int i = 0; i < 3; i++)
+            {
+                append(buffer, point.w[i]);
+            }
+        }
+        appendImage(*frame.rgb, buffer);
+        appendImage(*frame.depth, buffer);
+    }
+
+    void InputRecorder::appendImage(const sensor_msgs::msg::Image &image, std::vector<unsigned char> &buffer)
+    {
+        append(buffer, image.header.stamp.sec);
+        append(buffer, image.header.stamp.nanosec);
+        appendString(buffer, image.header.frame_id);
+        appendString(buffer, image.encoding);
+        append(buffer, image.height);
+        append(buffer, image.width);
+        append(buffer, image.step);
+        append(buffer, image.is_bigendian);
+
+        std::vector<unsigned char> encoded;
+        cv::Mat view = messageView(image);
+        if (compressionLevel_ >= 0 && !view.empty() &&
+            cv::imencode(".png", view, encoded, {cv::IMWRITE_PNG_COMPRESSION, compressionLevel_}))
+        {
+            append(buffer, codecPng);
+            append(buffer, static_cast<uint64_t>(encoded.size()));
+            buffer.insert(buffer.end(), encoded.begin(), encoded.end());
+        }
+        else
+        {
+            append(buffer, codecRaw);
+            append(buffer, static_cast<uint64_t>(image.data.size()));
+            buffer.insert(buffer.end(), image.data.begin(), image.data.end());
+        }
+    }
+
+    InputLogReader::InputLogReader()
+        : file_(nullptr)
+    {
+    }
+
+    InputLogReader::~InputLogReader()
+    {
+        if (file_)
+        {
+            std::fclose(file_);
+        }
+    }
+
+    bool InputLogReader::open(const std::string &path)
+    {
+        if (file_)
+        {
+            std::fclose(file_);
+        }
+        file_ = std::fopen(path.c_str(), "rb");
+        if (!file_)
+        {
+            std::cerr << "Could not open the input recording " << path << ": " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        char magic[sizeof(fileMagic) - 1];
+        if (std::fread(magic, 1, sizeof(magic), file_) != sizeof(magic) || std::memcmp(magic, fileMagic, sizeof(magic)) != 0)
+        {
+            std::cerr << path << " is not an input recording." << std::endl;
+            std::fclose(file_);
+            file_ = nullptr;
+            return false;
+        }
+        return true;
+    }
+
+    bool InputLogReader::next(RecordedFrame &frame)
+    {
+        if (!file_)
+        {
+            return false;
+        }
+        int32_t trackingState;
+        if (!read(file_, frame.sequence) || !read(file_, frame.receiveNs) || !read(file_, frame.imuSlicingMs) ||
+            !read(file_, frame.trackMs) || !read(file_, trackingState))
+        {
+            return false;
+        }
+        frame.trackingState = trackingState;
+        float *pose = frame.Tcw.data();
+        for (int i = 0; i < Sophus::SE3f::num_parameters; i++)
+        {
+            if (!read(file_, pose[i]))
+            {
+                return false;
+            }
+        }
+        uint32_t imuCount;
+        if (!read(file_, imuCount))
+        {
+            return false;
+        }
+        frame.imu.clear();
+        frame.imu.reserve(imuCount);
+        for (uint32_t n = 0; n < imuCount; n++)
+        {
+            double t;
+            float values[6];
+            if (!read(file_, t) || std::fread(values, sizeof(float), 6, file_) != 6)
+            {
+                return false;
+            }
+            frame.imu.push_back(ORB_SLAM3::IMU::Point(values[0], values[1], values[2], values[3], values[4], values[5], t));
+        }
+        return readImage(frame.rgb) && readImage(frame.depth);
+    }
+
+    bool InputLogReader::readImage(sensor_msgs::msg::Image::ConstSharedPtr &image)
+    {
+        auto message = std::make_shared<sensor_msgs::msg::Image>();
+        uint8_t codec;
+        uint64_t size;
+        if (!read(file_, message->header.stamp.sec) || !read(file_, message->header.stamp.nanosec) ||
+            !readString(file_, message->header.frame_id) || !readString(file_, message->encoding) ||
+            !read(file_, message->height) || !read(file_, message->width) || !read(file_, message->step) ||
+            !read(file_, message->is_bigendian) || !read(file_, codec) || !read(file_, size))
+        {
+            return false;
+        }
+        std::vector<unsigned char> payload(size);
+        if (size > 0 && std::fread(payload.data(), 1, size, file_) != size)
+        {
+            return false;
+        }
+        if (codec == codecRaw)
+        {
+            message->data.swap(payload);
+        }
+        else
+        {
+            cv::Mat decoded = cv::imdecode(payload, cv::IMREAD_UNCHANGED);
+            size_t bytes = static_cast<size_t>(message->height) * message->step;
+            if (decoded.empty() || !decoded.isContinuous() || decoded.total() * decoded.elemSize() != bytes)
+            {
+                std::cerr << "Corrupt image in the input recording." << std::endl;
+                return false;
+            }
+            message->data.assign(decoded.data, decoded.data + bytes);
+        }
+        image = message;
+        return true;
+    }
+}
@@ -0,0 +1,383 @@
+/**
+ * @file keyframe_image_cache.cpp
+ * @brief Implementation of the KeyFrameImageCache class.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#include "keyframe_image_cache.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+#include <sys/stat.h>
+
+#include <opencv2/imgcodecs.hpp>
+
+namespace ORB_SLAM3_Wrapper
+{
+    namespace
+    {
+        // keyframes are rare, a full queue means the encoder can not keep up at all.
+        const size_t maxQueuedKeyFrames = 8;
+    }
+
+    KeyFrameImageCache::KeyFrameImageCache(size_t maxBytes, const std::string &spillDirectory, int compressionLevel)
+        : maxBytes_(maxBytes),
+          spillDirectory_(spillDirectory),
+          compressionLevel_(compressionLevel),
+          evictRequested_(false),
+          stop_(false),
+          dropped_(0)
+    {
+        if (isEnabled() && !spillDirectory_.empty() && mkdir(spillDirectory_.c_str(), 0755) != 0 && errno != EEXIST)
+        {
+            std::cerr << "Could not create keyframe image directory " << spillDirectory_ << ", evicted images are dropped." << std::endl;
+            spillDirectory_.clear();
+        }
+        worker_ = std::thread(&KeyFrameImageCache::run, this);
+    }
+
+    KeyFrameImageCache::~KeyFrameImageCache()
+    {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex_);
+            stop_ = true;
+        }
+        queueCondition_.notify_all();
+        worker_.join();
+    }
+
+    bool KeyFrameImageCache::isEnabled()
+    {
+        return maxBytes_ > 0;
+    }
+
+    bool KeyFrameImageCache::encode(const cv::Mat &image, std::vector<uchar> &buffer)
+    {
+        std::vector<int> params = {cv::IMWRITE_PNG_COMPRESSION, compressionLevel_};
+        if (image.type() == CV_32FC1)
+        {
+            // PNG has no float format, compress the raw bytes instead so that the depth stays bit exact.
+            cv::Mat continuous = image.isContinuous() ? image : image.clone();
+            cv::Mat bytes(continuous.rows, continuous.cols, CV_8UC4, continuous.data);
+            return cv::imencode(".png", bytes, buffer, params);
+        }
+        if (image.depth() != CV_8U && image.depth() != CV_16U)
+        {
+            std::cerr << "Keyframe image type " << image.type() << " can not be cached." << std::endl;
+            return false;
+        }
+        return cv::imencode(".png", image, buffer, params);
+    }
+
+    bool KeyFrameImageCache::decode(const std::vector<uchar> &buffer, int type, cv::Mat &image)
+    {
+        cv::Mat decoded = cv::imdecode(buffer, cv::IMREAD_UNCHANGED);
+        if (decoded.empty())
+        {
+            return false;
+        }
+        if (type == CV_32FC1)
+        {
+            image = cv::Mat(decoded.rows, decoded.cols, CV_32FC1, decoded.data).clone();
+        }
+        else
+        {
+            image = decoded;
+        }
+        return true;
+    }
+
+    bool KeyFrameImageCache::insert(long unsigned int kFId, double stamp,
+                                    const cv::Mat &rgb, const std::string &rgbEncoding,
+                                    const cv::Mat &depth, const std::string &depthEncoding)
+    {
+        if (!isEnabled())
+        {
+            return false;
+        }
+        {
+            std::lock_guard<std::mutex> lock(queueMutex_);
+            if (queue_.size() >= maxQueuedKeyFrames)
+            {
+                dropped_++;
+                return false;
+            }
+        }
+        // the images may share the buffers of the messages, copy them before the tracking continues.
+        Job job{kFId, stamp, rgb.clone(), rgbEncoding, depth.clone(), depthEncoding};
+        {
+            std::lock_guard<std::mutex> lock(queueMutex_);
+            queue_.push_back(std::move(job));
+        }
+        queueCondition_.notify_one();
+        return true;
+    }
+
+    void KeyFrameImageCache::run()
+    {
+        std::unique_lock<std::mutex> lock(queueMutex_);
+        while (true)
+        {
+            queueCondition_.wait(lock, [this]()
+                                 { return stop_ || evictRequested_ || !queue_.empty(); });
+            if (queue_.empty() && !evictRequested_)
+            {
+                return;
+            }
+            evictRequested_ = false;
+            if (queue_.empty())
+            {
+                lock.unlock();
+                evict();
+                lock.lock();
+                continue;
+            }
+            Job job = std::move(queue_.front());
+            queue_.pop_front();
+            lock.unlock();
+            store(job);
+            evict();
+            lock.lock();
+        }
+    }
+
+    void KeyFrameImageCache::store(const Job &job)
+    {
+        // compress outside of the lock, readers are only blocked for the bookkeeping.
+        Entry entry;
+        entry.kFId = job.kFId;
+        entry.stamp = job.stamp;
+        entry.rgbEncoding = job.rgbEncoding;
+        entry.depthEncoding = job.depthEncoding;
+        entry.rgbType = job.rgb.type();
+        entry.depthType = job.depth.type();
+        if (!encode(job.rgb, entry.rgb) || !encode(job.depth, entry.depth))
+        {
+            return;
+        }
+        size_t rawBytes = job.rgb.total() * job.rgb.elemSize() + job.depth.total() * job.depth.elemSize();
+
+        std::string staleSpillPath;
+        {
+            std::lock_guard<std::mutex> lock(cacheMutex_);
+            auto existing = entries_.find(job.kFId);
+            if (existing != entries_.end())
+            {
+                if (existing->second.second != lru_.end())
+                {
+                    statistics_.bytes -= existing->second.first.bytes();
+                    lru_.erase(existing->second.second);
+                }
+                else
+                {
+                    staleSpillPath = existing->second.first.spillPath;
+                    statistics_.spilledEntries--;
+                }
+                entries_.erase(existing);
+            }
+            lru_.push_front(job.kFId);
+            statistics_.bytes += entry.bytes();
+            statistics_.insertedRawBytes += rawBytes;
+            statistics_.insertedBytes += entry.bytes();
+            entries_[job.kFId] = std::make_pair(std::move(entry), lru_.begin());
+            statistics_.entries = entries_.size();
+        }
+        if (!staleSpillPath.empty())
+        {
+            std::remove(staleSpillPath.c_str());
+        }
+    }
+
+    bool KeyFrameImageCache::get(long unsigned int kFId, KeyFrameImages &images)
+    {
+        std::vector<uchar> rgb, depth;
+        int rgbType, depthType;
+        {
+            std::lock_guard<std::mutex> lock(cacheMutex_);
+            auto it = entries_.find(kFId);
+            if (it == entries_.end())
+            {
+                statistics_.misses++;
+                return false;
+            }
+            Entry &entry = it->second.first;
+            if (it->second.second == lru_.end())
+            {
+                // an entry which is still being spilled has its buffers, the worker notices it is back.
+                if (!entry.spilling && !unspill(entry))
+                {
+                    entries_.erase(it);
+                    statistics_.spilledEntries--;
+                    statistics_.entries = entries_.size();
+                    statistics_.misses++;
+                    return false;
+                }
+                if (!entry.spilling)
+                {
+                    statistics_.spilledEntries--;
+                }
+                entry.spilling = false;
+                statistics_.bytes += entry.bytes();
+                lru_.push_front(kFId);
+                it->second.second = lru_.begin();
+                rgb = entry.rgb;
+                depth = entry.depth;
+                {
+                    std::lock_guard<std::mutex> queueLock(queueMutex_);
+                    evictRequested_ = true;
+                }
+                queueCondition_.notify_one();
+            }
+            else
+            {
+                touch(kFId);
+                rgb = entry.rgb;
+                depth = entry.depth;
+            }
+            images.kFId = entry.kFId;
+            images.stamp = entry.stamp;
+            images.rgbEncoding = entry.rgbEncoding;
+            images.depthEncoding = entry.depthEncoding;
+            rgbType = entry.rgbType;
+            depthType = entry.depthType;
+            statistics_.hits++;
+        }
+        return decode(rgb, rgbType, images.rgb) && decode(depth, depthType, images.depth);
+    }
+
+    KeyFrameImageCacheStatistics KeyFrameImageCache::getStatistics()
+    {
+        KeyFrameImageCacheStatistics statistics;
+        {
+            std::lock_guard<std::mutex> lock(cacheMutex_);
+            statistics = statistics_;
+        }
+        std::lock_guard<std::mutex> lock(queueMutex_);
+        statistics.pending = queue_.size();
+        statistics.dropped = dropped_;
+        return statistics;
+    }
+
+    void KeyFrameImageCache::touch(long unsigned int kFId)
+    {
+        auto &entry = entries_[kFId];
+        lru_.splice(lru_.begin(), lru_, entry.second);
+        entry.second = lru_.begin();
+    }
+
+    void KeyFrameImageCache::evict()
+    {
+        // copies of the evicted entries, written without holding the lock.
+        std::vector<Entry> victims;
+        {
+            std::lock_guard<std::mutex> lock(cacheMutex_);
+            // the most recent entry always stays, even if it alone exceeds the budget.
+            while (statistics_.bytes > maxBytes_ && lru_.size() > 1)
+            {
+                auto it = entries_.find(lru_.back());
+                lru_.pop_back();
+                it->second.second = lru_.end();
+                Entry &entry = it->second.first;
+                statistics_.bytes -= entry.bytes();
+                if (spillDirectory_.empty())
+                {
+                    entries_.erase(it);
+                    continue;
+                }
+                entry.spilling = true;
+                entry.spillPath = spillDirectory_ + "/keyframe_" + std::to_string(entry.kFId) + ".bin";
+                victims.push_back(entry);
+            }
+            statistics_.entries = entries_.size();
+        }
+        if (victims.empty())
+        {
+            return;
+        }
+
+        std::vector<bool> spilled(victims.size());
+        for (size_t i = 0; i < victims.size(); i++)
+        {
+            spilled[i] = spill(victims[i]);
+        }
+
+        std::vector<std::string> staleSpillPaths;
+        {
+            std::lock_guard<std::mutex> lock(cacheMutex_);
+            for (size_t i = 0; i < victims.size(); i++)
+            {
+                auto it = entries_.find(victims[i].kFId);
+                // a reader brought the entry back meanwhile, its file is not needed.
+                if (it == entries_.end() || !it->second.first.spilling)
+                {
+                    if (spilled[i])
+                    {
+                        staleSpillPaths.push_back(victims[i].spillPath);
+                    }
+                    continue;
+                }
+                if (!spilled[i])
+                {
+                    entries_.erase(it);
+                    continue;
+                }
+                Entry &entry = it->second.first;
+                entry.spilling = false;
+                std::vector<uchar>().swap(entry.rgb);
+                std::vector<uchar>().swap(entry.depth);
+                statistics_.spilledEntries++;
+            }
+            statistics_.entries = entries_.size();
+        }
+        for (const auto &path : staleSpillPaths)
+        {
+            std::remove(path.c_str());
+        }
+    }
+
+    bool KeyFrameImageCache::spill(const Entry &entry)
+    {
+        std::ofstream out(entry.spillPath, std::ios::binary | std::ios::trunc);
+        uint64_t rgbSize = entry.rgb.size(), depthSize = entry.depth.size();
+        out.write(reinterpret_cast<const char *>(&rgbSize), sizeof(rgbSize));
+        out.write(reinterpret_cast<const char *>(entry.rgb.data()), rgbSize);
+        out.write(reinterpret_cast<const char *>(&depthSize), sizeof(depthSize));
+        out.write(reinterpret_cast<const char *>(entry.depth.data()), depthSize);
+        out.close();
+        if (out.fail())
+        {
+            std::cerr << "Could not spill keyframe images to " << entry.spillPath << std::endl;
+            std::remove(entry.spillPath.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    bool KeyFrameImageCache::unspill(Entry &entry)
+    {
+        std::ifstream in(entry.spillPath, std::ios::binary);
+        uint64_t rgbSize = 0, depthSize = 0;
+        if (in.read(reinterpret_cast<char *>(&rgbSize), sizeof(rgbSize)))
+        {
+            entry.rgb.resize(rgbSize);
+            in.read(reinterpret_cast<char *>(entry.rgb.data()), rgbSize);
+        }
+        if (in.read(reinterpret_cast<char *>(&depthSize), sizeof(depthSize)))
+        {
+            entry.depth.resize(depthSize);
+            in.read(reinterpret_cast<char *>(entry.depth.data()), depthSize);
+        }
+        if (!in.good())
+        {
+            std::cerr << "Could not read keyframe images from " << entry.spillPath << std::endl;
+            return false;
+        }
+        in.close();
+        std::remove(entry.spillPath.c_str());
+        entry.spillPath.clear();
+        return true;
+    }
+}
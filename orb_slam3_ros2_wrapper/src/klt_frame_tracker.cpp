@@ -0,0 +1,140 @@
+/**
+ * @file klt_frame_tracker.cpp
+ * @brief Implementation of the KltFrameTracker class.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#include "klt_frame_tracker.hpp"
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include <opencv2/calib3d/calib3d.hpp>
+#include <opencv2/core/eigen.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/video/tracking.hpp>
+
+namespace ORB_SLAM3_Wrapper
+{
+    namespace
+    {
+        const cv::Size windowSize(21, 21);
+        const int maxPyramidLevel = 3;
+        const int ransacIterations = 50;
+    }
+
+    KltFrameTracker::KltFrameTracker(float fx, float fy, float cx, float cy, int minInliers, double maxReprojectionError)
+        : cameraMatrix_((cv::Mat_<double>(3, 3) << fx, 0.0, cx, 0.0, fy, cy, 0.0, 0.0, 1.0)),
+          minInliers_(minInliers),
+          maxReprojectionError_(maxReprojectionError),
+          hasReference_(false)
+    {
+    }
+
+    void KltFrameTracker::toGray(const cv::Mat &image, cv::Mat &gray)
+    {
+        if (image.channels() == 3)
+        {
+            cv::cvtColor(image, gray, cv::COLOR_RGB2GRAY);
+        }
+        else if (image.channels() == 4)
+        {
+            cv::cvtColor(image, gray, cv::COLOR_RGBA2GRAY);
+        }
+        else
+        {
+            gray = image;
+        }
+    }
+
+    void KltFrameTracker::setReference(const cv::Mat &image, const Sophus::SE3f &Tcw, const std::vector<cv::Point2f> &keyPoints,
+                                       const std::vector<cv::Point3f> &mapPoints)
+    {
+        toGray(image, gray_);
+        cv::buildOpticalFlowPyramid(gray_, lastPyramid_, windowSize, maxPyramidLevel);
+        lastPoints_.assign(keyPoints.begin(), keyPoints.end());
+        mapPoints_.assign(mapPoints.begin(), mapPoints.end());
+        lastTcw_ = Tcw;
+        hasReference_ = static_cast<int>(lastPoints_.size()) >= minInliers_;
+    }
+
+    void KltFrameTracker::reset()
+    {
+        hasReference_ = false;
+    }
+
+    bool KltFrameTracker::hasReference()
+    {
+        return hasReference_;
+    }
+
+    bool KltFrameTracker::track(const cv::Mat &image, Sophus::SE3f &Tcw)
+    {
+        if (!hasReference_)
+        {
+            return false;
+        }
+        statistics_.frames++;
+        toGray(image, gray_);
+        cv::buildOpticalFlowPyramid(gray_, pyramid_, windowSize, maxPyramidLevel);
+        cv::calcOpticalFlowPyrLK(lastPyramid_, pyramid_, lastPoints_, points_, status_, error_, windowSize, maxPyramidLevel);
+
+        matchedPoints_.clear();
+        matchedMapPoints_.clear();
+        for (size_t i = 0; i < points_.size(); i++)
+        {
+            if (status_[i])
+            {
+                matchedPoints_.push_back(points_[i]);
+                matchedMapPoints_.push_back(mapPoints_[i]);
+            }
+        }
+        statistics_.lastPoints = matchedPoints_.size();
+        statistics_.lastInliers = 0;
+        if (static_cast<int>(matchedPoints_.size()) < minInliers_)
+        {
+            statistics_.failed++;
+            hasReference_ = false;
+            return false;
+        }
+
+        // the previous pose is the initial guess, the motion between two camera frames is small.
+        cv::Mat rotation, rvec, tvec;
+        cv::eigen2cv(Eigen::Matrix3d(lastTcw_.rotationMatrix().cast<double>()), rotation);
+        cv::Rodrigues(rotation, rvec);
+        cv::eigen2cv(Eigen::Vector3d(lastTcw_.translation().cast<double>()), tvec);
+        bool solved = cv::solvePnPRansac(matchedMapPoints_, matchedPoints_, cameraMatrix_, cv::noArray(), rvec, tvec, true,
+                                         ransacIterations, static_cast<float>(maxReprojectionError_), 0.99, inliers_, cv::SOLVEPNP_ITERATIVE);
+        statistics_.lastInliers = inliers_.size();
+        if (!solved || static_cast<int>(inliers_.size()) < minInliers_)
+        {
+            statistics_.failed++;
+            hasReference_ = false;
+            return false;
+        }
+
+        cv::Rodrigues(rvec, rotation);
+        Eigen::Matrix3d R;
+        Eigen::Vector3d t;
+        cv::cv2eigen(rotation, R);
+        cv::cv2eigen(tvec, t);
+        Tcw = Sophus::SE3f(Eigen::Quaternionf(R.cast<float>()).normalized(), t.cast<float>());
+
+        // only the inliers are followed into the next frame.
+        lastPoints_.clear();
+        mapPoints_.clear();
+        for (int inlier : inliers_)
+        {
+            lastPoints_.push_back(matchedPoints_[inlier]);
+            mapPoints_.push_back(matchedMapPoints_[inlier]);
+        }
+        std::swap(lastPyramid_, pyramid_);
+        lastTcw_ = Tcw;
+        return true;
+    }
+
+    KltTrackerStatistics KltFrameTracker::getStatistics()
+    {
+        return statistics_;
+    }
+}
@@ -0,0 +1,44 @@
+/**
+ * @file map_output_cache.cpp
+ * @brief Implementation of the MapOutputCache class.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#include "map_output_cache.hpp"
+
+namespace ORB_SLAM3_Wrapper
+{
+    void MapOutputCache::publish(const rclcpp::Time &stamp, const std::string &frameId,
+                                 rclcpp::Publisher<MapPointArrayAdapter> &mapPointsPub,
+                                 rclcpp::Publisher<KeyFramePoseArrayAdapter> &keyFramePosesPub)
+    {
+        mapPoints_.header.stamp = stamp;
+        // assigned into the kept string, so a long frame ID is only allocated once.
+        mapPoints_.header.frame_id = frameId;
+        keyFramePoses_.header = mapPoints_.header;
+        mapPointsPub.publish(std::make_unique<MapPointArray>(mapPoints_));
+        keyFramePosesPub.publish(std::make_unique<KeyFramePoseArray>(keyFramePoses_));
+    }
+
+    const MapPointArray &MapOutputCache::getMapPoints()
+    {
+        return mapPoints_;
+    }
+
+    const KeyFramePoseArray &MapOutputCache::getKeyFramePoses()
+    {
+        return keyFramePoses_;
+    }
+
+    std::vector<Eigen::Vector3f> &MapOutputCache::preparePoints()
+    {
+        mapPoints_.points.reset();
+        if (!points_ || points_.use_count() > 1)
+        {
+            size_t lastSize = points_ ? points_->size() : 0;
+            points_ = std::make_shared<std::vector<Eigen::Vector3f>>();
+            points_->reserve(lastSize);
+        }
+        return *points_;
+    }
+}
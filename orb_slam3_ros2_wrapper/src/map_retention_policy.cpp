@@ -0,0 +1,221 @@
+/**
+ * @file map_retention_policy.cpp
+ * @brief Implementation of the MapRetentionPolicy class.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#include "map_retention_policy.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <mutex>
+
+namespace ORB_SLAM3_Wrapper
+{
+    MapRetentionPolicy::MapRetentionPolicy(size_t memoryBudgetBytes, double redundancyThreshold, int minObservations, int protectedKeyFrames)
+        : memoryBudgetBytes_(memoryBudgetBytes),
+          redundancyThreshold_(redundancyThreshold),
+          minObservations_(minObservations),
+          protectedKeyFrames_(protectedKeyFrames)
+    {
+    }
+
+    size_t MapRetentionPolicy::estimateKeyFrameBytes(ORB_SLAM3::KeyFrame *pKF)
+    {
+        // keypoints (distorted and undistorted), ORB descriptor, depth and right coordinate,
+        // map point association and the BoW feature vector entry of every feature.
+        const size_t perFeature = 2 * sizeof(cv::KeyPoint) + 32 + 2 * sizeof(float) + sizeof(ORB_SLAM3::MapPoint *) + 16;
+        return sizeof(ORB_SLAM3::KeyFrame) + static_cast<size_t>(pKF->N) * perFeature;
+    }
+
+    size_t MapRetentionPolicy::estimateMapPointBytes(ORB_SLAM3::MapPoint *pMP)
+    {
+        // descriptor and one node of the observation map per observing keyframe. Observations() counts a stereo
+        // or RGB-D observation twice, the map has one entry per keyframe.
+        const size_t perObservation = 48;
+        return sizeof(ORB_SLAM3::MapPoint) + 32 + pMP->GetObservations().size() * perObservation;
+    }
+
+    MemoryUsage MapRetentionPolicy::estimateUsage(ORB_SLAM3::Atlas *atlas)
+    {
+        MemoryUsage usage;
+        for (auto pMap : atlas->GetAllMaps())
+        {
+            usage.maps++;
+            for (auto pKF : pMap->GetAllKeyFrames())
+            {
+                if (pKF->isBad())
+                {
+                    continue;
+                }
+                usage.keyFrames++;
+                usage.keyFrameBytes += estimateKeyFrameBytes(pKF);
+            }
+            for (auto pMP : pMap->GetAllMapPoints())
+            {
+                if (pMP->isBad())
+                {
+                    continue;
+                }
+                usage.mapPoints++;
+                usage.mapPointBytes += estimateMapPointBytes(pMP);
+            }
+        }
+        return usage;
+    }
+
+    double MapRetentionPolicy::redundancy(ORB_SLAM3::KeyFrame *pKF)
+    {
+        int validPoints = 0;
+        int redundantPoints = 0;
+        for (auto pMP : pKF->GetMapPoints())
+        {
+            if (pMP->isBad())
+            {
+                continue;
+            }
+            validPoints++;
+            // the keyframe itself plus at least three other keyframes.
+            if (pMP->GetObservations().size() > 3)
+            {
+                redundantPoints++;
+            }
+        }
+        return validPoints > 0 ? static_cast<double>(redundantPoints) / validPoints : 0.0;
+    }
+
+    bool MapRetentionPolicy::isEvictable(ORB_SLAM3::KeyFrame *pKF, ORB_SLAM3::Map *pMap, bool isCurrentMap)
+    {
+        if (pKF->isBad() || pKF->mnId == pMap->GetInitKFid() || pKF->GetParent() == nullptr)
+        {
+            return false;
+        }
+        // LocalMapping still optimizes the most recent keyframes.
+        if (isCurrentMap && pKF->mnId + static_cast<unsigned long>(protectedKeyFrames_) > pMap->GetMaxKFid())
+        {
+            return false;
+        }
+        // loop edges and weakly connected keyframes hold the graph together.
+        return pKF->GetLoopEdges().empty() && pKF->GetConnectedKeyFrames().size() >= 2;
+    }
+
+    size_t MapRetentionPolicy::evictMapPoints(ORB_SLAM3::Map *pMap, bool isCurrentMap, size_t bytesToEvict)
+    {
+        size_t detachedBytes = 0;
+        long int protectedFromKFId = isCurrentMap ? static_cast<long int>(pMap->GetMaxKFid()) - protectedKeyFrames_ : std::numeric_limits<long int>::max();
+        for (auto pMP : pMap->GetAllMapPoints())
+        {
+            if (detachedBytes >= bytesToEvict)
+            {
+                break;
+            }
+            if (pMP->isBad() || pMP->mnFirstKFid >= protectedFromKFId || static_cast<int>(pMP->GetObservations().size()) >= minObservations_)
+            {
+                continue;
+            }
+            size_t mapPointBytes = estimateMapPointBytes(pMP);
+            detachedBytes += mapPointBytes;
+            stats_.evictedBytes += mapPointBytes;
+            pMP->SetBadFlag();
+            stats_.evictedMapPoints++;
+        }
+        return detachedBytes;
+    }
+
+    size_t MapRetentionPolicy::evictKeyFrames(ORB_SLAM3::Map *pMap, bool isCurrentMap, size_t bytesToEvict)
+    {
+        // the IMU preintegration chain would have to be merged as well, LocalMapping does this itself.
+        if (pMap->IsInertial())
+        {
+            return 0;
+        }
+        std::vector<std::pair<double, ORB_SLAM3::KeyFrame *>> candidates;
+        for (auto pKF : pMap->GetAllKeyFrames())
+        {
+            if (!isEvictable(pKF, pMap, isCurrentMap))
+            {
+                continue;
+            }
+            double keyFrameRedundancy = redundancy(pKF);
+            if (keyFrameRedundancy >= redundancyThreshold_)
+            {
+                candidates.emplace_back(keyFrameRedundancy, pKF);
+            }
+        }
+        // most redundant first.
+        std::sort(candidates.begin(), candidates.end(),
+                  [](const std::pair<double, ORB_SLAM3::KeyFrame *> &a, const std::pair<double, ORB_SLAM3::KeyFrame *> &b)
+                  { return a.first > b.first; });
+
+        size_t detachedBytes = 0;
+        for (const auto &candidate : candidates)
+        {
+            if (detachedBytes >= bytesToEvict)
+            {
+                break;
+            }
+            // an earlier eviction may have changed the neighbourhood of this keyframe.
+            if (!isEvictable(candidate.second, pMap, isCurrentMap))
+            {
+                continue;
+            }
+            size_t keyFrameBytes = estimateKeyFrameBytes(candidate.second);
+            detachedBytes += keyFrameBytes;
+            stats_.evictedBytes += keyFrameBytes;
+            candidate.second->SetBadFlag();
+            stats_.evictedKeyFrames++;
+        }
+        return detachedBytes;
+    }
+
+    bool MapRetentionPolicy::exceedsBudget(const MemoryUsage &usage)
+    {
+        return memoryBudgetBytes_ > 0 && usage.totalBytes() > memoryBudgetBytes_;
+    }
+
+    bool MapRetentionPolicy::enforce(ORB_SLAM3::Atlas *atlas)
+    {
+        stats_.runs++;
+        MemoryUsage usage = estimateUsage(atlas);
+        if (!exceedsBudget(usage))
+        {
+            return false;
+        }
+        size_t usedBytes = usage.totalBytes();
+        size_t bytesToEvict = usedBytes - memoryBudgetBytes_;
+
+        // inactive maps first, the current map is shared with LocalMapping.
+        ORB_SLAM3::Map *pCurrentMap = atlas->GetCurrentMap();
+        std::vector<ORB_SLAM3::Map *> maps = atlas->GetAllMaps();
+        std::stable_partition(maps.begin(), maps.end(), [pCurrentMap](ORB_SLAM3::Map *pMap)
+                              { return pMap != pCurrentMap; });
+
+        size_t detachedBytes = 0;
+        // weak landmarks are cheaper to lose than keyframes.
+        for (int pass = 0; pass < 2 && detachedBytes < bytesToEvict; pass++)
+        {
+            for (auto pMap : maps)
+            {
+                if (detachedBytes >= bytesToEvict)
+                {
+                    break;
+                }
+                std::unique_lock<std::mutex> lock(pMap->mMutexMapUpdate);
+                bool isCurrentMap = pMap == pCurrentMap;
+                detachedBytes += pass == 0 ? evictMapPoints(pMap, isCurrentMap, bytesToEvict - detachedBytes)
+                                        : evictKeyFrames(pMap, isCurrentMap, bytesToEvict - detachedBytes);
+            }
+        }
+        return detachedBytes > 0;
+    }
+
+    RetentionStatistics MapRetentionPolicy::getStatistics()
+    {
+        return stats_;
+    }
+
+    size_t MapRetentionPolicy::getMemoryBudget()
+    {
+        return memoryBudgetBytes_;
+    }
+}
@@ -0,0 +1,109 @@
+/**
+ * @file map_type_adapters.cpp
+ * @brief Conversions of the map type adapters.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#include "map_type_adapters.hpp"
+
+#include <cstring>
+
+#include <tf2_eigen/tf2_eigen.hpp>
+
+#include "type_conversion.hpp"
+
+using MapPointArrayAdapter = ORB_SLAM3_Wrapper::MapPointArrayAdapter;
+using KeyFramePoseArrayAdapter = ORB_SLAM3_Wrapper::KeyFramePoseArrayAdapter;
+using SharedImageAdapter = ORB_SLAM3_Wrapper::SharedImageAdapter;
+
+void MapPointArrayAdapter::convert_to_ros_message(const custom_type &source, ros_message_type &destination)
+{
+    static const std::vector<Eigen::Vector3f> noPoints;
+    ORB_SLAM3_Wrapper::WrapperTypeConversions conversions;
+    conversions.MapPointsToPCL(source.points ? *source.points : noPoints, destination);
+    destination.header = source.header;
+}
+
+void MapPointArrayAdapter::convert_to_custom(const ros_message_type &source, custom_type &destination)
+{
+    destination.header = source.header;
+    auto points = std::make_shared<std::vector<Eigen::Vector3f>>();
+    destination.points = points;
+    int offsets[3] = {-1, -1, -1};
+    const char *names[3] = {"x", "y", "z"};
+    for (const auto &field : source.fields)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            if (field.name == names[i] && field.datatype == sensor_msgs::msg::PointField::FLOAT32)
+            {
+                offsets[i] = field.offset;
+            }
+        }
+    }
+    if (offsets[0] < 0 || offsets[1] < 0 || offsets[2] < 0 || source.is_bigendian)
+    {
+        return;
+    }
+    points->reserve(static_cast<size_t>(source.width) * source.height);
+    for (size_t row = 0; row < source.height; row++)
+    {
+        const unsigned char *rowData = source.data.data() + row * source.row_step;
+        for (size_t column = 0; column < source.width; column++)
+        {
+            const unsigned char *pointData = rowData + column * source.point_step;
+            Eigen::Vector3f point;
+            for (int i = 0; i < 3; i++)
+            {
+                std::memcpy(&point[i], pointData + offsets[i], sizeof(float));
+            }
+            points->push_back(point);
+        }
+    }
+}
+
+void KeyFramePoseArrayAdapter::convert_to_ros_message(const custom_type &source, ros_message_type &destination)
+{
+    destination.header = source.header;
+    size_t numPoses = source.poses ? source.poses->size() : 0;
+    destination.poses_id.resize(numPoses);
+    destination.poses.resize(numPoses);
+    if (numPoses == 0)
+    {
+        return;
+    }
+    size_t index = 0;
+    for (const auto &pose : *source.poses)
+    {
+        destination.poses_id[index] = static_cast<int32_t>(pose.first);
+        destination.poses[index].header = source.header;
+        destination.poses[index].pose = tf2::toMsg(pose.second);
+        index++;
+    }
+}
+
+void KeyFramePoseArrayAdapter::convert_to_custom(const ros_message_type &source, custom_type &destination)
+{
+    destination.header = source.header;
+    auto poses = std::make_shared<ORB_SLAM3_Wrapper::KeyFramePoses>();
+    for (size_t i = 0; i < source.poses.size() && i < source.poses_id.size(); i++)
+    {
+        Eigen::Affine3d pose;
+        tf2::fromMsg(source.poses[i].pose, pose);
+        (*poses)[source.poses_id[i]] = pose;
+    }
+    destination.poses = poses;
+}
+
+void SharedImageAdapter::convert_to_ros_message(const custom_type &source, ros_message_type &destination)
+{
+    if (source.image)
+    {
+        destination = *source.image;
+    }
+}
+
+void SharedImageAdapter::convert_to_custom(const ros_message_type &source, custom_type &destination)
+{
+    destination.image = std::make_shared<const ros_message_type>(source);
+}
@@ -0,0 +1,174 @@
+/**
+ * @file map_visualizer.cpp
+ * @brief Implementation of the MapVisualizer class.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#include "map_visualizer.hpp"
+
+#include <cmath>
+
+namespace ORB_SLAM3_Wrapper
+{
+    MapVisualizer::MapVisualizer(const std::string &globalFrame, int fullRefreshInterval)
+        : globalFrame_(globalFrame),
+          fullRefreshInterval_(fullRefreshInterval),
+          updatesSinceRefresh_(0),
+          lastEdgesChecksum_(0)
+    {
+    }
+
+    void MapVisualizer::reset()
+    {
+        publishedKeyFrames_.clear();
+        updatesSinceRefresh_ = 0;
+        lastEdgesChecksum_ = 0;
+    }
+
+    bool MapVisualizer::hasMoved(const geometry_msgs::msg::Pose &previous, const geometry_msgs::msg::Pose &current)
+    {
+        // 1 cm or roughly 0.5 degrees.
+        double dx = previous.position.x - current.position.x;
+        double dy = previous.position.y - current.position.y;
+        double dz = previous.position.z - current.position.z;
+        double dot = previous.orientation.w * current.orientation.w +
+                     previous.orientation.x * current.orientation.x +
+                     previous.orientation.y * current.orientation.y +
+                     previous.orientation.z * current.orientation.z;
+        return (dx * dx + dy * dy + dz * dz) > 1e-4 || std::abs(dot) < 0.99999;
+    }
+
+    uint64_t MapVisualizer::edgesChecksum(const std::vector<std::pair<int, int>> &covisibilityEdges)
+    {
+        // the order of the covisibility lists follows the weights, so the mixed edges are summed up.
+        uint64_t checksum = covisibilityEdges.size();
+        for (const auto &edge : covisibilityEdges)
+        {
+            uint64_t x = (static_cast<uint64_t>(static_cast<uint32_t>(edge.first)) << 32) | static_cast<uint32_t>(edge.second);
+            x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+            checksum += x ^ (x >> 31);
+        }
+        return checksum;
+    }
+
+    visualization_msgs::msg::Marker MapVisualizer::makeMarker(const std::string &ns, int id, int type, const builtin_interfaces::msg::Time &stamp)
+    {
+        visualization_msgs::msg::Marker marker;
+        marker.header.frame_id = globalFrame_;
+        marker.header.stamp = stamp;
+        marker.ns = ns;
+        marker.id = id;
+        marker.type = type;
+        marker.action = visualization_msgs::msg::Marker::ADD;
+        marker.pose.orientation.w = 1.0;
+        marker.color.a = 1.0;
+        return marker;
+    }
+
+    void MapVisualizer::buildMarkers(const slam_msgs::msg::MapGraph &graph,
+                                     const std::vector<std::pair<int, int>> &covisibilityEdges,
+                                     const Eigen::Affine3d &cameraPose,
+                                     const builtin_interfaces::msg::Time &stamp,
+                                     visualization_msgs::msg::MarkerArray &markers)
+    {
+        markers.markers.clear();
+        bool fullRefresh = ++updatesSinceRefresh_ >= fullRefreshInterval_;
+        if (fullRefresh)
+        {
+            updatesSinceRefresh_ = 0;
+        }
+
+        // keyframes which were added or moved (e.g. after a loop closure).
+        bool graphChanged = false;
+        std::map<int, size_t> graphIndex;
+        for (size_t i = 0; i < graph.poses_id.size(); i++)
+        {
+            int kFId = graph.poses_id[i];
+            const geometry_msgs::msg::Pose &kFPose = graph.poses[i].pose;
+            graphIndex[kFId] = i;
+            auto published = publishedKeyFrames_.find(kFId);
+            if (!fullRefresh && published != publishedKeyFrames_.end() && !hasMoved(published->second, kFPose))
+            {
+                continue;
+            }
+            auto marker = makeMarker("keyframes", kFId, visualization_msgs::msg::Marker::ARROW, stamp);
+            marker.pose = kFPose;
+            marker.scale.x = 0.2;
+            marker.scale.y = 0.03;
+            marker.scale.z = 0.03;
+            marker.color.b = 1.0;
+            markers.markers.push_back(marker);
+            publishedKeyFrames_[kFId] = kFPose;
+            graphChanged = true;
+        }
+
+        // keyframes which are not part of the snapshot anymore (culled or belonging to an older map).
+        for (auto it = publishedKeyFrames_.begin(); it != publishedKeyFrames_.end();)
+        {
+            if (graphIndex.find(it->first) == graphIndex.end())
+            {
+                auto marker = makeMarker("keyframes", it->first, visualization_msgs::msg::Marker::ARROW, stamp);
+                marker.action = visualization_msgs::msg::Marker::DELETE;
+                markers.markers.push_back(marker);
+                it = publishedKeyFrames_.erase(it);
+                graphChanged = true;
+            }
+            else
+            {
+                ++it;
+            }
+        }
+
+        // the covisibility graph is a single line list, only resend it if any of its nodes or edges changed.
+        uint64_t checksum = edgesChecksum(covisibilityEdges);
+        if (fullRefresh || graphChanged || checksum != lastEdgesChecksum_)
+        {
+            auto marker = makeMarker("covisibility", 0, visualization_msgs::msg::Marker::LINE_LIST, stamp);
+            marker.scale.x = 0.01;
+            marker.color.g = 0.8;
+            marker.color.a = 0.6;
+            marker.points.reserve(2 * covisibilityEdges.size());
+            for (const auto &edge : covisibilityEdges)
+            {
+                auto first = graphIndex.find(edge.first);
+                auto second = graphIndex.find(edge.second);
+                if (first == graphIndex.end() || second == graphIndex.end())
+                {
+                    continue;
+                }
+                marker.points.push_back(graph.poses[first->second].pose.position);
+                marker.points.push_back(graph.poses[second->second].pose.position);
+            }
+            markers.markers.push_back(marker);
+            lastEdgesChecksum_ = checksum;
+        }
+
+        // the current camera as a frustum, x is forward in ROS coordinates.
+        auto camera = makeMarker("camera", 0, visualization_msgs::msg::Marker::LINE_LIST, stamp);
+        camera.pose = tf2::toMsg(cameraPose);
+        camera.scale.x = 0.02;
+        camera.color.r = 1.0;
+        const double depth = 0.3, halfWidth = 0.2, halfHeight = 0.15;
+        std::vector<Eigen::Vector3d> corners = {
+            Eigen::Vector3d(depth, halfWidth, halfHeight),
+            Eigen::Vector3d(depth, -halfWidth, halfHeight),
+            Eigen::Vector3d(depth, -halfWidth, -halfHeight),
+            Eigen::Vector3d(depth, halfWidth, -halfHeight)};
+        for (size_t i = 0; i < corners.size(); i++)
+        {
+            geometry_msgs::msg::Point origin, corner, nextCorner;
+            corner.x = corners[i].x();
+            corner.y = corners[i].y();
+            corner.z = corners[i].z();
+            nextCorner.x = corners[(i + 1) % corners.size()].x();
+            nextCorner.y = corners[(i + 1) % corners.size()].y();
+            nextCorner.z = corners[(i + 1) % corners.size()].z();
+            camera.points.push_back(origin);
+            camera.points.push_back(corner);
+            camera.points.push_back(corner);
+            camera.points.push_back(nextCorner);
+        }
+        markers.markers.push_back(camera);
+    }
+}
@@ -0,0 +1,275 @@
+/**
+ * @file occupancy_grid_builder.cpp
+ * @brief Implementation of the OccupancyGridBuilder class.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#include "occupancy_grid_builder.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+
+namespace ORB_SLAM3_Wrapper
+{
+    namespace
+    {
+        // the grid grows by this margin, so that it does not have to be resized on every new keyframe.
+        const double growMargin = 5.0;
+    }
+
+    OccupancyGridBuilder::OccupancyGridBuilder(double resolution, double minHeight, double maxHeight, int hitThreshold,
+                                               double maxRange, size_t recentKeyFrames, int fullRefreshInterval)
+        : resolution_(resolution),
+          minHeight_(minHeight),
+          maxHeight_(maxHeight),
+          hitThreshold_(std::max(1, hitThreshold)),
+          maxRange_(maxRange),
+          recentKeyFrames_(recentKeyFrames),
+          fullRefreshInterval_(fullRefreshInterval)
+    {
+        reset();
+    }
+
+    void OccupancyGridBuilder::reset()
+    {
+        originX_ = 0.0;
+        originY_ = 0.0;
+        width_ = 0;
+        height_ = 0;
+        hits_.clear();
+        free_.clear();
+        contributions_.clear();
+        dirtyMinX_ = INT_MAX;
+        dirtyMinY_ = INT_MAX;
+        dirtyMaxX_ = INT_MIN;
+        dirtyMaxY_ = INT_MIN;
+        fullMapPending_ = true;
+        updatesSinceFullMap_ = 0;
+    }
+
+    bool OccupancyGridBuilder::hasMoved(const Eigen::Affine3d &previous, const Eigen::Affine3d &current)
+    {
+        // a quarter cell or roughly half a degree.
+        Eigen::Affine3d delta = previous.inverse() * current;
+        return delta.translation().norm() > 0.25 * resolution_ ||
+               Eigen::AngleAxisd(delta.rotation()).angle() > 0.01;
+    }
+
+    void OccupancyGridBuilder::findChanged(const KeyFramePoses &poses, std::vector<long unsigned int> &changed)
+    {
+        changed.clear();
+        // culled keyframes and keyframes of maps which are gone.
+        for (auto it = contributions_.begin(); it != contributions_.end();)
+        {
+            if (poses.find(it->first) == poses.end())
+            {
+                rasterize(it->second, -1);
+                it = contributions_.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+        size_t index = 0;
+        for (const auto &pose : poses)
+        {
+            bool recent = index++ + recentKeyFrames_ >= poses.size();
+            auto contribution = contributions_.find(pose.first);
+            if (recent || contribution == contributions_.end() || hasMoved(contribution->second.pose, pose.second))
+            {
+                changed.push_back(pose.first);
+            }
+        }
+    }
+
+    void OccupancyGridBuilder::integrate(const KeyFrameLandmarksList &landmarks)
+    {
+        for (const auto &keyFrame : landmarks)
+        {
+            auto existing = contributions_.find(keyFrame.kFId);
+            if (existing != contributions_.end())
+            {
+                rasterize(existing->second, -1);
+                contributions_.erase(existing);
+            }
+            Contribution contribution;
+            contribution.pose = keyFrame.pose;
+            Eigen::Vector3f origin = keyFrame.pose.translation().cast<float>();
+            for (const auto &point : keyFrame.points)
+            {
+                if (point.z() >= minHeight_ && point.z() <= maxHeight_ && (point - origin).norm() <= maxRange_)
+                {
+                    contribution.points.push_back(point);
+                }
+            }
+            ensureContains(contribution.pose, contribution.points);
+            rasterize(contribution, 1);
+            contributions_[keyFrame.kFId] = contribution;
+        }
+    }
+
+    void OccupancyGridBuilder::ensureContains(const Eigen::Affine3d &pose, const std::vector<Eigen::Vector3f> &points)
+    {
+        double minX = pose.translation().x(), maxX = minX;
+        double minY = pose.translation().y(), maxY = minY;
+        for (const auto &point : points)
+        {
+            minX = std::min(minX, static_cast<double>(point.x()));
+            maxX = std::max(maxX, static_cast<double>(point.x()));
+            minY = std::min(minY, static_cast<double>(point.y()));
+            maxY = std::max(maxY, static_cast<double>(point.y()));
+        }
+        if (width_ > 0 && minX >= originX_ && minY >= originY_ &&
+            maxX < originX_ + width_ * resolution_ && maxY < originY_ + height_ * resolution_)
+        {
+            return;
+        }
+        if (width_ > 0)
+        {
+            minX = std::min(minX, originX_);
+            minY = std::min(minY, originY_);
+            maxX = std::max(maxX, originX_ + width_ * resolution_);
+            maxY = std::max(maxY, originY_ + height_ * resolution_);
+        }
+        // keep the old cells aligned with the new grid.
+        double newOriginX = originX_ - std::ceil((originX_ - (minX - growMargin)) / resolution_) * resolution_;
+        double newOriginY = originY_ - std::ceil((originY_ - (minY - growMargin)) / resolution_) * resolution_;
+        int newWidth = static_cast<int>(std::ceil((maxX + growMargin - newOriginX) / resolution_));
+        int newHeight = static_cast<int>(std::ceil((maxY + growMargin - newOriginY) / resolution_));
+        std::vector<int> newHits(static_cast<size_t>(newWidth) * newHeight, 0);
+        std::vector<int> newFree(static_cast<size_t>(newWidth) * newHeight, 0);
+        int offsetX = static_cast<int>(std::lround((originX_ - newOriginX) / resolution_));
+        int offsetY = static_cast<int>(std::lround((originY_ - newOriginY) / resolution_));
+        for (int y = 0; y < height_; y++)
+        {
+            std::copy(hits_.begin() + static_cast<size_t>(y) * width_, hits_.begin() + static_cast<size_t>(y + 1) * width_,
+                      newHits.begin() + static_cast<size_t>(y + offsetY) * newWidth + offsetX);
+            std::copy(free_.begin() + static_cast<size_t>(y) * width_, free_.begin() + static_cast<size_t>(y + 1) * width_,
+                      newFree.begin() + static_cast<size_t>(y + offsetY) * newWidth + offsetX);
+        }
+        originX_ = newOriginX;
+        originY_ = newOriginY;
+        width_ = newWidth;
+        height_ = newHeight;
+        hits_.swap(newHits);
+        free_.swap(newFree);
+        // subscribers need the new geometry, so the complete map is sent next.
+        fullMapPending_ = true;
+        dirtyMinX_ = INT_MAX;
+        dirtyMinY_ = INT_MAX;
+        dirtyMaxX_ = INT_MIN;
+        dirtyMaxY_ = INT_MIN;
+    }
+
+    void OccupancyGridBuilder::rasterize(const Contribution &contribution, int sign)
+    {
+        int originX = static_cast<int>(std::floor((contribution.pose.translation().x() - originX_) / resolution_));
+        int originY = static_cast<int>(std::floor((contribution.pose.translation().y() - originY_) / resolution_));
+        markDirty(originX, originY);
+        for (const auto &point : contribution.points)
+        {
+            int endX = static_cast<int>(std::floor((point.x() - originX_) / resolution_));
+            int endY = static_cast<int>(std::floor((point.y() - originY_) / resolution_));
+            // Bresenham, all cells before the landmark are free.
+            int x = originX, y = originY;
+            int dx = std::abs(endX - x), dy = -std::abs(endY - y);
+            int stepX = x < endX ? 1 : -1, stepY = y < endY ? 1 : -1;
+            int error = dx + dy;
+            while (x != endX || y != endY)
+            {
+                free_[static_cast<size_t>(y) * width_ + x] += sign;
+                int error2 = 2 * error;
+                if (error2 >= dy)
+                {
+                    error += dy;
+                    x += stepX;
+                }
+                if (error2 <= dx)
+                {
+                    error += dx;
+                    y += stepY;
+                }
+            }
+            hits_[static_cast<size_t>(endY) * width_ + endX] += sign;
+            markDirty(endX, endY);
+        }
+    }
+
+    void OccupancyGridBuilder::markDirty(int x, int y)
+    {
+        dirtyMinX_ = std::min(dirtyMinX_, x);
+        dirtyMinY_ = std::min(dirtyMinY_, y);
+        dirtyMaxX_ = std::max(dirtyMaxX_, x);
+        dirtyMaxY_ = std::max(dirtyMaxY_, y);
+    }
+
+    int8_t OccupancyGridBuilder::cellValue(size_t index)
+    {
+        if (hits_[index] >= hitThreshold_)
+        {
+            return 100;
+        }
+        return free_[index] > 0 ? 0 : -1;
+    }
+
+    bool OccupancyGridBuilder::hasDirtyRegion()
+    {
+        return dirtyMinX_ <= dirtyMaxX_;
+    }
+
+    void OccupancyGridBuilder::requestFullMap()
+    {
+        fullMapPending_ = true;
+    }
+
+    bool OccupancyGridBuilder::needsFullMap()
+    {
+        return width_ > 0 && (fullMapPending_ || updatesSinceFullMap_ >= fullRefreshInterval_);
+    }
+
+    void OccupancyGridBuilder::toMsg(nav_msgs::msg::OccupancyGrid &grid)
+    {
+        grid.info.resolution = resolution_;
+        grid.info.width = width_;
+        grid.info.height = height_;
+        grid.info.origin.position.x = originX_;
+        grid.info.origin.position.y = originY_;
+        grid.info.origin.position.z = 0.0;
+        grid.info.origin.orientation.w = 1.0;
+        grid.data.resize(hits_.size());
+        for (size_t i = 0; i < hits_.size(); i++)
+        {
+            grid.data[i] = cellValue(i);
+        }
+        dirtyMinX_ = INT_MAX;
+        dirtyMinY_ = INT_MAX;
+        dirtyMaxX_ = INT_MIN;
+        dirtyMaxY_ = INT_MIN;
+        fullMapPending_ = false;
+        updatesSinceFullMap_ = 0;
+    }
+
+    void OccupancyGridBuilder::dirtyRegionToMsg(map_msgs::msg::OccupancyGridUpdate &update)
+    {
+        update.x = dirtyMinX_;
+        update.y = dirtyMinY_;
+        update.width = dirtyMaxX_ - dirtyMinX_ + 1;
+        update.height = dirtyMaxY_ - dirtyMinY_ + 1;
+        update.data.resize(static_cast<size_t>(update.width) * update.height);
+        for (int y = dirtyMinY_; y <= dirtyMaxY_; y++)
+        {
+            for (int x = dirtyMinX_; x <= dirtyMaxX_; x++)
+            {
+                update.data[static_cast<size_t>(y - dirtyMinY_) * update.width + (x - dirtyMinX_)] = cellValue(static_cast<size_t>(y) * width_ + x);
+            }
+        }
+        dirtyMinX_ = INT_MAX;
+        dirtyMinY_ = INT_MAX;
+        dirtyMaxX_ = INT_MIN;
+        dirtyMaxY_ = INT_MIN;
+        updatesSinceFullMap_++;
+    }
+}
@@ -0,0 +1,148 @@
+/**
+ * @file odometry_motion_prior.cpp
+ * @brief Implementation of the OdometryMotionPrior class.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#include "odometry_motion_prior.hpp"
+
+#include <algorithm>
+
+namespace ORB_SLAM3_Wrapper
+{
+    namespace
+    {
+        // about 20 s of odometry at 50 Hz, far more than the time between two frames.
+        const size_t maxOdometry = 1000;
+    }
+
+    OdometryMotionPrior::OdometryMotionPrior(const Eigen::Affine3d &baseToCamera, double maxTimeDifference)
+        : baseToCamera_(baseToCamera),
+          maxTimeDifference_(maxTimeDifference)
+    {
+    }
+
+    void OdometryMotionPrior::addOdometry(double stamp, const Eigen::Affine3d &pose)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // a restarted odometry (or bag) goes back in time, the old poses do not belong to it.
+        if (!odometry_.empty() && stamp <= odometry_.back().stamp)
+        {
+            odometry_.clear();
+        }
+        StampedPose stampedPose;
+        stampedPose.stamp = stamp;
+        stampedPose.pose = pose;
+        odometry_.push_back(stampedPose);
+        if (odometry_.size() > maxOdometry)
+        {
+            odometry_.pop_front();
+        }
+    }
+
+    bool OdometryMotionPrior::interpolateOdometry(double stamp, Eigen::Affine3d &pose)
+    {
+        if (odometry_.empty() || stamp > odometry_.back().stamp + maxTimeDifference_)
+        {
+            return false;
+        }
+        auto next = std::lower_bound(odometry_.begin(), odometry_.end(), stamp,
+                                     [](const StampedPose &element, double value)
+                                     { return element.stamp < value; });
+        // the frame may arrive before the odometry past it, the last pose is close enough then.
+        if (next == odometry_.end())
+        {
+            pose = odometry_.back().pose;
+            return true;
+        }
+        if (next == odometry_.begin())
+        {
+            if (next->stamp - stamp > maxTimeDifference_)
+            {
+                return false;
+            }
+            pose = next->pose;
+            return true;
+        }
+        auto previous = next - 1;
+        double gap = next->stamp - previous->stamp;
+        if (gap > 2.0 * maxTimeDifference_)
+        {
+            return false;
+        }
+        double alpha = (stamp - previous->stamp) / gap;
+        Eigen::Quaterniond q0(previous->pose.linear());
+        Eigen::Quaterniond q1(next->pose.linear());
+        pose = Eigen::Translation3d((1.0 - alpha) * previous->pose.translation() + alpha * next->pose.translation()) *
+               q0.slerp(alpha, q1);
+        return true;
+    }
+
+    bool OdometryMotionPrior::cameraIncrement(double from, double to, Sophus::SE3f &increment)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Eigen::Affine3d fromPose, toPose;
+        if (!interpolateOdometry(from, fromPose) || !interpolateOdometry(to, toPose))
+        {
+            return false;
+        }
+        // the base moved by fromPose^-1 * toPose, the camera is rigidly attached to it.
+        Eigen::Affine3d cameraIncrement = baseToCamera_.inverse() * fromPose.inverse() * toPose * baseToCamera_;
+        Eigen::Quaternionf rotation(cameraIncrement.rotation().cast<float>());
+        increment = Sophus::SE3f(rotation.normalized(), cameraIncrement.translation().cast<float>());
+        return true;
+    }
+
+    bool OdometryMotionPrior::predict(double stamp, Sophus::SE3f &velocity)
+    {
+        if (!hasLastFrame_ || !lastTracked_)
+        {
+            return false;
+        }
+        Sophus::SE3f increment;
+        if (!cameraIncrement(lastStamp_, stamp, increment))
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            statistics_.missingOdometry++;
+            return false;
+        }
+        velocity = increment.inverse();
+        return true;
+    }
+
+    void OdometryMotionPrior::addFrame(double stamp, bool tracked, bool priorUsed, MotionModelResult result)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // a lost frame is relocalized, only the frames after a tracked one show how the motion model does.
+        if (hasLastFrame_ && lastTracked_)
+        {
+            MotionModelOutcomes &outcomes = priorUsed ? statistics_.withPrior : statistics_.withoutPrior;
+            outcomes.frames++;
+            if (!tracked)
+            {
+                outcomes.lostFrames++;
+            }
+            else if (result == MotionModelResult::Tracked)
+            {
+                outcomes.tracked++;
+            }
+            else if (result == MotionModelResult::WideSearch)
+            {
+                outcomes.wideSearches++;
+            }
+            else if (result == MotionModelResult::Failed)
+            {
+                outcomes.referenceKeyFrameFallbacks++;
+            }
+        }
+        hasLastFrame_ = true;
+        lastTracked_ = tracked;
+        lastStamp_ = stamp;
+    }
+
+    MotionPriorStatistics OdometryMotionPrior::getStatistics()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return statistics_;
+    }
+}
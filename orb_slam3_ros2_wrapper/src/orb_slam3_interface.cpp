@@ -28,13 +28,17 @@ namespace ORB_SLAM3_Wrapper
     {
         std::cout << "Interface constructor started" << endl;
         mSLAM_ = std::make_shared<ORB_SLAM3::System>(strVocFile_, strSettingsFile_, sensor_, bUseViewer_);
+        orbAtlas_ = mSLAM_->GetAtlas();
         typeConversions_ = std::make_shared<WrapperTypeConversions>();
+        eventDispatcher_ = std::make_unique<EventDispatcher>();
         std::cout << "Interface constructor complete" << endl;
     }
 
     ORBSLAM3Interface::~ORBSLAM3Interface()
     {
         std::cout << "Interface destructor" << endl;
+        // no callbacks may run while the system is shut down.
+        eventDispatcher_.reset();
         mSLAM_->Shutdown();
         mSLAM_.reset();
         typeConversions_.reset();
@@ -58,6 +62,82 @@ namespace ORB_SLAM3_Wrapper
         return mpIdKFs;
     }
 
+    void ORBSLAM3Interface::refreshKeyFrameTables(const std::vector<ORB_SLAM3::Map *> &mapsList)
+    {
+        std::set<ORB_SLAM3::Map *> maps(mapsList.begin(), mapsList.end());
+
+        // forget maps which were merged into others or removed.
+        for (auto it = mapCache_.begin(); it != mapCache_.end();)
+        {
+            if (maps.find(it->first) != maps.end())
+            {
+                ++it;
+                continue;
+            }
+            forgetKeyFrames(it->first, it->second, maps);
+            it = mapCache_.erase(it);
+        }
+
+        for (auto pMap : mapsList)
+        {
+            bool isNew = mapCache_.find(pMap) == mapCache_.end();
+            MapCacheEntry &entry = mapCache_[pMap];
+            bool changed = isNew ||
+                           entry.keyFrames != pMap->KeyFramesInMap() ||
+                           entry.changeIndex != pMap->GetMapChangeIndex() ||
+                           entry.maxKFid != pMap->GetMaxKFid();
+            if (changed)
+            {
+                forgetKeyFrames(pMap, entry, maps);
+                entry.keyFrameIds.clear();
+                for (const auto &kF : makeKFIdPair({pMap}))
+                {
+                    allKFs_[kF.first] = kF.second;
+                    entry.keyFrameIds.push_back(kF.first);
+                }
+                entry.keyFrames = pMap->KeyFramesInMap();
+                entry.changeIndex = pMap->GetMapChangeIndex();
+                entry.maxKFid = pMap->GetMaxKFid();
+            }
+        }
+    }
+
+    void ORBSLAM3Interface::forgetKeyFrames(ORB_SLAM3::Map *pMap, const MapCacheEntry &entry, const std::set<ORB_SLAM3::Map *> &liveMaps)
+    {
+        for (auto kFId : entry.keyFrameIds)
+        {
+            auto kF = allKFs_.find(kFId);
+            if (kF == allKFs_.end())
+            {
+                continue;
+            }
+            // keyframes moved to another map by a merge already belong to the other map's table,
+            // keyframes of a cleared map (ResetActiveMap) have no map anymore.
+            ORB_SLAM3::Map *pKFMap = kF->second->GetMap();
+            bool removed = kF->second->isBad() || liveMaps.find(pKFMap) == liveMaps.end();
+            if (pKFMap == pMap || removed)
+            {
+                if (removed && collectRemovedKeyFrames_)
+                {
+                    removedKeyFrames_.push_back(kFId);
+                }
+                allKFs_.erase(kF);
+            }
+        }
+    }
+
+    bool ORBSLAM3Interface::findKeyFrame(long unsigned int kFId, Sophus::SE3f &pose, ORB_SLAM3::Map *&pMap)
+    {
+        auto kF = allKFs_.find(kFId);
+        if (kF != allKFs_.end())
+        {
+            pose = kF->second->GetPose();
+            pMap = kF->second->GetMap();
+            return true;
+        }
+        return false;
+    }
+
     void ORBSLAM3Interface::calculateReferencePoses()
     {
         struct compareInitKFid
@@ -71,10 +151,29 @@ namespace ORB_SLAM3_Wrapper
         mapReferencePoses_.clear();
         std::vector<ORB_SLAM3::Map *> mapsList = orbAtlas_->GetAllMaps();
         std::sort(mapsList.begin(), mapsList.end(), compareInitKFid());
-        allKFs_ = makeKFIdPair(mapsList);
+        // only the maps which changed since the last frame are walked.
+        refreshKeyFrameTables(mapsList);
+        // merged maps are deleted, their addresses may be reused by new maps.
+        for (auto seed = mapSeeds_.begin(); seed != mapSeeds_.end();)
+        {
+            seed = std::find(mapsList.begin(), mapsList.end(), seed->first) == mapsList.end() ? mapSeeds_.erase(seed) : std::next(seed);
+        }
+        // a new map at such an address has not tracked yet and is seeded again.
+        for (auto trackedMap = trackedMaps_.begin(); trackedMap != trackedMaps_.end();)
+        {
+            trackedMap = std::find(mapsList.begin(), mapsList.end(), *trackedMap) == mapsList.end() ? trackedMaps_.erase(trackedMap) : std::next(trackedMap);
+        }
         for (auto c = 0; c < mapsList.size(); c++)
         {
-            if (mapsList[c]->GetInitKFid() == 0)
+            Sophus::SE3f parentMapPose;
+            ORB_SLAM3::Map *pParentMap = nullptr;
+            auto seed = mapSeeds_.find(mapsList[c]);
+            if (seed != mapSeeds_.end())
+            {
+                // the map started at a pose prior, like the first map starts at robot_x / robot_y.
+                mapReferencePoses_[mapsList[c]] = seed->second * typeConversions_->se3ToAffine(mapsList[c]->GetOriginKF()->GetPose());
+            }
+            else if (mapsList[c]->GetInitKFid() == 0)
             {
                 auto poseWithoutOffset = typeConversions_->se3ToAffine(mapsList[c]->GetOriginKF()->GetPose());
                 auto poseOffset = Eigen::Affine3d(
@@ -82,58 +181,532 @@ namespace ORB_SLAM3_Wrapper
                     Eigen::Quaterniond(1.0, 0.0, 0.0, 0.0));
                 mapReferencePoses_[mapsList[c]] = poseOffset * poseWithoutOffset;
             }
+            else if (findKeyFrame(mapsList[c]->GetInitKFid() - 1, parentMapPose, pParentMap))
+            {
+                mapReferencePoses_[mapsList[c]] = typeConversions_->transformPoseWithReference<Eigen::Affine3d>(mapReferencePoses_[pParentMap], parentMapPose);
+            }
             else
             {
-                auto parentMapPose = allKFs_[mapsList[c]->GetInitKFid() - 1]->GetPose();
-                mapReferencePoses_[mapsList[c]] = typeConversions_->transformPoseWithReference<Eigen::Affine3d>(mapReferencePoses_[allKFs_[mapsList[c]->GetInitKFid() - 1]->GetMap()], parentMapPose);
+                std::cerr << "Parent keyframe of map " << mapsList[c]->GetId() << " not available." << endl;
+                mapReferencePoses_[mapsList[c]] = c > 0 ? mapReferencePoses_[mapsList[c - 1]] : Eigen::Affine3d::Identity();
+            }
+        }
+    }
+
+    void ORBSLAM3Interface::updateReferencePoses()
+    {
+        // In localization mode no keyframes are added, so recompute only after the switch
+        // or if a running loop closure / global BA changed the current map.
+        int mapChangeIndex = orbAtlas_->GetCurrentMap()->GetMapChangeIndex();
+        if (localizationMode_ && referencePosesValid_ && mapChangeIndex == lastMapChangeIndex_)
+        {
+            return;
+        }
+        ScopedStage referenceStage(stageTimer_, "reference_poses");
+        ORB_SLAM3::Map *pCurrentMap = orbAtlas_->GetCurrentMap();
+        // a loop closure, merge or global BA increases the change index of the map it corrected.
+        bool corrected = referencePosesValid_ && (mapChangeIndex != lastMapChangeIndex_ || pCurrentMap != lastCurrentMap_);
+        mapDataMutex_.lock();
+        calculateReferencePoses();
+        referencePosesValid_ = true;
+        lastMapChangeIndex_ = mapChangeIndex;
+        lastCurrentMap_ = pCurrentMap;
+        referencePosesVersion_++;
+        unsigned long version = referencePosesVersion_;
+        mapDataMutex_.unlock();
+        if (corrected && eventDispatcher_->hasSubscribers<MapCorrectedEvent>())
+        {
+            auto keyFramePoses = std::make_shared<KeyFramePoses>();
+            getKeyFramePoses(*keyFramePoses);
+            MapCorrectedEvent event;
+            event.referencePosesVersion = version;
+            event.keyFramePoses = keyFramePoses;
+            eventDispatcher_->publish(event);
+        }
+    }
+
+    void ORBSLAM3Interface::setLocalizationMode(bool enable)
+    {
+        mapDataMutex_.lock();
+        if (enable && !localizationMode_)
+        {
+            std::cout << "Activating localization mode. LocalMapping will be stopped." << endl;
+        }
+        else if (!enable && localizationMode_)
+        {
+            std::cout << "Deactivating localization mode. LocalMapping will be resumed." << endl;
+        }
+        // requested from ORB-SLAM3 with the next frame, see applyLocalizationMode.
+        localizationMode_ = enable;
+        referencePosesValid_ = false;
+        mapDataMutex_.unlock();
+    }
+
+    void ORBSLAM3Interface::applyLocalizationMode()
+    {
+        // ORB-SLAM3 applies an activation before a deactivation when both are pending, so only one request is sent per frame.
+        bool localizationMode = localizationMode_ || evictionPending_;
+        if (localizationMode && !orbLocalizationMode_)
+        {
+            mSLAM_->ActivateLocalizationMode();
+        }
+        else if (!localizationMode && orbLocalizationMode_)
+        {
+            mSLAM_->DeactivateLocalizationMode();
+        }
+        orbLocalizationMode_ = localizationMode;
+    }
+
+    bool ORBSLAM3Interface::isLocalizationMode()
+    {
+        return localizationMode_;
+    }
+
+    unsigned long ORBSLAM3Interface::getReferencePosesVersion()
+    {
+        return referencePosesVersion_;
+    }
+
+    EventDispatcher::SubscriptionId ORBSLAM3Interface::subscribeTrackedPose(std::function<void(const TrackedPoseEvent &)> callback, size_t queueSize)
+    {
+        return eventDispatcher_->subscribe(callback, queueSize);
+    }
+
+    EventDispatcher::SubscriptionId ORBSLAM3Interface::subscribeKeyFrames(std::function<void(const KeyFrameEvent &)> callback, size_t queueSize)
+    {
+        return eventDispatcher_->subscribe(callback, queueSize);
+    }
+
+    EventDispatcher::SubscriptionId ORBSLAM3Interface::subscribeMapCorrections(std::function<void(const MapCorrectedEvent &)> callback, size_t queueSize)
+    {
+        return eventDispatcher_->subscribe(callback, queueSize);
+    }
+
+    EventDispatcher::SubscriptionId ORBSLAM3Interface::subscribeStatus(std::function<void(const StatusEvent &)> callback, size_t queueSize)
+    {
+        return eventDispatcher_->subscribe(callback, queueSize);
+    }
+
+    void ORBSLAM3Interface::unsubscribe(EventDispatcher::SubscriptionId id)
+    {
+        eventDispatcher_->unsubscribe(id);
+    }
+
+    std::map<EventDispatcher::SubscriptionId, SubscriptionStatistics> ORBSLAM3Interface::getSubscriptionStatistics()
+    {
+        return eventDispatcher_->getStatistics();
+    }
+
+    int ORBSLAM3Interface::getTrackingState()
+    {
+        return lastTrackingState_;
+    }
+
+    bool ORBSLAM3Interface::getTrajectoryAnchor(long unsigned int &kFId, Eigen::Affine3d &anchorPose)
+    {
+        std::lock_guard<std::mutex> lock(mapDataMutex_);
+        if (newKeyFrameId_ >= 0)
+        {
+            auto kF = allKFs_.find(newKeyFrameId_);
+            if (kF != allKFs_.end())
+            {
+                trajectoryAnchor_ = kF->second;
+                anchorKeyFrames_[kF->first] = kF->second;
+            }
+        }
+        if (!trajectoryAnchor_ || !resolveKeyFramePose(trajectoryAnchor_, anchorPose))
+        {
+            return false;
+        }
+        kFId = trajectoryAnchor_->mnId;
+        return true;
+    }
+
+    void ORBSLAM3Interface::getAnchorPoses(KeyFramePoses &poses)
+    {
+        poses.clear();
+        std::lock_guard<std::mutex> lock(mapDataMutex_);
+        for (const auto &anchor : anchorKeyFrames_)
+        {
+            Eigen::Affine3d pose;
+            if (resolveKeyFramePose(anchor.second, pose))
+            {
+                poses[anchor.first] = pose;
             }
         }
     }
 
+    bool ORBSLAM3Interface::resolveKeyFramePose(ORB_SLAM3::KeyFrame *pKF, Eigen::Affine3d &pose)
+    {
+        // a culled keyframe keeps its pose relative to its parent, as in the trajectory export of ORB-SLAM3.
+        Sophus::SE3f Tcr;
+        for (int depth = 0; pKF && pKF->isBad(); depth++)
+        {
+            if (depth > 1000)
+            {
+                return false;
+            }
+            Tcr = Tcr * pKF->mTcp;
+            pKF = pKF->GetParent();
+        }
+        if (!pKF)
+        {
+            return false;
+        }
+        auto reference = mapReferencePoses_.find(pKF->GetMap());
+        if (reference == mapReferencePoses_.end())
+        {
+            return false;
+        }
+        Sophus::SE3f Tcw = Tcr * pKF->GetPose();
+        pose = typeConversions_->transformPoseWithReference<Eigen::Affine3d>(reference->second, Tcw);
+        return true;
+    }
+
+    void ORBSLAM3Interface::publishTrackingEvents(int trackingState, bool tracked, const sensor_msgs::msg::Image::SharedPtr msgRGB,
+                                                  const sensor_msgs::msg::Image::SharedPtr msgD)
+    {
+        if (trackingState != lastTrackingState_ || localizationMode_ != lastLocalizationMode_)
+        {
+            lastTrackingState_ = trackingState;
+            lastLocalizationMode_ = localizationMode_;
+            StatusEvent event;
+            event.trackingState = trackingState;
+            event.localizationMode = localizationMode_;
+            event.trackedInliers = trackedInliers_;
+            eventDispatcher_->publish(event);
+        }
+        if (!tracked)
+        {
+            return;
+        }
+        double stamp = typeConversions_->stampToSec(msgRGB->header.stamp);
+        TrackedPoseEvent poseEvent;
+        poseEvent.stamp = stamp;
+        poseEvent.pose = latestTrackedPose_;
+        eventDispatcher_->publish(poseEvent);
+        if (newKeyFrameId_ >= 0)
+        {
+            // the keyframe was created from this frame, so it has the tracked pose.
+            KeyFrameEvent keyFrameEvent;
+            keyFrameEvent.kFId = newKeyFrameId_;
+            keyFrameEvent.stamp = stamp;
+            keyFrameEvent.pose = latestTrackedPose_;
+            keyFrameEvent.rgb = msgRGB;
+            keyFrameEvent.depth = msgD;
+            eventDispatcher_->publish(keyFrameEvent);
+        }
+    }
+
     void ORBSLAM3Interface::getCurrentMapPoints(sensor_msgs::msg::PointCloud2 &mapPointCloud)
     {
-        std::vector<Eigen::Vector3f> trackedMapPoints;
+        // the staging buffer keeps the capacity of the largest map so far.
+        getCurrentMapPoints(mapPointsBuffer_);
+        typeConversions_->MapPointsToPCL(mapPointsBuffer_, mapPointCloud);
+    }
+
+    void ORBSLAM3Interface::getCurrentMapPoints(std::vector<Eigen::Vector3f> &trackedMapPoints)
+    {
+        trackedMapPoints.clear();
+        mapDataMutex_.lock();
         for (auto KF : orbAtlas_->GetAllKeyFrames())
         {
+            // keyframes of a map created after the last reference pose update are skipped until the next one.
+            auto reference = mapReferencePoses_.find(KF->GetMap());
+            if (reference == mapReferencePoses_.end())
+            {
+                continue;
+            }
             for (auto mapPoint : KF->GetMapPoints())
             {
                 if (!mapPoint->isBad())
                 {
                     auto worldPos = typeConversions_->vector3fORBToROS(mapPoint->GetWorldPos());
-                    auto mapPointWorld = typeConversions_->transformPointWithReference<Eigen::Vector3f>(mapReferencePoses_[allKFs_[KF->mnId]->GetMap()], worldPos);
+                    auto mapPointWorld = typeConversions_->transformPointWithReference<Eigen::Vector3f>(reference->second, worldPos);
                     trackedMapPoints.push_back(mapPointWorld);
                 }
             }
         }
-        mapPointCloud = typeConversions_->MapPointsToPCL(trackedMapPoints);
+        mapDataMutex_.unlock();
+    }
+
+    void ORBSLAM3Interface::getCovisibilityGraph(const slam_msgs::msg::MapGraph &graph, std::vector<std::pair<int, int>> &edges, int minWeight)
+    {
+        mapDataMutex_.lock();
+        std::set<int> graphIds(graph.poses_id.begin(), graph.poses_id.end());
+        for (auto kFId : graph.poses_id)
+        {
+            auto kFIt = allKFs_.find(kFId);
+            if (kFIt == allKFs_.end() || kFIt->second->isBad())
+            {
+                continue;
+            }
+            for (auto pKFConnected : kFIt->second->GetCovisiblesByWeight(minWeight))
+            {
+                int connectedId = pKFConnected->mnId;
+                // store every edge only once.
+                if (connectedId > kFId && graphIds.find(connectedId) != graphIds.end())
+                {
+                    edges.emplace_back(kFId, connectedId);
+                }
+            }
+        }
+        mapDataMutex_.unlock();
+    }
+
+    Eigen::Affine3d ORBSLAM3Interface::getLatestTrackedPose()
+    {
+        return latestTrackedPose_;
+    }
+
+    void ORBSLAM3Interface::setKeyFrameImageCache(std::shared_ptr<KeyFrameImageCache> keyFrameImageCache)
+    {
+        keyFrameImageCache_ = keyFrameImageCache;
+    }
+
+    void ORBSLAM3Interface::handleNewKeyFrame(long unsigned int nextKFIdBefore, const sensor_msgs::msg::Image::SharedPtr msgRGB,
+                                              const sensor_msgs::msg::Image::SharedPtr msgD, const cv::Mat &rgb, const cv::Mat &depth)
+    {
+        // keyframes are created by the tracking thread inside TrackRGBD, so a new ID belongs to this frame.
+        long unsigned int nextKFId = ORB_SLAM3::KeyFrame::nNextId;
+        newKeyFrameId_ = nextKFId != nextKFIdBefore ? static_cast<long>(nextKFId - 1) : -1;
+        if (newKeyFrameId_ < 0 || !keyFrameImageCache_ || !keyFrameImageCache_->isEnabled())
+        {
+            return;
+        }
+        ScopedStage cacheStage(stageTimer_, "keyframe_images");
+        keyFrameImageCache_->insert(newKeyFrameId_, typeConversions_->stampToSec(msgRGB->header.stamp),
+                                    rgb, msgRGB->encoding, depth, msgD->encoding);
+    }
+
+    long ORBSLAM3Interface::getNewKeyFrameId()
+    {
+        return newKeyFrameId_;
+    }
+
+    void ORBSLAM3Interface::getKeyFramePoses(KeyFramePoses &poses)
+    {
+        poses.clear();
+        mapDataMutex_.lock();
+        for (const auto &kF : allKFs_)
+        {
+            auto reference = mapReferencePoses_.find(kF.second->GetMap());
+            if (kF.second->isBad() || reference == mapReferencePoses_.end())
+            {
+                continue;
+            }
+            Sophus::SE3f kFPose = kF.second->GetPose();
+            poses[kF.first] = typeConversions_->transformPoseWithReference<Eigen::Affine3d>(reference->second, kFPose);
+        }
+        mapDataMutex_.unlock();
+    }
+
+    void ORBSLAM3Interface::setCollectRemovedKeyFrames(bool enable)
+    {
+        mapDataMutex_.lock();
+        collectRemovedKeyFrames_ = enable;
+        removedKeyFrames_.clear();
+        mapDataMutex_.unlock();
+    }
+
+    void ORBSLAM3Interface::takeRemovedKeyFrames(std::vector<long unsigned int> &kFIds)
+    {
+        kFIds.clear();
+        mapDataMutex_.lock();
+        kFIds.swap(removedKeyFrames_);
+        mapDataMutex_.unlock();
+    }
+
+    void ORBSLAM3Interface::getKeyFrameLandmarks(const std::vector<long unsigned int> &kFIds, KeyFrameLandmarksList &landmarks)
+    {
+        landmarks.clear();
+        landmarks.reserve(kFIds.size());
+        mapDataMutex_.lock();
+        for (auto kFId : kFIds)
+        {
+            auto kF = allKFs_.find(kFId);
+            if (kF == allKFs_.end() || kF->second->isBad())
+            {
+                continue;
+            }
+            auto reference = mapReferencePoses_.find(kF->second->GetMap());
+            if (reference == mapReferencePoses_.end())
+            {
+                continue;
+            }
+            const Eigen::Affine3d &referencePose = reference->second;
+            Sophus::SE3f kFPose = kF->second->GetPose();
+            landmarks.emplace_back();
+            KeyFrameLandmarks &keyFrame = landmarks.back();
+            keyFrame.kFId = kFId;
+            keyFrame.pose = typeConversions_->transformPoseWithReference<Eigen::Affine3d>(referencePose, kFPose);
+            for (auto mapPoint : kF->second->GetMapPoints())
+            {
+                if (!mapPoint->isBad())
+                {
+                    auto worldPos = typeConversions_->vector3fORBToROS(mapPoint->GetWorldPos());
+                    keyFrame.points.push_back(typeConversions_->transformPointWithReference<Eigen::Vector3f>(referencePose, worldPos));
+                }
+            }
+        }
+        mapDataMutex_.unlock();
+    }
+
+    int ORBSLAM3Interface::getTrackedInliers()
+    {
+        return trackedInliers_;
+    }
+
+    StageTimer &ORBSLAM3Interface::getStageTimer()
+    {
+        return stageTimer_;
+    }
+
+    void ORBSLAM3Interface::setRetentionPolicy(std::shared_ptr<MapRetentionPolicy> retentionPolicy)
+    {
+        retentionPolicy_ = retentionPolicy;
+    }
+
+    void ORBSLAM3Interface::enforceMemoryBudget()
+    {
+        if (!retentionPolicy_)
+        {
+            return;
+        }
+        auto orbLoopClosing = mSLAM_->GetLoopClosing();
+        if (orbLoopClosing->mergeDetected() || orbLoopClosing->isRunningGBA())
+        {
+            return;
+        }
+        mapDataMutex_.lock();
+        memoryUsage_ = retentionPolicy_->estimateUsage(orbAtlas_);
+        bool overBudget = retentionPolicy_->exceedsBudget(memoryUsage_);
+        mapDataMutex_.unlock();
+        if (!overBudget || evictionPending_)
+        {
+            return;
+        }
+        if (localMappingStopped_)
+        {
+            // LocalMapping is stopped already.
+            evictMapElements();
+            return;
+        }
+        // LocalMapping culls and optimizes the same keyframes. It is stopped the way the localization mode stops it,
+        // which the tracking thread does at the start of the next frame, and the eviction runs after that frame.
+        evictionPending_ = true;
+    }
+
+    void ORBSLAM3Interface::evictMapElements()
+    {
+        auto orbLoopClosing = mSLAM_->GetLoopClosing();
+        if (orbLoopClosing->mergeDetected() || orbLoopClosing->isRunningGBA())
+        {
+            return;
+        }
+        mapDataMutex_.lock();
+        if (retentionPolicy_->enforce(orbAtlas_))
+        {
+            // evicted keyframes must disappear from the exports.
+            referencePosesValid_ = false;
+        }
+        memoryUsage_ = retentionPolicy_->estimateUsage(orbAtlas_);
+        mapDataMutex_.unlock();
+    }
+
+    MemoryUsage ORBSLAM3Interface::getMemoryUsage()
+    {
+        return memoryUsage_;
+    }
+
+    RetentionStatistics ORBSLAM3Interface::getRetentionStatistics()
+    {
+        return retentionPolicy_ ? retentionPolicy_->getStatistics() : RetentionStatistics();
+    }
+
+    void ORBSLAM3Interface::countTrackedInliers()
+    {
+        trackedInliers_ = 0;
+        for (auto pMP : mSLAM_->GetTrackedMapPoints())
+        {
+            if (pMP && !pMP->isBad())
+            {
+                trackedInliers_++;
+            }
+        }
+    }
+
+    void ORBSLAM3Interface::evaluateMotionPrior(double stamp, int trackingState)
+    {
+        MotionModelResult result = MotionModelResult::NotUsed;
+#ifdef ORB_SLAM3_HAS_MOTION_PRIOR
+        result = static_cast<MotionModelResult>(mSLAM_->GetMotionModelResult());
+#endif
+        motionPrior_->addFrame(stamp, trackingState == 2, motionPriorUsed_, result);
+    }
+
+    void ORBSLAM3Interface::updateIntermediateFrameReference(const cv::Mat &rgb, int trackingState, const Sophus::SE3f &Tcw)
+    {
+        if (trackingState != 2)
+        {
+            kltTracker_->reset();
+            return;
+        }
+        ScopedStage referenceStage(stageTimer_, "klt_reference");
+        kltKeyPoints_.clear();
+        kltMapPoints_.clear();
+        auto trackedMapPoints = mSLAM_->GetTrackedMapPoints();
+        auto trackedKeyPoints = mSLAM_->GetTrackedKeyPointsUn();
+        for (size_t i = 0; i < trackedMapPoints.size() && i < trackedKeyPoints.size(); i++)
+        {
+            if (trackedMapPoints[i] && !trackedMapPoints[i]->isBad())
+            {
+                Eigen::Vector3f worldPos = trackedMapPoints[i]->GetWorldPos();
+                kltKeyPoints_.push_back(trackedKeyPoints[i].pt);
+                kltMapPoints_.emplace_back(worldPos.x(), worldPos.y(), worldPos.z());
+            }
+        }
+        kltTracker_->setReference(rgb, Tcw, kltKeyPoints_, kltMapPoints_);
     }
 
     void ORBSLAM3Interface::mapDataToMsg(slam_msgs::msg::MapData &mapDataMsg, bool currentMapKFOnly, bool includeMapPoints, std::vector<int> kFIDforMapPoints)
     {
         mapDataMutex_.lock();
-        slam_msgs::msg::MapGraph poseGraph_;
-        getOptimizedPoseGraph(poseGraph_, currentMapKFOnly);
-        // publish the map data
-        mapDataMsg.graph = poseGraph_;
+        // the message is filled in place, so a reused message keeps the buffers of the last snapshot.
+        getOptimizedPoseGraph(mapDataMsg.graph, currentMapKFOnly);
         mapDataMsg.header.frame_id = globalFrame_;
+        size_t numNodes = 0;
         if (includeMapPoints)
         {
+            mapDataMsg.nodes.reserve(kFIDforMapPoints.size());
+            auto nextNode = [&mapDataMsg, &numNodes](int kFId) -> slam_msgs::msg::KeyFrame &
+            {
+                if (numNodes == mapDataMsg.nodes.size())
+                {
+                    mapDataMsg.nodes.emplace_back();
+                }
+                slam_msgs::msg::KeyFrame &node = mapDataMsg.nodes[numNodes++];
+                node.id = kFId;
+                node.word_pts.clear();
+                return node;
+            };
             for (auto kFId : kFIDforMapPoints)
             {
-                slam_msgs::msg::KeyFrame pushedKf;
-                pushedKf.id = kFId;
-                if (allKFs_.find(kFId) != allKFs_.end())
+                auto kF = allKFs_.find(kFId);
+                auto reference = kF != allKFs_.end() ? mapReferencePoses_.find(kF->second->GetMap()) : mapReferencePoses_.end();
+                if (reference != mapReferencePoses_.end())
                 {
-                    for (auto mapPoint : allKFs_[kFId]->GetMapPoints())
+                    slam_msgs::msg::KeyFrame &pushedKf = nextNode(kFId);
+                    std::set<ORB_SLAM3::MapPoint *> mapPoints = kF->second->GetMapPoints();
+                    pushedKf.word_pts.reserve(mapPoints.size());
+                    for (auto mapPoint : mapPoints)
                     {
                         if (!mapPoint->isBad())
                         {
                             auto worldPos = typeConversions_->vector3fORBToROS(mapPoint->GetWorldPos());
-                            auto mapPointWorld = typeConversions_->transformPointWithReference<geometry_msgs::msg::Point>(mapReferencePoses_[allKFs_[kFId]->GetMap()], worldPos);
-                            pushedKf.word_pts.push_back(mapPointWorld);
+                            pushedKf.word_pts.push_back(typeConversions_->transformPointWithReference<geometry_msgs::msg::Point>(reference->second, worldPos));
                         }
                     }
-                    mapDataMsg.nodes.push_back(pushedKf);
                 }
                 else
                 {
@@ -141,13 +714,19 @@ namespace ORB_SLAM3_Wrapper
                 }
             }
         }
+        mapDataMsg.nodes.resize(numNodes);
         mapDataMutex_.unlock();
     }
 
     void ORBSLAM3Interface::correctTrackedPose(Sophus::SE3f &s)
     {
-        latestTrackedPose_ = typeConversions_->transformPoseWithReference<Eigen::Affine3d>(
-            mapReferencePoses_[orbAtlas_->GetCurrentMap()], s);
+        mapDataMutex_.lock();
+        auto reference = mapReferencePoses_.find(orbAtlas_->GetCurrentMap());
+        if (reference != mapReferencePoses_.end())
+        {
+            latestTrackedPose_ = typeConversions_->transformPoseWithReference<Eigen::Affine3d>(reference->second, s);
+        }
+        mapDataMutex_.unlock();
     }
 
     void ORBSLAM3Interface::getMapToOdomTF(const nav_msgs::msg::Odometry::SharedPtr msgOdom, geometry_msgs::msg::TransformStamped &tf)
@@ -165,6 +744,21 @@ namespace ORB_SLAM3_Wrapper
                                    msgOdom->pose.pose.orientation.z));
             // get transform between map and odom and send the transform.
             auto tfMapOdom = latestTrackedPose_ * latestOdomTransform_.inverse();
+            {
+                std::lock_guard<std::mutex> lock(posePriorMutex_);
+                if (lastTrackingState_ == 2)
+                {
+                    trackedMapToOdom_ = tfMapOdom;
+                    hasTrackedMapToOdom_ = true;
+                }
+                else if (odometryPosePrior_ && hasTrackedMapToOdom_)
+                {
+                    // the odometry keeps running while the camera is lost.
+                    posePrior_ = trackedMapToOdom_ * latestOdomTransform_;
+                    posePriorRadius_ = odometryPriorRadius_;
+                    hasPosePrior_ = true;
+                }
+            }
             geometry_msgs::msg::Pose poseMapOdom = tf2::toMsg(tfMapOdom);
             rclcpp::Duration transformTimeout_ = rclcpp::Duration::from_seconds(0.5);
             rclcpp::Time odomTimestamp = msgOdom->header.stamp;
@@ -180,38 +774,59 @@ namespace ORB_SLAM3_Wrapper
 
     void ORBSLAM3Interface::getOptimizedPoseGraph(slam_msgs::msg::MapGraph &graph, bool currentMapKFOnly)
     {
+        // overwrite the poses of the last snapshot instead of reallocating them, the headers keep their frame id.
+        size_t numPoses = 0;
+        graph.poses_id.clear();
+        auto nextPose = [&graph, &numPoses, this](long unsigned int kFId, double stamp) -> geometry_msgs::msg::PoseStamped &
+        {
+            if (numPoses == graph.poses.size())
+            {
+                graph.poses.emplace_back();
+            }
+            geometry_msgs::msg::PoseStamped &poseStamped = graph.poses[numPoses++];
+            if (poseStamped.header.frame_id != globalFrame_)
+            {
+                poseStamped.header.frame_id = globalFrame_;
+            }
+            poseStamped.header.stamp = typeConversions_->secToStamp(stamp);
+            graph.poses_id.push_back(kFId);
+            return poseStamped;
+        };
         if (!currentMapKFOnly)
         {
+            graph.poses.reserve(allKFs_.size());
+            graph.poses_id.reserve(allKFs_.size());
             for (const auto &cKf : allKFs_)
             {
                 ORB_SLAM3::KeyFrame *kf = cKf.second;
+                auto reference = mapReferencePoses_.find(kf->GetMap());
+                if (reference == mapReferencePoses_.end())
+                {
+                    continue;
+                }
                 Sophus::SE3f kfPose = kf->GetPose();
-                geometry_msgs::msg::PoseStamped kfPoseStamped;
-                kfPoseStamped.pose = typeConversions_->transformPoseWithReference<geometry_msgs::msg::Pose>(mapReferencePoses_[kf->GetMap()], kfPose);
-                kfPoseStamped.header.frame_id = globalFrame_;
-                kfPoseStamped.header.stamp = typeConversions_->secToStamp(kf->mTimeStamp);
-                graph.poses.push_back(kfPoseStamped);
-                graph.poses_id.push_back(kf->mnId);
+                nextPose(kf->mnId, kf->mTimeStamp).pose = typeConversions_->transformPoseWithReference<geometry_msgs::msg::Pose>(reference->second, kfPose);
             }
         }
         else
         {
             vector<ORB_SLAM3::KeyFrame *> vKeyFrames = orbAtlas_->GetAllKeyFrames();
+            graph.poses.reserve(vKeyFrames.size());
+            graph.poses_id.reserve(vKeyFrames.size());
             // TODO: add isBad() check for keyframes. Evaluate mapping if you do this.
             // iterate over current keyframes.
             for (auto pKFcurr : vKeyFrames)
             {
-                auto currReferencePose_ = mapReferencePoses_[pKFcurr->GetMap()];
+                auto reference = mapReferencePoses_.find(pKFcurr->GetMap());
+                if (reference == mapReferencePoses_.end())
+                {
+                    continue;
+                }
                 Sophus::SE3f kFPose = pKFcurr->GetPose();
-                geometry_msgs::msg::PoseStamped poseStamped;
-                poseStamped.pose = typeConversions_->transformPoseWithReference<geometry_msgs::msg::Pose>(currReferencePose_, kFPose);
-                poseStamped.header.frame_id = globalFrame_;
-                poseStamped.header.stamp = typeConversions_->secToStamp(pKFcurr->mTimeStamp);
-                // push to pose graph.
-                graph.poses.push_back(poseStamped);
-                graph.poses_id.push_back(pKFcurr->mnId);
+                nextPose(pKFcurr->mnId, pKFcurr->mTimeStamp).pose = typeConversions_->transformPoseWithReference<geometry_msgs::msg::Pose>(reference->second, kFPose);
             }
         }
+        graph.poses.resize(numPoses);
     }
 
     void ORBSLAM3Interface::handleIMU(const sensor_msgs::msg::Imu::SharedPtr msgIMU)
@@ -221,9 +836,212 @@ namespace ORB_SLAM3_Wrapper
         bufMutex_.unlock();
     }
 
+    void ORBSLAM3Interface::setPosePrior(const Eigen::Affine3d &pose, double radius)
+    {
+        std::lock_guard<std::mutex> lock(posePriorMutex_);
+        posePrior_ = pose;
+        posePriorRadius_ = radius;
+        hasPosePrior_ = true;
+    }
+
+    void ORBSLAM3Interface::setOdometryPosePrior(bool enable, double radius)
+    {
+        std::lock_guard<std::mutex> lock(posePriorMutex_);
+        odometryPosePrior_ = enable;
+        odometryPriorRadius_ = radius;
+    }
+
+    PosePriorStatistics ORBSLAM3Interface::getPosePriorStatistics()
+    {
+        std::lock_guard<std::mutex> lock(posePriorMutex_);
+        PosePriorStatistics statistics = posePriorStatistics_;
+        statistics.maskedKeyFrames = maskedKeyFrames_.size();
+        statistics.hasPrior = hasPosePrior_;
+        return statistics;
+    }
+
+    void ORBSLAM3Interface::applyPosePrior(int trackingState)
+    {
+        std::lock_guard<std::mutex> lock(posePriorMutex_);
+        // only a lost map relocalizes (RECENTLY_LOST), LOST starts a new map.
+        bool lost = trackingState == 3 || trackingState == 4;
+        ORB_SLAM3::Map *pCurrentMap = orbAtlas_->GetCurrentMap();
+        if (!lost || !hasPosePrior_ || pCurrentMap != maskedMap_)
+        {
+            unmaskKeyFrames();
+        }
+        if (!lost || !hasPosePrior_)
+        {
+            return;
+        }
+        // the mask follows the prior once it moved by a quarter of the radius.
+        Eigen::Vector3d center = posePrior_.translation();
+        if (maskedMap_ == pCurrentMap && (center - maskCenter_).norm() < 0.25 * posePriorRadius_)
+        {
+            return;
+        }
+        unmaskKeyFrames();
+        mapDataMutex_.lock();
+        auto referencePose = mapReferencePoses_.find(pCurrentMap);
+        if (referencePose == mapReferencePoses_.end())
+        {
+            mapDataMutex_.unlock();
+            return;
+        }
+        ORB_SLAM3::KeyFrameDatabase *keyFrameDatabase = orbAtlas_->GetKeyFrameDatabase();
+        for (auto pKF : pCurrentMap->GetAllKeyFrames())
+        {
+            if (pKF->isBad())
+            {
+                continue;
+            }
+            Sophus::SE3f kFPose = pKF->GetPose();
+            Eigen::Affine3d globalPose = typeConversions_->transformPoseWithReference<Eigen::Affine3d>(referencePose->second, kFPose);
+            if ((globalPose.translation() - center).norm() > posePriorRadius_)
+            {
+                keyFrameDatabase->erase(pKF);
+                maskedKeyFrames_.push_back(pKF);
+            }
+        }
+        mapDataMutex_.unlock();
+        maskCenter_ = center;
+        maskedMap_ = pCurrentMap;
+    }
+
+    void ORBSLAM3Interface::unmaskKeyFrames()
+    {
+        if (!maskedKeyFrames_.empty())
+        {
+            ORB_SLAM3::KeyFrameDatabase *keyFrameDatabase = orbAtlas_->GetKeyFrameDatabase();
+            for (auto pKF : maskedKeyFrames_)
+            {
+                // keyframes culled meanwhile stay out, ORB-SLAM3 would have removed them anyway.
+                if (!pKF->isBad())
+                {
+                    keyFrameDatabase->add(pKF);
+                }
+            }
+            maskedKeyFrames_.clear();
+        }
+        maskedMap_ = nullptr;
+    }
+
+    void ORBSLAM3Interface::handlePosePrior(int trackingState)
+    {
+        std::lock_guard<std::mutex> lock(posePriorMutex_);
+        ORB_SLAM3::Map *pCurrentMap = orbAtlas_->GetCurrentMap();
+        auto now = std::chrono::steady_clock::now();
+        if (trackingState != 2)
+        {
+            if ((trackingState == 3 || trackingState == 4) && lostMap_ == nullptr)
+            {
+                lostMap_ = pCurrentMap;
+                lostSince_ = now;
+            }
+            return;
+        }
+        bool recovered = lostMap_ != nullptr;
+        if (recovered)
+        {
+            double recoveryMs = std::chrono::duration<double, std::milli>(now - lostSince_).count();
+            posePriorStatistics_.lastRecoveryMs = recoveryMs;
+            posePriorStatistics_.totalRecoveryMs += recoveryMs;
+            if (pCurrentMap == lostMap_)
+            {
+                posePriorStatistics_.relocalizations++;
+            }
+            else
+            {
+                posePriorStatistics_.newMaps++;
+            }
+            lostMap_ = nullptr;
+        }
+        bool seeded = trackedMaps_.insert(pCurrentMap).second && hasPosePrior_;
+        if (seeded)
+        {
+            // the first tracked frame of the map, it is where the prior says the robot is.
+            mapDataMutex_.lock();
+            mapSeeds_[pCurrentMap] = posePrior_;
+            // recalculated with the seed on the next update.
+            referencePosesValid_ = false;
+            mapDataMutex_.unlock();
+            posePriorStatistics_.seededMaps++;
+        }
+        unmaskKeyFrames();
+        // the prior is used up by the recovery or the seed it took part in, the odometry prior is derived again
+        // on the next loss. A prior set while tracking waits for the next loss or new map.
+        if (recovered || seeded)
+        {
+            hasPosePrior_ = false;
+        }
+    }
+
+    void ORBSLAM3Interface::setIntermediateFrameTracker(std::shared_ptr<KltFrameTracker> kltTracker)
+    {
+        kltTracker_ = kltTracker;
+    }
+
+    bool ORBSLAM3Interface::trackIntermediateFrame(const sensor_msgs::msg::Image::SharedPtr msgRGB, Sophus::SE3f &Tcw)
+    {
+        // during a merge the reference poses change, the next frame goes to ORB-SLAM3.
+        if (!kltTracker_ || !kltTracker_->hasReference() || lastTrackingState_ != 2 || mSLAM_->GetLoopClosing()->mergeDetected())
+        {
+            return false;
+        }
+        ScopedStage kltStage(stageTimer_, "klt_track");
+        cv_bridge::CvImageConstPtr cvRGB;
+        try
+        {
+            cvRGB = cv_bridge::toCvShare(msgRGB);
+        }
+        catch (cv_bridge::Exception &e)
+        {
+            std::cerr << "cv_bridge exception RGB!" << endl;
+            return false;
+        }
+        if (!kltTracker_->track(cvRGB->image, Tcw))
+        {
+            return false;
+        }
+        correctTrackedPose(Tcw);
+        // no keyframe is created from an intermediate frame.
+        newKeyFrameId_ = -1;
+        publishTrackingEvents(2, true, msgRGB, nullptr);
+        return true;
+    }
+
+    bool ORBSLAM3Interface::setMotionPrior(std::shared_ptr<OdometryMotionPrior> motionPrior, bool feedTracker)
+    {
+        motionPrior_ = motionPrior;
+#ifdef ORB_SLAM3_HAS_MOTION_PRIOR
+        feedMotionPrior_ = feedTracker;
+        return true;
+#else
+        feedMotionPrior_ = false;
+        return !feedTracker;
+#endif
+    }
+
+    bool ORBSLAM3Interface::setORBExtractor(const OrbExtractorSettings &settings)
+    {
+#ifdef ORB_SLAM3_HAS_ORB_EXTRACTOR
+        mSLAM_->SetORBExtractor(settings.nFeatures, settings.scaleFactor, settings.nLevels, settings.iniThFAST, settings.minThFAST);
+        return true;
+#else
+        (void)settings;
+        return false;
+#endif
+    }
+
+    void ORBSLAM3Interface::setInputRecorder(std::shared_ptr<InputRecorder> inputRecorder)
+    {
+        inputRecorder_ = inputRecorder;
+    }
+
     bool ORBSLAM3Interface::trackRGBDi(const sensor_msgs::msg::Image::SharedPtr msgRGB, const sensor_msgs::msg::Image::SharedPtr msgD, Sophus::SE3f &Tcw)
     {
-        orbAtlas_ = mSLAM_->GetAtlas();
+        auto receiveTime = std::chrono::steady_clock::now();
+        newKeyFrameId_ = -1;
         cv_bridge::CvImageConstPtr cvRGB;
         cv_bridge::CvImageConstPtr cvD;
         // Copy the ros rgb image message to cv::Mat.
@@ -249,62 +1067,57 @@ namespace ORB_SLAM3_Wrapper
         }
 
         vector<ORB_SLAM3::IMU::Point> vImuMeas;
-        bufMutex_.lock();
-        if (!imuBuf_.empty())
+        double imuSlicingMs;
         {
-            // Load imu measurements from buffer
-            vImuMeas.clear();
-            while (!imuBuf_.empty() && typeConversions_->stampToSec(imuBuf_.front()->header.stamp) <= std::min(typeConversions_->stampToSec(msgRGB->header.stamp), typeConversions_->stampToSec(msgD->header.stamp)))
+            ScopedStage imuStage(stageTimer_, "imu_slicing");
+            bufMutex_.lock();
+            if (!imuBuf_.empty())
             {
-                double t = typeConversions_->stampToSec(imuBuf_.front()->header.stamp);
-                cv::Point3f acc(imuBuf_.front()->linear_acceleration.x, imuBuf_.front()->linear_acceleration.y, imuBuf_.front()->linear_acceleration.z);
-                cv::Point3f gyr(imuBuf_.front()->angular_velocity.x, imuBuf_.front()->angular_velocity.y, imuBuf_.front()->angular_velocity.z);
-                vImuMeas.push_back(ORB_SLAM3::IMU::Point(acc, gyr, t));
-                imuBuf_.pop();
+                // Load imu measurements from buffer
+                vImuMeas.clear();
+                while (!imuBuf_.empty() && typeConversions_->stampToSec(imuBuf_.front()->header.stamp) <= std::min(typeConversions_->stampToSec(msgRGB->header.stamp), typeConversions_->stampToSec(msgD->header.stamp)))
+                {
+                    double t = typeConversions_->stampToSec(imuBuf_.front()->header.stamp);
+                    cv::Point3f acc(imuBuf_.front()->linear_acceleration.x, imuBuf_.front()->linear_acceleration.y, imuBuf_.front()->linear_acceleration.z);
+                    cv::Point3f gyr(imuBuf_.front()->angular_velocity.x, imuBuf_.front()->angular_velocity.y, imuBuf_.front()->angular_velocity.z);
+                    vImuMeas.push_back(ORB_SLAM3::IMU::Point(acc, gyr, t));
+                    imuBuf_.pop();
+                }
             }
+            bufMutex_.unlock();
+            imuSlicingMs = imuStage.elapsedMs();
         }
-        bufMutex_.unlock();
         if (imuBuf_.size() > 0)
         {
-            // track the frame.
-            Tcw = mSLAM_->TrackRGBD(cvRGB->image, cvD->image, typeConversions_->stampToSec(msgRGB->header.stamp), vImuMeas);
-            auto currentTrackingState = mSLAM_->GetTrackingState();
-            auto orbLoopClosing = mSLAM_->GetLoopClosing();
-            if (orbLoopClosing->mergeDetected())
-            {
-                // do not publish any values during map merging. This is because the reference poses change.
-                std::cout << "Waiting for merge to finish." << endl;
-                return false;
-            }
-            if (currentTrackingState == 2)
-            {
-                calculateReferencePoses();
-                correctTrackedPose(Tcw);
-                hasTracked_ = true;
-                return true;
-            }
-            else
-            {
-                switch (currentTrackingState)
-                {
-                case 0:
-                    std::cerr << "ORB-SLAM failed: No images yet." << endl;
-                    break;
-                case 1:
-                    std::cerr << "ORB-SLAM failed: Not initialized." << endl;
-                    break;
-                case 3:
-                    std::cerr << "ORB-SLAM failed: Tracking LOST." << endl;
-                    break;
-                }
-                return false;
-            }
+            return trackImages(msgRGB, msgD, cvRGB->image, cvD->image, vImuMeas, imuSlicingMs, receiveTime, Tcw);
         }
         return false;
     }
 
+    bool ORBSLAM3Interface::trackRGBDi(const sensor_msgs::msg::Image::SharedPtr msgRGB, const sensor_msgs::msg::Image::SharedPtr msgD,
+                                       const std::vector<ORB_SLAM3::IMU::Point> &vImuMeas, Sophus::SE3f &Tcw)
+    {
+        auto receiveTime = std::chrono::steady_clock::now();
+        newKeyFrameId_ = -1;
+        cv_bridge::CvImageConstPtr cvRGB;
+        cv_bridge::CvImageConstPtr cvD;
+        try
+        {
+            cvRGB = cv_bridge::toCvShare(msgRGB);
+            cvD = cv_bridge::toCvShare(msgD);
+        }
+        catch (cv_bridge::Exception &e)
+        {
+            std::cerr << "cv_bridge exception: " << e.what() << endl;
+            return false;
+        }
+        return trackImages(msgRGB, msgD, cvRGB->image, cvD->image, vImuMeas, 0.0, receiveTime, Tcw);
+    }
+
     bool ORBSLAM3Interface::trackRGBD(const sensor_msgs::msg::Image::SharedPtr msgRGB, const sensor_msgs::msg::Image::SharedPtr msgD, Sophus::SE3f &Tcw)
     {
+        auto receiveTime = std::chrono::steady_clock::now();
+        newKeyFrameId_ = -1;
         cv_bridge::CvImageConstPtr cvRGB;
         cv_bridge::CvImageConstPtr cvD;
         // Copy the ros rgb image message to cv::Mat.
@@ -328,24 +1141,86 @@ namespace ORB_SLAM3_Wrapper
             std::cerr << "cv_bridge exception D!" << endl;
             return false;
         }
+        // an empty IMU vector is what TrackRGBD defaults to.
+        return trackImages(msgRGB, msgD, cvRGB->image, cvD->image, vector<ORB_SLAM3::IMU::Point>(), 0.0, receiveTime, Tcw);
+    }
+
+    bool ORBSLAM3Interface::trackImages(const sensor_msgs::msg::Image::SharedPtr msgRGB, const sensor_msgs::msg::Image::SharedPtr msgD,
+                                        const cv::Mat &rgb, const cv::Mat &depth, const std::vector<ORB_SLAM3::IMU::Point> &vImuMeas,
+                                        double imuSlicingMs, std::chrono::steady_clock::time_point receiveTime, Sophus::SE3f &Tcw)
+    {
+        orbAtlas_ = mSLAM_->GetAtlas();
+        applyPosePrior(lastTrackingState_);
         // track the frame.
-        Tcw = mSLAM_->TrackRGBD(cvRGB->image, cvD->image, typeConversions_->stampToSec(msgRGB->header.stamp));
+        long unsigned int nextKFId = ORB_SLAM3::KeyFrame::nNextId;
+        motionPriorUsed_ = false;
+#ifdef ORB_SLAM3_HAS_MOTION_PRIOR
+        Sophus::SE3f velocity;
+        if (motionPrior_ && feedMotionPrior_ && motionPrior_->predict(typeConversions_->stampToSec(msgRGB->header.stamp), velocity))
+        {
+            // only applies to the frame tracked next, without odometry the tracker keeps its constant velocity.
+            mSLAM_->SetMotionPrior(velocity);
+            motionPriorUsed_ = true;
+        }
+#endif
+        applyLocalizationMode();
+        double trackMs;
+        {
+            ScopedStage trackStage(stageTimer_, "track_rgbd");
+            Tcw = mSLAM_->TrackRGBD(rgb, depth, typeConversions_->stampToSec(msgRGB->header.stamp), vImuMeas);
+            trackMs = trackStage.elapsedMs();
+        }
+        localMappingStopped_ = orbLocalizationMode_;
         auto currentTrackingState = mSLAM_->GetTrackingState();
+        if (evictionPending_)
+        {
+            // TrackRGBD stopped LocalMapping before it tracked the frame, no keyframe was created from it.
+            // The next frame resumes it, unless the localization mode is on by then.
+            evictMapElements();
+            evictionPending_ = false;
+        }
+        if (inputRecorder_)
+        {
+            RecordedFrame frame;
+            frame.rgb = msgRGB;
+            frame.depth = msgD;
+            frame.imu = vImuMeas;
+            frame.imuSlicingMs = imuSlicingMs;
+            frame.trackMs = trackMs;
+            frame.trackingState = currentTrackingState;
+            frame.Tcw = Tcw;
+            inputRecorder_->record(frame, receiveTime);
+        }
+        handleNewKeyFrame(nextKFId, msgRGB, msgD, rgb, depth);
+        countTrackedInliers();
+        if (motionPrior_)
+        {
+            evaluateMotionPrior(typeConversions_->stampToSec(msgRGB->header.stamp), currentTrackingState);
+        }
+        handlePosePrior(currentTrackingState);
+        if (kltTracker_)
+        {
+            updateIntermediateFrameReference(rgb, currentTrackingState, Tcw);
+        }
         auto orbLoopClosing = mSLAM_->GetLoopClosing();
         if (orbLoopClosing->mergeDetected())
         {
             // do not publish any values during map merging. This is because the reference poses change.
             std::cout << "Waiting for merge to finish." << endl;
+            publishTrackingEvents(currentTrackingState, false, msgRGB, msgD);
             return false;
         }
         if (currentTrackingState == 2)
         {
-            calculateReferencePoses();
+            updateReferencePoses();
             correctTrackedPose(Tcw);
+            hasTracked_ = true;
+            publishTrackingEvents(currentTrackingState, true, msgRGB, msgD);
             return true;
         }
         else
         {
+            publishTrackingEvents(currentTrackingState, false, msgRGB, msgD);
             switch (currentTrackingState)
             {
             case 0:
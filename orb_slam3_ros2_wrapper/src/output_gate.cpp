@@ -0,0 +1,49 @@
+/**
+ * @file output_gate.cpp
+ * @brief Implementation of the OutputGate class.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#include "output_gate.hpp"
+
+namespace ORB_SLAM3_Wrapper
+{
+    OutputGate::OutputGate()
+        : lastRun_(0.0),
+          hasRun_(false),
+          idle_(false),
+          resumed_(false)
+    {
+    }
+
+    bool OutputGate::admit(double now, double rate, size_t subscribers)
+    {
+        if (subscribers == 0)
+        {
+            idle_ = true;
+            statistics_.idleSkips++;
+            return false;
+        }
+        if (hasRun_ && rate > 0.0 && now - lastRun_ < 1.0 / rate)
+        {
+            statistics_.rateSkips++;
+            return false;
+        }
+        resumed_ = idle_;
+        idle_ = false;
+        hasRun_ = true;
+        lastRun_ = now;
+        statistics_.runs++;
+        return true;
+    }
+
+    bool OutputGate::resumed()
+    {
+        return resumed_;
+    }
+
+    OutputGateStatistics OutputGate::getStatistics()
+    {
+        return statistics_;
+    }
+}
@@ -0,0 +1,44 @@
+/**
+ * @file performance_profile.cpp
+ * @brief Implementation of the PerformanceProfile struct.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#include "performance_profile.hpp"
+
+namespace ORB_SLAM3_Wrapper
+{
+    PerformanceProfile PerformanceProfile::declare(rclcpp::Node *node, const std::string &name, const PerformanceProfile &defaults)
+    {
+        PerformanceProfile profile;
+        const std::string prefix = "profiles." + name + ".";
+        profile.rosVisualization = node->declare_parameter(prefix + "ros_visualization", defaults.rosVisualization);
+        profile.rosVisualizationRate = node->declare_parameter(prefix + "ros_visualization_rate", defaults.rosVisualizationRate);
+        profile.mapDataRate = node->declare_parameter(prefix + "map_data_rate", defaults.mapDataRate);
+        profile.mapPointsRate = node->declare_parameter(prefix + "map_points_rate", defaults.mapPointsRate);
+        profile.adaptiveTrackingLoad = node->declare_parameter(prefix + "adaptive_tracking_load", defaults.adaptiveTrackingLoad);
+        profile.maxFrameStride = node->declare_parameter(prefix + "max_frame_stride", defaults.maxFrameStride);
+        profile.minTrackedInliers = node->declare_parameter(prefix + "min_tracked_inliers", defaults.minTrackedInliers);
+        profile.orbFeatures = node->declare_parameter(prefix + "orb_features", defaults.orbFeatures);
+        profile.orbLevels = node->declare_parameter(prefix + "orb_levels", defaults.orbLevels);
+        profile.minOrbFeatures = node->declare_parameter(prefix + "min_orb_features", defaults.minOrbFeatures);
+        profile.minOrbLevels = node->declare_parameter(prefix + "min_orb_levels", defaults.minOrbLevels);
+        return profile;
+    }
+
+    std::vector<rclcpp::Parameter> PerformanceProfile::toParameters() const
+    {
+        return {
+            rclcpp::Parameter("ros_visualization", rosVisualization),
+            rclcpp::Parameter("ros_visualization_rate", rosVisualizationRate),
+            rclcpp::Parameter("map_data_rate", mapDataRate),
+            rclcpp::Parameter("map_points_rate", mapPointsRate),
+            rclcpp::Parameter("adaptive_tracking_load", adaptiveTrackingLoad),
+            rclcpp::Parameter("max_frame_stride", maxFrameStride),
+            rclcpp::Parameter("min_tracked_inliers", minTrackedInliers),
+            rclcpp::Parameter("orb_features", orbFeatures),
+            rclcpp::Parameter("orb_levels", orbLevels),
+            rclcpp::Parameter("min_orb_features", minOrbFeatures),
+            rclcpp::Parameter("min_orb_levels", minOrbLevels)};
+    }
+}
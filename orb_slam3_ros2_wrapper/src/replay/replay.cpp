@@ -0,0 +1,148 @@
+/**
+ * @file replay.cpp
+ * @brief Feeds an input recording back through the ORBSLAM3Interface and compares the results with the recording.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "orb_slam3_interface.hpp"
+#include "input_recorder.hpp"
+#include "allocation_counter.hpp"
+
+int main(int argc, char **argv)
+{
+    if (argc < 4)
+    {
+        std::cerr << "\nUsage: ros2 run orb_slam3_ros2_wrapper replay path_to_vocabulary path_to_settings path_to_recording"
+                  << " [--realtime] [--max-allocations n]" << std::endl;
+        return 1;
+    }
+    // with --realtime the frames are handed over at their recorded times instead of as fast as possible,
+    // so LocalMapping gets the same time between the frames as in the recorded run.
+    bool realtime = false;
+    // with --max-allocations the replay fails if the tracking of a frame allocates more often on average,
+    // which turns a recording into a regression check of the steady state allocations. The check then decides
+    // the exit code alone, divergences of the threads' timing are only reported.
+    long maxAllocations = -1;
+    for (int i = 4; i < argc; i++)
+    {
+        std::string argument(argv[i]);
+        if (argument == "--realtime")
+        {
+            realtime = true;
+        }
+        else if (argument == "--max-allocations" && i + 1 < argc)
+        {
+            maxAllocations = std::atol(argv[++i]);
+        }
+        else
+        {
+            std::cerr << "Unknown argument " << argument << std::endl;
+            return 1;
+        }
+    }
+    ORB_SLAM3_Wrapper::AllocationCounter::setEnabled(maxAllocations >= 0);
+
+    ORB_SLAM3_Wrapper::InputLogReader reader;
+    if (!reader.open(argv[3]))
+    {
+        return 1;
+    }
+    auto interface = std::make_shared<ORB_SLAM3_Wrapper::ORBSLAM3Interface>(argv[1], argv[2], ORB_SLAM3::System::RGBD,
+                                                                           false, false, 0.0, 0.0, "map", "odom");
+
+    unsigned long frames = 0;
+    unsigned long gaps = 0;
+    unsigned long poseMismatches = 0;
+    unsigned long stateMismatches = 0;
+    long firstDivergence = -1;
+    double recordedTrackMs = 0.0;
+    double replayedTrackMs = 0.0;
+    uint64_t expectedSequence = 0;
+    // the first frames initialize the map and allocate a lot, they are not part of the steady state.
+    const unsigned long warmupFrames = 30;
+    unsigned long long steadyAllocations = 0;
+    unsigned long long steadyBytes = 0;
+    auto start = std::chrono::steady_clock::now();
+    ORB_SLAM3_Wrapper::RecordedFrame frame;
+    while (reader.next(frame))
+    {
+        if (frame.sequence != expectedSequence)
+        {
+            gaps += frame.sequence - expectedSequence;
+        }
+        expectedSequence = frame.sequence + 1;
+        if (realtime)
+        {
+            std::this_thread::sleep_until(start + std::chrono::nanoseconds(frame.receiveNs));
+        }
+
+        // the interface takes mutable messages, the recorded ones are not used afterwards.
+        auto msgRGB = std::const_pointer_cast<sensor_msgs::msg::Image>(frame.rgb);
+        auto msgD = std::const_pointer_cast<sensor_msgs::msg::Image>(frame.depth);
+        Sophus::SE3f Tcw;
+        ORB_SLAM3_Wrapper::AllocationCount before = ORB_SLAM3_Wrapper::AllocationCounter::thread();
+        interface->trackRGBDi(msgRGB, msgD, frame.imu, Tcw);
+        ORB_SLAM3_Wrapper::AllocationCount after = ORB_SLAM3_Wrapper::AllocationCounter::thread();
+        if (frames >= warmupFrames)
+        {
+            steadyAllocations += after.allocations - before.allocations;
+            steadyBytes += after.bytes - before.bytes;
+        }
+        frames++;
+        replayedTrackMs += interface->getStageTimer().get("track_rgbd").lastMs;
+        recordedTrackMs += frame.trackMs;
+
+        bool samePose = std::memcmp(Tcw.data(), frame.Tcw.data(), Sophus::SE3f::num_parameters * sizeof(float)) == 0;
+        bool sameState = interface->getTrackingState() == frame.trackingState;
+        poseMismatches += samePose ? 0 : 1;
+        stateMismatches += sameState ? 0 : 1;
+        if ((!samePose || !sameState) && firstDivergence < 0)
+        {
+            firstDivergence = static_cast<long>(frame.sequence);
+            std::cout << "First divergence at frame " << frame.sequence << ": state " << interface->getTrackingState()
+                      << " (recorded " << frame.trackingState << "), translation error "
+                      << (Tcw.translation() - frame.Tcw.translation()).norm() << " m" << std::endl;
+        }
+    }
+
+    std::cout << "============================ " << std::endl;
+    std::cout << "Replayed frames: " << frames << std::endl;
+    std::cout << "Frames missing in the recording: " << gaps << std::endl;
+    std::cout << "Frames with a different pose: " << poseMismatches << std::endl;
+    std::cout << "Frames with a different tracking state: " << stateMismatches << std::endl;
+    if (frames > 0)
+    {
+        std::cout << "Average track_rgbd [ms]: recorded " << recordedTrackMs / frames << ", replayed " << replayedTrackMs / frames << std::endl;
+    }
+    // LocalMapping and LoopClosing run in their own threads, so the results of a replay are only expected to be
+    // identical if they got the same time between the frames (see --realtime) or if the inputs are the cause.
+    if (gaps > 0)
+    {
+        std::cout << "The recording has gaps, the replay can not match the recorded run." << std::endl;
+    }
+    interface.reset();
+    if (maxAllocations < 0)
+    {
+        return firstDivergence < 0 ? 0 : 2;
+    }
+    if (firstDivergence >= 0)
+    {
+        std::cout << "Warning: the replay diverged, it is not part of the allocation check." << std::endl;
+    }
+    if (frames <= warmupFrames)
+    {
+        std::cerr << "The recording has no frames after the " << warmupFrames << " warmup frames, the allocations can not be checked." << std::endl;
+        return 1;
+    }
+    double allocationsPerFrame = static_cast<double>(steadyAllocations) / (frames - warmupFrames);
+    std::cout << "Steady state allocations per frame: " << allocationsPerFrame << " (" << steadyBytes / (frames - warmupFrames) / 1024
+              << " KB), limit " << maxAllocations << std::endl;
+    return allocationsPerFrame > maxAllocations ? 3 : 0;
+}
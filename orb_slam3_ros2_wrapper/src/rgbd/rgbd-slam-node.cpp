@@ -11,8 +11,9 @@ namespace ORB_SLAM3_Wrapper
 {
     RgbdSlamNode::RgbdSlamNode(const std::string &strVocFile,
                                const std::string &strSettingsFile,
-                               ORB_SLAM3::System::eSensor sensor)
-        : Node("ORB_SLAM3_RGBD_ROS2")
+                               ORB_SLAM3::System::eSensor sensor,
+                               const rclcpp::NodeOptions &options)
+        : Node("ORB_SLAM3_RGBD_ROS2", options)
     {
         // ROS Subscribers
         rgb_sub = std::make_shared<message_filters::Subscriber<sensor_msgs::msg::Image>>(this, "camera/image_raw");
@@ -23,20 +24,61 @@ namespace ORB_SLAM3_Wrapper
         odom_sub = this->create_subscription<nav_msgs::msg::Odometry>("odom", 1000, std::bind(&RgbdSlamNode::OdomCallback, this, std::placeholders::_1));
         // ROS Publishers
         map_data_pub = this->create_publisher<slam_msgs::msg::MapData>("map_data", 10);
-        map_points_pub = this->create_publisher<sensor_msgs::msg::PointCloud2>("map_points", 10);
+        // the map outputs and the keyframe images hand their data to intra-process subscribers. Only these publishers
+        // use intra-process, the others are published by reference and would be copied for it.
+        rclcpp::PublisherOptions intraProcessOptions;
+        intraProcessOptions.use_intra_process_comm = rclcpp::IntraProcessSetting::Enable;
+        map_points_pub = this->create_publisher<ORB_SLAM3_Wrapper::MapPointArrayAdapter>("map_points", 10, intraProcessOptions);
+        keyframe_poses_pub = this->create_publisher<ORB_SLAM3_Wrapper::KeyFramePoseArrayAdapter>("keyframe_poses", 10, intraProcessOptions);
+        keyframe_markers_pub = this->create_publisher<visualization_msgs::msg::MarkerArray>("keyframe_markers", 10);
+        diagnostics_pub = this->create_publisher<diagnostic_msgs::msg::DiagnosticArray>("/diagnostics", 10);
+        // keyframe stream, emitted once per inserted keyframe. The pose carries the stamps of both images for exact pairing.
+        keyframe_rgb_pub = this->create_publisher<ORB_SLAM3_Wrapper::SharedImageAdapter>("keyframe/rgb", 10, intraProcessOptions);
+        keyframe_depth_pub = this->create_publisher<ORB_SLAM3_Wrapper::SharedImageAdapter>("keyframe/depth", 10, intraProcessOptions);
+        keyframe_pose_pub = this->create_publisher<slam_msgs::msg::KeyFramePose>("keyframe/pose", 10);
+        // the complete grid is latched like the map of the Nav2 map server, changes go to the updates topic.
+        occupancy_grid_pub = this->create_publisher<nav_msgs::msg::OccupancyGrid>("occupancy_grid", rclcpp::QoS(1).transient_local().reliable());
+        occupancy_grid_updates_pub = this->create_publisher<map_msgs::msg::OccupancyGridUpdate>("occupancy_grid_updates", 10);
         // Services
         get_map_data_service = this->create_service<slam_msgs::srv::GetMap>("orb_slam3_get_map_data", std::bind(&RgbdSlamNode::getMapServer, this,
                                                                                                                 std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+        localization_mode_service = this->create_service<std_srvs::srv::SetBool>("orb_slam3_localization_mode", std::bind(&RgbdSlamNode::localizationModeServer, this,
+                                                                                                                         std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+        performance_profile_service = this->create_service<slam_msgs::srv::SetPerformanceProfile>("orb_slam3_set_performance_profile", std::bind(&RgbdSlamNode::performanceProfileServer, this,
+                                                                                                                                                   std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+        keyframe_images_service = this->create_service<slam_msgs::srv::GetKeyFrameImages>("orb_slam3_get_keyframe_images", std::bind(&RgbdSlamNode::keyFrameImagesServer, this,
+                                                                                                                                    std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+        dense_cloud_service = this->create_service<slam_msgs::srv::GetDenseCloud>("orb_slam3_get_dense_cloud", std::bind(&RgbdSlamNode::denseCloudServer, this,
+                                                                                                                       std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+        export_trajectory_service = this->create_service<slam_msgs::srv::ExportTrajectory>("orb_slam3_export_trajectory", std::bind(&RgbdSlamNode::exportTrajectoryServer, this,
+                                                                                                                               std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+        set_initial_pose_service = this->create_service<slam_msgs::srv::SetInitialPose>("orb_slam3_set_initial_pose", std::bind(&RgbdSlamNode::setInitialPoseServer, this,
+                                                                                                                             std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
         // TF
         tf_broadcaster_ = std::make_shared<tf2_ros::TransformBroadcaster>(this);
 
         bool bUseViewer;
-        this->declare_parameter("visualization", rclcpp::ParameterValue(true));
+        // Pangolin is off by default, the ROS visualization publishes the same information headless.
+        this->declare_parameter("visualization", rclcpp::ParameterValue(false));
         this->get_parameter("visualization", bUseViewer);
 
         this->declare_parameter("ros_visualization", rclcpp::ParameterValue(true));
         this->get_parameter("ros_visualization", rosViz_);
 
+        // 0 turns the keyframe markers off.
+        this->declare_parameter("ros_visualization_rate", rclcpp::ParameterValue(2.0));
+        this->get_parameter("ros_visualization_rate", rosVizRate_);
+
+        this->declare_parameter("covisibility_min_weight", rclcpp::ParameterValue(100));
+        this->get_parameter("covisibility_min_weight", covisibilityMinWeight_);
+
+        // 0 publishes on every tracked frame.
+        this->declare_parameter("map_data_rate", rclcpp::ParameterValue(0.0));
+        this->get_parameter("map_data_rate", mapDataRate_);
+
+        this->declare_parameter("map_points_rate", rclcpp::ParameterValue(0.0));
+        this->get_parameter("map_points_rate", mapPointsRate_);
+
         this->declare_parameter("robot_base_frame", "base_link");
         this->get_parameter("robot_base_frame", robot_base_frame_id_);
 
@@ -52,9 +94,408 @@ namespace ORB_SLAM3_Wrapper
         this->declare_parameter("robot_y", rclcpp::ParameterValue(1.0));
         this->get_parameter("robot_y", robot_y_);
 
+        this->declare_parameter("adaptive_tracking_load", rclcpp::ParameterValue(false));
+        this->get_parameter("adaptive_tracking_load", adaptiveTrackingLoad_);
+
+        // 0 uses the camera frame period of the ORB-SLAM3 settings file.
+        this->declare_parameter("tracking_latency_budget_ms", rclcpp::ParameterValue(0.0));
+        this->get_parameter("tracking_latency_budget_ms", trackingLatencyBudgetMs_);
+        if (trackingLatencyBudgetMs_ <= 0.0)
+        {
+            cv::FileStorage fsSettings(strSettingsFile, cv::FileStorage::READ);
+            double cameraFps = fsSettings.isOpened() ? (double)fsSettings["Camera.fps"] : 0.0;
+            trackingLatencyBudgetMs_ = cameraFps > 0.0 ? 1000.0 / cameraFps : 33.3;
+        }
+
+        this->declare_parameter("min_tracked_inliers", rclcpp::ParameterValue(80));
+        this->get_parameter("min_tracked_inliers", minTrackedInliers_);
+
+        this->declare_parameter("max_frame_stride", rclcpp::ParameterValue(3));
+        this->get_parameter("max_frame_stride", maxFrameStride_);
+
+        // upper bounds of the ORB extractor, 0 uses the settings file.
+        this->declare_parameter("orb_features", rclcpp::ParameterValue(0));
+        this->get_parameter("orb_features", orbFeatures_);
+
+        this->declare_parameter("orb_levels", rclcpp::ParameterValue(0));
+        this->get_parameter("orb_levels", orbLevels_);
+
+        // lower bounds of the ORB extractor under load.
+        this->declare_parameter("min_orb_features", rclcpp::ParameterValue(400));
+        this->get_parameter("min_orb_features", minOrbFeatures_);
+
+        this->declare_parameter("min_orb_levels", rclcpp::ParameterValue(4));
+        this->get_parameter("min_orb_levels", minOrbLevels_);
+
+        trackingLoadController_ = std::make_shared<ORB_SLAM3_Wrapper::TrackingLoadController>(trackingLatencyBudgetMs_, minTrackedInliers_, maxFrameStride_);
+
+        // 0 disables the eviction, the memory usage is still reported.
+        double memoryBudgetMB;
+        this->declare_parameter("memory_budget_mb", rclcpp::ParameterValue(0.0));
+        this->get_parameter("memory_budget_mb", memoryBudgetMB);
+
+        double retentionRedundancy;
+        this->declare_parameter("retention_redundancy", rclcpp::ParameterValue(0.9));
+        this->get_parameter("retention_redundancy", retentionRedundancy);
+
+        int retentionMinObservations;
+        this->declare_parameter("retention_min_observations", rclcpp::ParameterValue(3));
+        this->get_parameter("retention_min_observations", retentionMinObservations);
+
+        int retentionProtectedKeyFrames;
+        this->declare_parameter("retention_protected_keyframes", rclcpp::ParameterValue(50));
+        this->get_parameter("retention_protected_keyframes", retentionProtectedKeyFrames);
+
+        this->declare_parameter("occupancy_grid", rclcpp::ParameterValue(false));
+        this->get_parameter("occupancy_grid", occupancyGrid_);
+
+        this->declare_parameter("occupancy_grid_rate", rclcpp::ParameterValue(1.0));
+        this->get_parameter("occupancy_grid_rate", occupancyGridRate_);
+
+        double occupancyResolution;
+        this->declare_parameter("occupancy_resolution", rclcpp::ParameterValue(0.05));
+        this->get_parameter("occupancy_resolution", occupancyResolution);
+
+        // height band of the landmarks which are obstacles, in the global frame.
+        double occupancyMinHeight;
+        this->declare_parameter("occupancy_min_height", rclcpp::ParameterValue(0.1));
+        this->get_parameter("occupancy_min_height", occupancyMinHeight);
+
+        double occupancyMaxHeight;
+        this->declare_parameter("occupancy_max_height", rclcpp::ParameterValue(1.5));
+        this->get_parameter("occupancy_max_height", occupancyMaxHeight);
+
+        int occupancyHitThreshold;
+        this->declare_parameter("occupancy_hit_threshold", rclcpp::ParameterValue(2));
+        this->get_parameter("occupancy_hit_threshold", occupancyHitThreshold);
+
+        double occupancyMaxRange;
+        this->declare_parameter("occupancy_max_range", rclcpp::ParameterValue(5.0));
+        this->get_parameter("occupancy_max_range", occupancyMaxRange);
+
+        bool tsdfFusion;
+        this->declare_parameter("tsdf_fusion", rclcpp::ParameterValue(false));
+        this->get_parameter("tsdf_fusion", tsdfFusion);
+
+        double tsdfVoxelSize;
+        this->declare_parameter("tsdf_voxel_size", rclcpp::ParameterValue(0.02));
+        this->get_parameter("tsdf_voxel_size", tsdfVoxelSize);
+
+        double tsdfTruncation;
+        this->declare_parameter("tsdf_truncation", rclcpp::ParameterValue(0.08));
+        this->get_parameter("tsdf_truncation", tsdfTruncation);
+
+        double tsdfMaxDepth;
+        this->declare_parameter("tsdf_max_depth", rclcpp::ParameterValue(4.0));
+        this->get_parameter("tsdf_max_depth", tsdfMaxDepth);
+
+        int tsdfPixelStride;
+        this->declare_parameter("tsdf_pixel_stride", rclcpp::ParameterValue(2));
+        this->get_parameter("tsdf_pixel_stride", tsdfPixelStride);
+
+        // keyframes whose depth is kept for corrections, older ones stay in the volume as they are. 0 keeps all.
+        int tsdfMaxKeyFrames;
+        this->declare_parameter("tsdf_max_keyframes", rclcpp::ParameterValue(300));
+        this->get_parameter("tsdf_max_keyframes", tsdfMaxKeyFrames);
+
+        // rate at which corrected keyframe poses are handed to the fusion thread.
+        this->declare_parameter("tsdf_pose_update_rate", rclcpp::ParameterValue(0.5));
+        this->get_parameter("tsdf_pose_update_rate", tsdfPoseUpdateRate_);
+
+        // memory budget of the compressed keyframe images, 0 disables the cache.
+        double keyFrameImageCacheMB;
+        this->declare_parameter("keyframe_image_cache_mb", rclcpp::ParameterValue(0.0));
+        this->get_parameter("keyframe_image_cache_mb", keyFrameImageCacheMB);
+
+        // least recently used images are moved here, empty drops them.
+        std::string keyFrameImageSpillDirectory;
+        this->declare_parameter("keyframe_image_spill_directory", rclcpp::ParameterValue(std::string("")));
+        this->get_parameter("keyframe_image_spill_directory", keyFrameImageSpillDirectory);
+
+        // every frame is appended to the trajectory log, empty disables it.
+        std::string trajectoryLogFile;
+        std::string trajectoryLogFormat;
+        double trajectoryLogFlushPeriod;
+        this->declare_parameter("trajectory_log_file", rclcpp::ParameterValue(std::string("")));
+        this->get_parameter("trajectory_log_file", trajectoryLogFile);
+        this->declare_parameter("trajectory_log_format", rclcpp::ParameterValue(std::string("tum")));
+        this->get_parameter("trajectory_log_format", trajectoryLogFormat);
+        this->declare_parameter("trajectory_log_flush_period", rclcpp::ParameterValue(1.0));
+        this->get_parameter("trajectory_log_flush_period", trajectoryLogFlushPeriod);
+
+        // the tracker inputs are recorded for an offline replay, empty disables it.
+        std::string inputRecordFile;
+        int inputRecordCompression;
+        int inputRecordQueue;
+        this->declare_parameter("input_record_file", rclcpp::ParameterValue(std::string("")));
+        this->get_parameter("input_record_file", inputRecordFile);
+        this->declare_parameter("input_record_compression", rclcpp::ParameterValue(1));
+        this->get_parameter("input_record_compression", inputRecordCompression);
+        this->declare_parameter("input_record_queue", rclcpp::ParameterValue(30));
+        this->get_parameter("input_record_queue", inputRecordQueue);
+
+        // the sampling profiler is started through a service, it is off by default as it installs a SIGPROF handler.
+        bool profilerEnabled;
+        this->declare_parameter("profiler_enabled", rclcpp::ParameterValue(false));
+        this->get_parameter("profiler_enabled", profilerEnabled);
+        this->declare_parameter("profiler_directory", rclcpp::ParameterValue(std::string("/tmp")));
+        this->get_parameter("profiler_directory", profilerDirectory_);
+
+        // heap allocations per stage, the budget applies to the allocations of a frame in steady state.
+        bool allocationTracking;
+        int allocationBudget;
+        this->declare_parameter("allocation_tracking", rclcpp::ParameterValue(false));
+        this->get_parameter("allocation_tracking", allocationTracking);
+        this->declare_parameter("allocation_budget_per_frame", rclcpp::ParameterValue(0));
+        this->get_parameter("allocation_budget_per_frame", allocationBudget);
+        ORB_SLAM3_Wrapper::AllocationCounter::setEnabled(allocationTracking);
+        allocationBudget_ = static_cast<unsigned long>(std::max(allocationBudget, 0));
+
+        // relocalization is restricted to the keyframes around a pose prior, from the service or the odometry.
+        bool initialPoseFromOdom;
+        this->declare_parameter("initial_pose_radius", rclcpp::ParameterValue(3.0));
+        this->get_parameter("initial_pose_radius", initialPoseRadius_);
+        this->declare_parameter("initial_pose_from_odom", rclcpp::ParameterValue(false));
+        this->get_parameter("initial_pose_from_odom", initialPoseFromOdom);
+
+        // the odometry prediction of the camera motion replaces the constant velocity model of the tracker,
+        // the outcomes of the tracker are counted with and without it.
+        bool motionPriorEvaluation;
+        bool motionPriorFeedTracker;
+        double motionPriorMaxTimeDifference;
+        this->declare_parameter("motion_prior_evaluation", rclcpp::ParameterValue(false));
+        this->get_parameter("motion_prior_evaluation", motionPriorEvaluation);
+        this->declare_parameter("motion_prior_feed_tracker", rclcpp::ParameterValue(true));
+        this->get_parameter("motion_prior_feed_tracker", motionPriorFeedTracker);
+        // pose of the camera optical frame in the robot base frame as x, y, z, roll, pitch, yaw.
+        std::vector<double> motionPriorCameraPose = this->declare_parameter("motion_prior_camera_pose", std::vector<double>{0.0, 0.0, 0.0, -M_PI_2, 0.0, -M_PI_2});
+        this->declare_parameter("motion_prior_max_time_difference", rclcpp::ParameterValue(0.05));
+        this->get_parameter("motion_prior_max_time_difference", motionPriorMaxTimeDifference);
+
+        // frames are skipped while the robot stands still, the last pose is published for them.
+        bool stationaryGating;
+        double stationaryMaxLinearSpeed;
+        double stationaryMaxAngularSpeed;
+        double stationaryMaxImageDifference;
+        double stationaryHoldTime;
+        double stationaryTrackInterval;
+        this->declare_parameter("stationary_gating", rclcpp::ParameterValue(false));
+        this->get_parameter("stationary_gating", stationaryGating);
+        this->declare_parameter("stationary_max_linear_speed", rclcpp::ParameterValue(0.01));
+        this->get_parameter("stationary_max_linear_speed", stationaryMaxLinearSpeed);
+        this->declare_parameter("stationary_max_angular_speed", rclcpp::ParameterValue(0.02));
+        this->get_parameter("stationary_max_angular_speed", stationaryMaxAngularSpeed);
+        this->declare_parameter("stationary_max_image_difference", rclcpp::ParameterValue(3.0));
+        this->get_parameter("stationary_max_image_difference", stationaryMaxImageDifference);
+        this->declare_parameter("stationary_hold_time", rclcpp::ParameterValue(0.5));
+        this->get_parameter("stationary_hold_time", stationaryHoldTime);
+        this->declare_parameter("stationary_track_interval", rclcpp::ParameterValue(1.0));
+        this->get_parameter("stationary_track_interval", stationaryTrackInterval);
+        if (stationaryGating)
+        {
+            stationaryGate_ = std::make_shared<ORB_SLAM3_Wrapper::StationaryGate>(stationaryMaxLinearSpeed, stationaryMaxAngularSpeed, stationaryMaxImageDifference,
+                                                                                  stationaryHoldTime, stationaryTrackInterval);
+        }
+
+        // frames which can not be tracked are skipped before the feature extraction.
+        bool imageQualityFilter;
+        double minSharpnessRatio;
+        double maxClippedFraction;
+        double minTexturedFraction;
+        double minValidDepthFraction;
+        int maxQualitySkips;
+        this->declare_parameter("image_quality_filter", rclcpp::ParameterValue(false));
+        this->get_parameter("image_quality_filter", imageQualityFilter);
+        this->declare_parameter("min_sharpness_ratio", rclcpp::ParameterValue(0.3));
+        this->get_parameter("min_sharpness_ratio", minSharpnessRatio);
+        this->declare_parameter("max_clipped_fraction", rclcpp::ParameterValue(0.5));
+        this->get_parameter("max_clipped_fraction", maxClippedFraction);
+        this->declare_parameter("min_textured_fraction", rclcpp::ParameterValue(0.2));
+        this->get_parameter("min_textured_fraction", minTexturedFraction);
+        this->declare_parameter("min_valid_depth_fraction", rclcpp::ParameterValue(0.2));
+        this->get_parameter("min_valid_depth_fraction", minValidDepthFraction);
+        this->declare_parameter("max_quality_skips", rclcpp::ParameterValue(5));
+        this->get_parameter("max_quality_skips", maxQualitySkips);
+        if (imageQualityFilter)
+        {
+            imageQualityFilter_ = std::make_shared<ORB_SLAM3_Wrapper::ImageQualityFilter>(minSharpnessRatio, maxClippedFraction, minTexturedFraction,
+                                                                                          minValidDepthFraction, maxQualitySkips);
+        }
+
+        // only every n-th frame goes through ORB-SLAM3, the ones between are tracked by optical flow.
+        int kltMinInliers;
+        double kltMaxReprojectionError;
+        this->declare_parameter("klt_frame_stride", rclcpp::ParameterValue(1));
+        this->get_parameter("klt_frame_stride", kltFrameStride_);
+        this->declare_parameter("klt_min_inliers", rclcpp::ParameterValue(30));
+        this->get_parameter("klt_min_inliers", kltMinInliers);
+        this->declare_parameter("klt_max_reprojection_error", rclcpp::ParameterValue(2.0));
+        this->get_parameter("klt_max_reprojection_error", kltMaxReprojectionError);
+
+        // live accuracy against a ground truth odometry (simulation).
+        bool trajectoryEvaluation;
+        double evaluationMaxTimeDifference;
+        double evaluationRpeDelta;
+        this->declare_parameter("trajectory_evaluation", rclcpp::ParameterValue(false));
+        this->get_parameter("trajectory_evaluation", trajectoryEvaluation);
+        this->declare_parameter("evaluation_max_time_difference", rclcpp::ParameterValue(0.02));
+        this->get_parameter("evaluation_max_time_difference", evaluationMaxTimeDifference);
+        this->declare_parameter("evaluation_rpe_delta", rclcpp::ParameterValue(1.0));
+        this->get_parameter("evaluation_rpe_delta", evaluationRpeDelta);
+
+        double memoryCheckPeriod;
+        this->declare_parameter("memory_check_period", rclcpp::ParameterValue(5.0));
+        this->get_parameter("memory_check_period", memoryCheckPeriod);
+
+        bool localizationMode;
+        this->declare_parameter("localization_mode", rclcpp::ParameterValue(false));
+        this->get_parameter("localization_mode", localizationMode);
+
         interface = std::make_shared<ORB_SLAM3_Wrapper::ORBSLAM3Interface>(strVocFile, strSettingsFile,
                                                                            sensor, bUseViewer, rosViz_, robot_x_,
                                                                            robot_y_, global_frame_, odom_frame_id_);
+        interface->setLocalizationMode(localizationMode);
+        // the stride is the last resort of the load controller, it lowers the extractor first.
+        if (!ORB_SLAM3_Wrapper::OrbExtractorSettings::fromSettingsFile(strSettingsFile, orbExtractor_))
+        {
+            RCLCPP_WARN(this->get_logger(), "No ORBextractor settings in the settings file, the tracking load is only adapted by the frame stride.");
+        }
+        else if (!interface->setORBExtractor(getOrbExtractorLimit()))
+        {
+            RCLCPP_WARN(this->get_logger(), "ORB-SLAM3 was built without the ORB extractor hook, the tracking load is only adapted by the frame stride.");
+        }
+        else
+        {
+            orbExtractorControl_ = true;
+            trackingLoadController_->setExtractorBounds(getOrbExtractorLimit(), minOrbFeatures_, minOrbLevels_);
+        }
+        interface->setOdometryPosePrior(initialPoseFromOdom, initialPoseRadius_);
+        interface->setRetentionPolicy(std::make_shared<ORB_SLAM3_Wrapper::MapRetentionPolicy>(static_cast<size_t>(memoryBudgetMB * 1024.0 * 1024.0),
+                                                                                              retentionRedundancy, retentionMinObservations,
+                                                                                              retentionProtectedKeyFrames));
+        keyFrameImageCache_ = std::make_shared<ORB_SLAM3_Wrapper::KeyFrameImageCache>(static_cast<size_t>(keyFrameImageCacheMB * 1024.0 * 1024.0),
+                                                                                       keyFrameImageSpillDirectory);
+        interface->setKeyFrameImageCache(keyFrameImageCache_);
+        mapVisualizer_ = std::make_shared<ORB_SLAM3_Wrapper::MapVisualizer>(global_frame_);
+        lastTsdfPoseUpdateTime_ = this->now();
+        if (!trajectoryLogFile.empty())
+        {
+            if (trajectoryLogFormat != "tum" && trajectoryLogFormat != "binary")
+            {
+                RCLCPP_WARN_STREAM(this->get_logger(), "Unknown trajectory log format " << trajectoryLogFormat << ", using tum.");
+            }
+            trajectoryLogger_ = std::make_shared<ORB_SLAM3_Wrapper::TrajectoryLogger>(trajectoryLogFile, trajectoryLogFormat == "binary", trajectoryLogFlushPeriod);
+            trajectoryExportFile_ = trajectoryLogFile + ".corrected.txt";
+        }
+        if (!inputRecordFile.empty())
+        {
+            inputRecorder_ = std::make_shared<ORB_SLAM3_Wrapper::InputRecorder>(inputRecordFile, inputRecordCompression,
+                                                                               static_cast<size_t>(std::max(inputRecordQueue, 1)));
+            interface->setInputRecorder(inputRecorder_);
+        }
+        if (profilerEnabled)
+        {
+            samplingProfiler_ = std::make_shared<ORB_SLAM3_Wrapper::SamplingProfiler>();
+            start_profiling_service = this->create_service<slam_msgs::srv::StartProfiling>("orb_slam3_start_profiling", std::bind(&RgbdSlamNode::startProfilingServer, this,
+                                                                                                                              std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+        }
+        if (trajectoryEvaluation)
+        {
+            trajectoryEvaluator_ = std::make_shared<ORB_SLAM3_Wrapper::TrajectoryEvaluator>(evaluationMaxTimeDifference, evaluationRpeDelta);
+            ground_truth_sub = this->create_subscription<nav_msgs::msg::Odometry>("ground_truth", 1000, std::bind(&RgbdSlamNode::GroundTruthCallback, this, std::placeholders::_1));
+            trajectory_error_pub = this->create_publisher<slam_msgs::msg::TrajectoryError>("trajectory_error", 10);
+            // the corrected poses come through the in-process subscriber API, off the tracking thread.
+            interface->subscribeTrackedPose([this](const ORB_SLAM3_Wrapper::TrackedPoseEvent &event)
+                                            { trajectoryEvaluator_->addEstimate(event.stamp, event.pose); },
+                                            100);
+            evaluation_timer_ = this->create_wall_timer(std::chrono::seconds(1), std::bind(&RgbdSlamNode::publishTrajectoryError, this));
+        }
+        if (tsdfFusion)
+        {
+            ORB_SLAM3_Wrapper::DepthCameraIntrinsics intrinsics;
+            if (ORB_SLAM3_Wrapper::DepthCameraIntrinsics::fromSettingsFile(strSettingsFile, intrinsics))
+            {
+                tsdfFusion_ = std::make_shared<ORB_SLAM3_Wrapper::TsdfFusion>(intrinsics, tsdfVoxelSize, tsdfTruncation, tsdfMaxDepth, tsdfPixelStride,
+                                                                              static_cast<size_t>(std::max(0, tsdfMaxKeyFrames)));
+                interface->setCollectRemovedKeyFrames(true);
+            }
+            else
+            {
+                RCLCPP_ERROR(this->get_logger(), "No pinhole intrinsics in the settings file, TSDF fusion is disabled.");
+            }
+        }
+        if (kltFrameStride_ > 1)
+        {
+            ORB_SLAM3_Wrapper::DepthCameraIntrinsics intrinsics;
+            if (ORB_SLAM3_Wrapper::DepthCameraIntrinsics::fromSettingsFile(strSettingsFile, intrinsics))
+            {
+                kltTracker_ = std::make_shared<ORB_SLAM3_Wrapper::KltFrameTracker>(intrinsics.fx, intrinsics.fy, intrinsics.cx, intrinsics.cy,
+                                                                                   kltMinInliers, kltMaxReprojectionError);
+                interface->setIntermediateFrameTracker(kltTracker_);
+            }
+            else
+            {
+                RCLCPP_ERROR(this->get_logger(), "No pinhole intrinsics in the settings file, intermediate frame tracking is disabled.");
+                kltFrameStride_ = 1;
+            }
+        }
+        if (motionPriorEvaluation)
+        {
+            if (motionPriorCameraPose.size() != 6)
+            {
+                RCLCPP_ERROR(this->get_logger(), "motion_prior_camera_pose needs 6 values, the motion prior is disabled.");
+            }
+            else
+            {
+                Eigen::Affine3d baseToCamera = Eigen::Translation3d(motionPriorCameraPose[0], motionPriorCameraPose[1], motionPriorCameraPose[2]) *
+                                               Eigen::AngleAxisd(motionPriorCameraPose[5], Eigen::Vector3d::UnitZ()) *
+                                               Eigen::AngleAxisd(motionPriorCameraPose[4], Eigen::Vector3d::UnitY()) *
+                                               Eigen::AngleAxisd(motionPriorCameraPose[3], Eigen::Vector3d::UnitX());
+                motionPrior_ = std::make_shared<ORB_SLAM3_Wrapper::OdometryMotionPrior>(baseToCamera, motionPriorMaxTimeDifference);
+                if (!interface->setMotionPrior(motionPrior_, motionPriorFeedTracker))
+                {
+                    RCLCPP_WARN(this->get_logger(), "ORB-SLAM3 was built without the motion prior hook, only lost frames are counted.");
+                }
+            }
+        }
+        occupancyGridBuilder_ = std::make_shared<ORB_SLAM3_Wrapper::OccupancyGridBuilder>(occupancyResolution, occupancyMinHeight, occupancyMaxHeight,
+                                                                                           occupancyHitThreshold, occupancyMaxRange);
+
+        // Performance profiles. Fields missing in the parameter file default to the values above.
+        PerformanceProfile currentSettings;
+        currentSettings.rosVisualization = rosViz_;
+        currentSettings.rosVisualizationRate = rosVizRate_;
+        currentSettings.mapDataRate = mapDataRate_;
+        currentSettings.mapPointsRate = mapPointsRate_;
+        currentSettings.adaptiveTrackingLoad = adaptiveTrackingLoad_;
+        currentSettings.maxFrameStride = maxFrameStride_;
+        currentSettings.minTrackedInliers = minTrackedInliers_;
+        currentSettings.orbFeatures = orbFeatures_;
+        currentSettings.orbLevels = orbLevels_;
+        currentSettings.minOrbFeatures = minOrbFeatures_;
+        currentSettings.minOrbLevels = minOrbLevels_;
+        auto profileNames = this->declare_parameter("performance_profiles", std::vector<std::string>());
+        for (const auto &profileName : profileNames)
+        {
+            performanceProfiles_[profileName] = PerformanceProfile::declare(this, profileName, currentSettings);
+        }
+
+        parameter_callback_handle_ = this->add_on_set_parameters_callback(std::bind(&RgbdSlamNode::onParameterChange, this, std::placeholders::_1));
+
+        std::string initialProfile;
+        this->declare_parameter("performance_profile", "");
+        this->get_parameter("performance_profile", initialProfile);
+        if (!initialProfile.empty())
+        {
+            std::string reason;
+            if (!applyPerformanceProfile(initialProfile, reason))
+            {
+                RCLCPP_ERROR_STREAM(this->get_logger(), "Could not apply the initial performance profile: " << reason);
+            }
+        }
+        diagnostics_timer_ = this->create_wall_timer(std::chrono::seconds(1), std::bind(&RgbdSlamNode::publishDiagnostics, this));
+        memory_timer_ = this->create_wall_timer(std::chrono::duration<double>(memoryCheckPeriod), [this]()
+                                                { interface->enforceMemoryBudget(); });
         RCLCPP_INFO(this->get_logger(), "CONSTRUCTOR END!");
     }
 
@@ -64,6 +505,13 @@ namespace ORB_SLAM3_Wrapper
         depth_sub.reset();
         imu_sub.reset();
         odom_sub.reset();
+        ground_truth_sub.reset();
+        if (trajectoryLogger_)
+        {
+            // the corrected trajectory is written before the logger is stopped, which waits for it.
+            exportTrajectory(trajectoryExportFile_);
+            trajectoryLogger_.reset();
+        }
         interface.reset();
         RCLCPP_INFO(this->get_logger(), "DESTRUCTOR!");
     }
@@ -71,43 +519,545 @@ namespace ORB_SLAM3_Wrapper
     void RgbdSlamNode::ImuCallback(const sensor_msgs::msg::Imu::SharedPtr msgIMU)
     {
         RCLCPP_DEBUG_STREAM(this->get_logger(), "ImuCallback");
+        if (stationaryGate_)
+        {
+            const auto &rate = msgIMU->angular_velocity;
+            stationaryGate_->addImu(conversions.stampToSec(msgIMU->header.stamp), std::sqrt(rate.x * rate.x + rate.y * rate.y + rate.z * rate.z));
+        }
         // push value to imu buffer.
         interface->handleIMU(msgIMU);
     }
 
+    void RgbdSlamNode::GroundTruthCallback(const nav_msgs::msg::Odometry::SharedPtr msgGroundTruth)
+    {
+        Eigen::Affine3d pose;
+        tf2::fromMsg(msgGroundTruth->pose.pose, pose);
+        trajectoryEvaluator_->addGroundTruth(conversions.stampToSec(msgGroundTruth->header.stamp), pose);
+    }
+
     void RgbdSlamNode::OdomCallback(const nav_msgs::msg::Odometry::SharedPtr msgOdom)
     {
         RCLCPP_DEBUG_STREAM(this->get_logger(), "OdomCallback");
+        if (motionPrior_)
+        {
+            Eigen::Affine3d pose;
+            tf2::fromMsg(msgOdom->pose.pose, pose);
+            motionPrior_->addOdometry(conversions.stampToSec(msgOdom->header.stamp), pose);
+        }
+        if (stationaryGate_)
+        {
+            const auto &twist = msgOdom->twist.twist;
+            stationaryGate_->addOdometry(conversions.stampToSec(msgOdom->header.stamp),
+                                         std::sqrt(twist.linear.x * twist.linear.x + twist.linear.y * twist.linear.y + twist.linear.z * twist.linear.z),
+                                         std::sqrt(twist.angular.x * twist.angular.x + twist.angular.y * twist.angular.y + twist.angular.z * twist.angular.z));
+        }
         interface->getMapToOdomTF(msgOdom, tfMapOdom);
     }
 
     void RgbdSlamNode::RGBDCallback(const sensor_msgs::msg::Image::SharedPtr msgRGB, const sensor_msgs::msg::Image::SharedPtr msgD)
     {
+        if (stationaryGate_ && !admitStationaryFrame(msgRGB))
+        {
+            return;
+        }
+        if (imageQualityFilter_ && !admitQualityFrame(msgRGB, msgD))
+        {
+            return;
+        }
+        // keep the tracking latency within the frame budget by tracking only every n-th frame.
+        if (adaptiveTrackingLoad_ && !trackingLoadController_->admitFrame())
+        {
+            return;
+        }
+        ScopedStage callbackStage(interface->getStageTimer(), "rgbd_callback");
         Sophus::SE3f Tcw;
-        if (interface->trackRGBDi(msgRGB, msgD, Tcw))
+        // a failed intermediate frame goes to ORB-SLAM3 right away, which also restarts the stride.
+        if (kltTracker_ && ++framesSinceFullTrack_ < kltFrameStride_ && interface->trackIntermediateFrame(msgRGB, Tcw))
         {
-            // publish the map data (current active keyframes etc)
-            publishMapData();
+            if (trajectoryLogger_)
+            {
+                logTrajectory(msgRGB, true);
+            }
             tf_broadcaster_->sendTransform(tfMapOdom);
+            return;
+        }
+        framesSinceFullTrack_ = 0;
+        // extractor changes of the load controller are applied between two frames.
+        ORB_SLAM3_Wrapper::OrbExtractorSettings orbExtractor;
+        if (orbExtractorControl_ && trackingLoadController_->takeExtractorChange(orbExtractor))
+        {
+            interface->setORBExtractor(orbExtractor);
+        }
+        unsigned long trackCount = interface->getStageTimer().get("track_rgbd").count;
+        bool tracked = interface->trackRGBDi(msgRGB, msgD, Tcw);
+        // without IMU data or a convertible image the frame returns before TrackRGBD, the statistics are still the last frame's.
+        ORB_SLAM3_Wrapper::StageStatistics trackStats = interface->getStageTimer().get("track_rgbd");
+        if (adaptiveTrackingLoad_ && trackStats.count != trackCount)
+        {
+            trackingLoadController_->update(trackStats.lastMs, interface->getTrackedInliers());
+        }
+        if (trajectoryLogger_)
+        {
+            logTrajectory(msgRGB, tracked);
+        }
+        if (tracked)
+        {
+            if (interface->getNewKeyFrameId() >= 0)
+            {
+                publishKeyFrameStream(msgRGB, msgD);
+                if (tsdfFusion_)
+                {
+                    tsdfFusion_->addKeyFrame(interface->getNewKeyFrameId(), interface->getLatestTrackedPose(), msgD);
+                }
+            }
+            if (tsdfFusion_ && isOutputDue(lastTsdfPoseUpdateTime_, tsdfPoseUpdateRate_))
+            {
+                interface->getKeyFramePoses(tsdfKeyFramePoses_);
+                interface->takeRemovedKeyFrames(tsdfRemovedKeyFrames_);
+                tsdfFusion_->updatePoses(tsdfKeyFramePoses_, tsdfRemovedKeyFrames_);
+            }
+            tf_broadcaster_->sendTransform(tfMapOdom);
+            // the outputs are only computed if somebody listens, and at most at their rate.
+            // publish the map data (current active keyframes etc)
+            if (isOutputNeeded("map_data", mapDataRate_, map_data_pub->get_subscription_count()))
+            {
+                ScopedStage outputStage(outputTimer_, "map_data");
+                publishMapData();
+            }
+            if (occupancyGrid_ && isOutputNeeded("occupancy_grid", occupancyGridRate_,
+                                                 occupancy_grid_pub->get_subscription_count() + occupancy_grid_updates_pub->get_subscription_count()))
+            {
+                ScopedStage outputStage(outputTimer_, "occupancy_grid");
+                if (outputGates_["occupancy_grid"].resumed())
+                {
+                    // updates were not published while nobody listened.
+                    occupancyGridBuilder_->requestFullMap();
+                }
+                publishOccupancyGrid();
+            }
             if (rosViz_)
             {
-                publishMapPointCloud();
+                if (isOutputNeeded("map_points", mapPointsRate_,
+                                   map_points_pub->get_subscription_count() + keyframe_poses_pub->get_subscription_count()))
+                {
+                    ScopedStage outputStage(outputTimer_, "map_points");
+                    publishMapPointCloud();
+                }
+                // unlike the other outputs, a rate of 0 turns the markers off.
+                if (rosVizRate_ > 0.0 && isOutputNeeded("keyframe_markers", rosVizRate_, keyframe_markers_pub->get_subscription_count()))
+                {
+                    ScopedStage outputStage(outputTimer_, "keyframe_markers");
+                    publishKeyFrameMarkers();
+                }
             }
         }
     }
 
+    bool RgbdSlamNode::admitStationaryFrame(const sensor_msgs::msg::Image::SharedPtr msgRGB)
+    {
+        // only a tracked robot has a pose to keep.
+        if (interface->getTrackingState() != 2)
+        {
+            stationaryGate_->reset();
+        }
+        cv_bridge::CvImageConstPtr cvRGB;
+        try
+        {
+            cvRGB = cv_bridge::toCvShare(msgRGB);
+        }
+        catch (cv_bridge::Exception &e)
+        {
+            RCLCPP_ERROR(this->get_logger(), "cv_bridge exception: %s", e.what());
+            return true;
+        }
+        if (stationaryGate_->admitFrame(conversions.stampToSec(msgRGB->header.stamp), cvRGB->image))
+        {
+            return true;
+        }
+        // the robot did not move, so the last pose is still valid for this frame.
+        tf_broadcaster_->sendTransform(tfMapOdom);
+        if (trajectoryLogger_)
+        {
+            logTrajectory(msgRGB, true);
+        }
+        return false;
+    }
+
+    bool RgbdSlamNode::admitQualityFrame(const sensor_msgs::msg::Image::SharedPtr msgRGB, const sensor_msgs::msg::Image::SharedPtr msgD)
+    {
+        ScopedStage qualityStage(interface->getStageTimer(), "image_quality");
+        cv_bridge::CvImageConstPtr cvRGB;
+        cv_bridge::CvImageConstPtr cvD;
+        try
+        {
+            cvRGB = cv_bridge::toCvShare(msgRGB);
+            cvD = cv_bridge::toCvShare(msgD);
+        }
+        catch (cv_bridge::Exception &e)
+        {
+            RCLCPP_ERROR(this->get_logger(), "cv_bridge exception: %s", e.what());
+            return true;
+        }
+        return imageQualityFilter_->admitFrame(cvRGB->image, cvD->image);
+    }
+
+    void RgbdSlamNode::publishOccupancyGrid()
+    {
+        // nothing moved since the last update, e.g. in localization mode.
+        if (occupancyGridVersion_ == interface->getReferencePosesVersion())
+        {
+            return;
+        }
+        occupancyGridVersion_ = interface->getReferencePosesVersion();
+        interface->getKeyFramePoses(occupancyKeyFramePoses_);
+        occupancyGridBuilder_->findChanged(occupancyKeyFramePoses_, occupancyChangedKeyFrames_);
+        interface->getKeyFrameLandmarks(occupancyChangedKeyFrames_, occupancyLandmarks_);
+        occupancyGridBuilder_->integrate(occupancyLandmarks_);
+
+        auto stamp = this->now();
+        if (occupancyGridBuilder_->needsFullMap())
+        {
+            occupancyGridMsg_.header.stamp = stamp;
+            occupancyGridMsg_.header.frame_id = global_frame_;
+            occupancyGridMsg_.info.map_load_time = stamp;
+            occupancyGridBuilder_->toMsg(occupancyGridMsg_);
+            occupancy_grid_pub->publish(occupancyGridMsg_);
+        }
+        else if (occupancyGridBuilder_->hasDirtyRegion())
+        {
+            occupancyGridUpdateMsg_.header.stamp = stamp;
+            occupancyGridUpdateMsg_.header.frame_id = global_frame_;
+            occupancyGridBuilder_->dirtyRegionToMsg(occupancyGridUpdateMsg_);
+            occupancy_grid_updates_pub->publish(occupancyGridUpdateMsg_);
+        }
+    }
+
+    void RgbdSlamNode::logTrajectory(const sensor_msgs::msg::Image::SharedPtr msgRGB, bool tracked)
+    {
+        ORB_SLAM3_Wrapper::TrajectoryRecord record;
+        record.stamp = conversions.stampToSec(msgRGB->header.stamp);
+        record.trackingState = interface->getTrackingState();
+        record.pose = interface->getLatestTrackedPose();
+        record.anchorRelative.setIdentity();
+        long unsigned int anchorId;
+        Eigen::Affine3d anchorPose;
+        if (tracked && interface->getTrajectoryAnchor(anchorId, anchorPose))
+        {
+            record.anchorId = static_cast<long>(anchorId);
+            record.anchorRelative = anchorPose.inverse() * record.pose;
+        }
+        trajectoryLogger_->log(record);
+    }
+
+    bool RgbdSlamNode::exportTrajectory(const std::string &path)
+    {
+        if (!trajectoryLogger_)
+        {
+            return false;
+        }
+        auto anchorPoses = std::make_shared<ORB_SLAM3_Wrapper::KeyFramePoses>();
+        interface->getAnchorPoses(*anchorPoses);
+        trajectoryLogger_->exportCorrected(path, anchorPoses);
+        return true;
+    }
+
+    void RgbdSlamNode::publishKeyFrameStream(const sensor_msgs::msg::Image::SharedPtr msgRGB, const sensor_msgs::msg::Image::SharedPtr msgD)
+    {
+        if (keyframe_rgb_pub->get_subscription_count() == 0 && keyframe_depth_pub->get_subscription_count() == 0 &&
+            keyframe_pose_pub->get_subscription_count() == 0)
+        {
+            return;
+        }
+        slam_msgs::msg::KeyFramePose keyFramePose;
+        keyFramePose.header.stamp = msgRGB->header.stamp;
+        keyFramePose.header.frame_id = global_frame_;
+        keyFramePose.depth_stamp = msgD->header.stamp;
+        keyFramePose.id = interface->getNewKeyFrameId();
+        keyFramePose.pose = tf2::toMsg(interface->getLatestTrackedPose());
+        keyframe_rgb_pub->publish(std::make_unique<ORB_SLAM3_Wrapper::SharedImage>(ORB_SLAM3_Wrapper::SharedImage{msgRGB}));
+        keyframe_depth_pub->publish(std::make_unique<ORB_SLAM3_Wrapper::SharedImage>(ORB_SLAM3_Wrapper::SharedImage{msgD}));
+        keyframe_pose_pub->publish(keyFramePose);
+    }
+
     void RgbdSlamNode::publishMapPointCloud()
     {
-        sensor_msgs::msg::PointCloud2 mapPCL;
-        interface->getCurrentMapPoints(mapPCL);
-        map_points_pub->publish(mapPCL);
+        // the map does not change while mapping is off, so republish the last export.
+        mapOutputCache_.update(interface->getReferencePosesVersion(),
+                               [this](std::vector<Eigen::Vector3f> &points, ORB_SLAM3_Wrapper::KeyFramePoses &keyFramePoses)
+                               {
+                                   interface->getCurrentMapPoints(points);
+                                   interface->getKeyFramePoses(keyFramePoses);
+                               });
+        mapOutputCache_.publish(this->now(), global_frame_, *map_points_pub, *keyframe_poses_pub);
+    }
+
+    void RgbdSlamNode::refreshMapDataCache()
+    {
+        if (mapDataCacheVersion_ != interface->getReferencePosesVersion())
+        {
+            // refilled in place, the buffers only grow when the map outgrows the last snapshot.
+            interface->mapDataToMsg(mapDataCache_, true, false);
+            mapDataCacheVersion_ = interface->getReferencePosesVersion();
+        }
     }
 
     void RgbdSlamNode::publishMapData()
     {
-        slam_msgs::msg::MapData mapDataMsg;
-        interface->mapDataToMsg(mapDataMsg, true, false);
-        map_data_pub->publish(mapDataMsg);
+        refreshMapDataCache();
+        map_data_pub->publish(mapDataCache_);
+    }
+
+    void RgbdSlamNode::publishKeyFrameMarkers()
+    {
+        // the map data is not refreshed while nobody subscribes to it.
+        refreshMapDataCache();
+        // use the graph of the last map data so that both outputs show the same snapshot.
+        covisibilityEdges_.clear();
+        interface->getCovisibilityGraph(mapDataCache_.graph, covisibilityEdges_, covisibilityMinWeight_);
+        mapVisualizer_->buildMarkers(mapDataCache_.graph, covisibilityEdges_, interface->getLatestTrackedPose(), this->now(), markers_);
+        keyframe_markers_pub->publish(markers_);
+    }
+
+    bool RgbdSlamNode::isOutputDue(rclcpp::Time &lastPublished, double rate)
+    {
+        auto now = this->now();
+        if (rate > 0.0 && (now - lastPublished).seconds() < 1.0 / rate)
+        {
+            return false;
+        }
+        lastPublished = now;
+        return true;
+    }
+
+    bool RgbdSlamNode::isOutputNeeded(const std::string &output, double rate, size_t subscribers)
+    {
+        return outputGates_[output].admit(this->now().seconds(), rate, subscribers);
+    }
+
+    void RgbdSlamNode::publishTrajectoryError()
+    {
+        ORB_SLAM3_Wrapper::TrajectoryErrorStatistics errorStats = trajectoryEvaluator_->getStatistics();
+        slam_msgs::msg::TrajectoryError error;
+        error.header.stamp = this->now();
+        error.header.frame_id = global_frame_;
+        error.pairs = errorStats.pairs;
+        error.unmatched = errorStats.unmatched;
+        error.ate_rmse = errorStats.ateRmse;
+        error.ate_last = errorStats.ateLast;
+        error.rpe_delta = trajectoryEvaluator_->getRpeDelta();
+        error.rpe_pairs = errorStats.rpePairs;
+        error.rpe_translation_rmse = errorStats.rpeTranslationRmse;
+        error.rpe_rotation_rmse = errorStats.rpeRotationRmse;
+        error.alignment = tf2::toMsg(errorStats.alignment);
+        trajectory_error_pub->publish(error);
+    }
+
+    void RgbdSlamNode::publishDiagnostics()
+    {
+        diagnostic_msgs::msg::DiagnosticArray diagnostics;
+        diagnostics.header.stamp = this->now();
+
+        diagnostic_msgs::msg::DiagnosticStatus trackingStatus;
+        trackingStatus.name = std::string(this->get_name()) + ": tracking";
+        trackingStatus.hardware_id = "orb_slam3";
+        trackingStatus.level = diagnostic_msgs::msg::DiagnosticStatus::OK;
+        trackingStatus.message = interface->isLocalizationMode() ? "localization" : "mapping";
+        auto addValue = [](diagnostic_msgs::msg::DiagnosticStatus &status, const std::string &key, const std::string &value)
+        {
+            diagnostic_msgs::msg::KeyValue keyValue;
+            keyValue.key = key;
+            keyValue.value = value;
+            status.values.push_back(keyValue);
+        };
+        auto stages = interface->getStageTimer().snapshot();
+        bool allocationTracking = ORB_SLAM3_Wrapper::AllocationCounter::isEnabled();
+        for (const auto &stage : stages)
+        {
+            addValue(trackingStatus, stage.first + " avg [ms]", std::to_string(stage.second.averageMs()));
+            addValue(trackingStatus, stage.first + " max [ms]", std::to_string(stage.second.maxMs));
+            if (allocationTracking)
+            {
+                addValue(trackingStatus, stage.first + " last allocations", std::to_string(stage.second.lastAllocations));
+            }
+        }
+        if (allocationTracking)
+        {
+            // per frame over the last period, so the startup of the map does not hide a regression.
+            const ORB_SLAM3_Wrapper::StageStatistics &callback = stages["rgbd_callback"];
+            unsigned long frames = callback.count > lastCallbackStatistics_.count ? callback.count - lastCallbackStatistics_.count : 0;
+            if (frames > 0)
+            {
+                unsigned long long allocations = (callback.totalAllocations - lastCallbackStatistics_.totalAllocations) / frames;
+                unsigned long long bytes = (callback.totalAllocatedBytes - lastCallbackStatistics_.totalAllocatedBytes) / frames;
+                addValue(trackingStatus, "allocations per frame", std::to_string(allocations));
+                addValue(trackingStatus, "allocated KB per frame", std::to_string(bytes / 1024));
+                if (allocationBudget_ > 0 && allocations > allocationBudget_)
+                {
+                    trackingStatus.level = diagnostic_msgs::msg::DiagnosticStatus::WARN;
+                    trackingStatus.message += ", " + std::to_string(allocations) + " allocations per frame (budget " + std::to_string(allocationBudget_) + ")";
+                }
+            }
+            lastCallbackStatistics_ = callback;
+        }
+        ORB_SLAM3_Wrapper::PosePriorStatistics priorStats = interface->getPosePriorStatistics();
+        addValue(trackingStatus, "relocalizations", std::to_string(priorStats.relocalizations));
+        addValue(trackingStatus, "new maps after loss", std::to_string(priorStats.newMaps));
+        addValue(trackingStatus, "maps placed at pose prior", std::to_string(priorStats.seededMaps));
+        addValue(trackingStatus, "keyframes outside pose prior", std::to_string(priorStats.maskedKeyFrames));
+        unsigned long recoveries = priorStats.relocalizations + priorStats.newMaps;
+        if (recoveries > 0)
+        {
+            addValue(trackingStatus, "recovery avg [ms]", std::to_string(priorStats.totalRecoveryMs / recoveries));
+        }
+        if (motionPrior_)
+        {
+            ORB_SLAM3_Wrapper::MotionPriorStatistics motionStats = motionPrior_->getStatistics();
+            addValue(trackingStatus, "motion prior frames without odometry", std::to_string(motionStats.missingOdometry));
+            // the same outcomes of the tracker for the frames started from the odometry and from the constant velocity.
+            auto addOutcomes = [&](const std::string &prefix, const ORB_SLAM3_Wrapper::MotionModelOutcomes &outcomes)
+            {
+                addValue(trackingStatus, prefix + " frames", std::to_string(outcomes.frames));
+                addValue(trackingStatus, prefix + " motion model tracked", std::to_string(outcomes.tracked));
+                addValue(trackingStatus, prefix + " wide searches", std::to_string(outcomes.wideSearches));
+                addValue(trackingStatus, prefix + " reference keyframe fallbacks", std::to_string(outcomes.referenceKeyFrameFallbacks));
+                addValue(trackingStatus, prefix + " lost frames", std::to_string(outcomes.lostFrames));
+            };
+            addOutcomes("odometry prior", motionStats.withPrior);
+            addOutcomes("constant velocity", motionStats.withoutPrior);
+        }
+        addValue(trackingStatus, "performance profile", activeProfile_);
+        addValue(trackingStatus, "tracked inliers", std::to_string(interface->getTrackedInliers()));
+        addValue(trackingStatus, "frame stride", std::to_string(trackingLoadController_->getStride()));
+        if (orbExtractorControl_)
+        {
+            ORB_SLAM3_Wrapper::OrbExtractorSettings orbExtractor = trackingLoadController_->getExtractor();
+            ORB_SLAM3_Wrapper::OrbExtractorSettings orbExtractorLimit = getOrbExtractorLimit();
+            addValue(trackingStatus, "orb features", std::to_string(orbExtractor.nFeatures) + " of " + std::to_string(orbExtractorLimit.nFeatures));
+            addValue(trackingStatus, "orb levels", std::to_string(orbExtractor.nLevels) + " of " + std::to_string(orbExtractorLimit.nLevels));
+        }
+        if (kltTracker_)
+        {
+            ORB_SLAM3_Wrapper::KltTrackerStatistics kltStats = kltTracker_->getStatistics();
+            addValue(trackingStatus, "intermediate frames", std::to_string(kltStats.frames - kltStats.failed));
+            addValue(trackingStatus, "intermediate frames failed", std::to_string(kltStats.failed));
+            addValue(trackingStatus, "intermediate frame inliers", std::to_string(kltStats.lastInliers) + " of " + std::to_string(kltStats.lastPoints));
+        }
+        if (imageQualityFilter_)
+        {
+            ORB_SLAM3_Wrapper::ImageQualityStatistics qualityStats = imageQualityFilter_->getStatistics();
+            addValue(trackingStatus, "low quality skipped frames", std::to_string(qualityStats.skipped));
+            addValue(trackingStatus, "blurred frames", std::to_string(qualityStats.blurred));
+            addValue(trackingStatus, "badly exposed frames", std::to_string(qualityStats.badExposure));
+            addValue(trackingStatus, "textureless frames", std::to_string(qualityStats.textureless));
+            addValue(trackingStatus, "frames without depth", std::to_string(qualityStats.badDepth));
+            addValue(trackingStatus, "last sharpness", std::to_string(qualityStats.last.sharpness));
+        }
+        if (stationaryGate_)
+        {
+            addValue(trackingStatus, "stationary", stationaryGate_->isStationary() ? "true" : "false");
+            addValue(trackingStatus, "stationary skipped frames", std::to_string(stationaryGate_->getSkippedFrames()));
+        }
+        addValue(trackingStatus, "skipped frames", std::to_string(trackingLoadController_->getSkippedFrames()));
+        unsigned long droppedEvents = 0;
+        for (const auto &subscription : interface->getSubscriptionStatistics())
+        {
+            droppedEvents += subscription.second.dropped;
+        }
+        addValue(trackingStatus, "dropped in-process events", std::to_string(droppedEvents));
+        if (trajectoryLogger_)
+        {
+            ORB_SLAM3_Wrapper::TrajectoryLoggerStatistics trajectoryStats = trajectoryLogger_->getStatistics();
+            addValue(trackingStatus, "trajectory records", std::to_string(trajectoryStats.records));
+            addValue(trackingStatus, "trajectory records pending", std::to_string(trajectoryStats.pending));
+            if (trajectoryStats.failed)
+            {
+                trackingStatus.level = diagnostic_msgs::msg::DiagnosticStatus::WARN;
+                trackingStatus.message += ", trajectory log failed";
+            }
+        }
+        if (inputRecorder_)
+        {
+            ORB_SLAM3_Wrapper::InputRecorderStatistics recorderStats = inputRecorder_->getStatistics();
+            addValue(trackingStatus, "recorded frames", std::to_string(recorderStats.frames));
+            addValue(trackingStatus, "recorded frames dropped", std::to_string(recorderStats.dropped));
+            addValue(trackingStatus, "recording size [MB]", std::to_string(recorderStats.bytes / (1024 * 1024)));
+            if (recorderStats.failed)
+            {
+                trackingStatus.level = diagnostic_msgs::msg::DiagnosticStatus::WARN;
+                trackingStatus.message += ", input recording failed";
+            }
+        }
+        if (trackingLoadController_->getStride() > 1)
+        {
+            trackingStatus.level = diagnostic_msgs::msg::DiagnosticStatus::WARN;
+            trackingStatus.message += ", tracking reduced to every " + std::to_string(trackingLoadController_->getStride()) + " frames";
+        }
+        diagnostics.status.push_back(trackingStatus);
+
+        auto memoryUsage = interface->getMemoryUsage();
+        auto retentionStats = interface->getRetentionStatistics();
+        diagnostic_msgs::msg::DiagnosticStatus memoryStatus;
+        memoryStatus.name = std::string(this->get_name()) + ": memory";
+        memoryStatus.hardware_id = "orb_slam3";
+        memoryStatus.level = diagnostic_msgs::msg::DiagnosticStatus::OK;
+        memoryStatus.message = std::to_string(memoryUsage.totalBytes() / (1024 * 1024)) + " MB live in " + std::to_string(memoryUsage.maps) + " maps";
+        addValue(memoryStatus, "maps", std::to_string(memoryUsage.maps));
+        addValue(memoryStatus, "keyframes", std::to_string(memoryUsage.keyFrames));
+        addValue(memoryStatus, "map points", std::to_string(memoryUsage.mapPoints));
+        addValue(memoryStatus, "keyframes [MB]", std::to_string(memoryUsage.keyFrameBytes / (1024.0 * 1024.0)));
+        addValue(memoryStatus, "map points [MB]", std::to_string(memoryUsage.mapPointBytes / (1024.0 * 1024.0)));
+        addValue(memoryStatus, "evicted keyframes", std::to_string(retentionStats.evictedKeyFrames));
+        addValue(memoryStatus, "evicted map points", std::to_string(retentionStats.evictedMapPoints));
+        // ORB-SLAM3 keeps bad keyframes and map points allocated, the eviction only shrinks the live map.
+        addValue(memoryStatus, "evicted, still allocated [MB]", std::to_string(retentionStats.evictedBytes / (1024.0 * 1024.0)));
+        if (tsdfFusion_)
+        {
+            auto tsdfStats = tsdfFusion_->getStatistics();
+            addValue(memoryStatus, "tsdf blocks", std::to_string(tsdfStats.blocks));
+            addValue(memoryStatus, "tsdf keyframes", std::to_string(tsdfStats.keyFrames));
+            addValue(memoryStatus, "tsdf pending jobs", std::to_string(tsdfStats.pendingJobs));
+            addValue(memoryStatus, "tsdf reintegrated keyframes", std::to_string(tsdfStats.reintegratedKeyFrames));
+            addValue(memoryStatus, "tsdf removed keyframes", std::to_string(tsdfStats.removedKeyFrames));
+            addValue(memoryStatus, "tsdf frozen keyframes", std::to_string(tsdfStats.frozenKeyFrames));
+            addValue(memoryStatus, "tsdf integration [ms]", std::to_string(tsdfStats.lastIntegrationMs));
+        }
+        if (keyFrameImageCache_->isEnabled())
+        {
+            auto imageStats = keyFrameImageCache_->getStatistics();
+            addValue(memoryStatus, "keyframe images", std::to_string(imageStats.entries));
+            addValue(memoryStatus, "keyframe images on disk", std::to_string(imageStats.spilledEntries));
+            addValue(memoryStatus, "keyframe images pending", std::to_string(imageStats.pending));
+            addValue(memoryStatus, "keyframe images dropped", std::to_string(imageStats.dropped));
+            addValue(memoryStatus, "keyframe images [MB]", std::to_string(imageStats.bytes / (1024.0 * 1024.0)));
+            if (imageStats.insertedBytes > 0)
+            {
+                addValue(memoryStatus, "keyframe image compression", std::to_string(static_cast<double>(imageStats.insertedRawBytes) / imageStats.insertedBytes));
+            }
+        }
+        diagnostics.status.push_back(memoryStatus);
+
+        diagnostic_msgs::msg::DiagnosticStatus outputStatus;
+        outputStatus.name = std::string(this->get_name()) + ": outputs";
+        outputStatus.hardware_id = "orb_slam3";
+        outputStatus.level = diagnostic_msgs::msg::DiagnosticStatus::OK;
+        double savedMs = 0.0;
+        for (auto &gate : outputGates_)
+        {
+            OutputGateStatistics gateStats = gate.second.getStatistics();
+            // skipped runs are estimated at the average cost of the computed ones.
+            double averageMs = outputTimer_.get(gate.first).averageMs();
+            double outputSavedMs = (gateStats.idleSkips + gateStats.rateSkips) * averageMs;
+            savedMs += outputSavedMs;
+            addValue(outputStatus, gate.first + " runs", std::to_string(gateStats.runs));
+            addValue(outputStatus, gate.first + " skipped (no subscribers)", std::to_string(gateStats.idleSkips));
+            addValue(outputStatus, gate.first + " skipped (rate)", std::to_string(gateStats.rateSkips));
+            addValue(outputStatus, gate.first + " avg [ms]", std::to_string(averageMs));
+            addValue(outputStatus, gate.first + " saved [ms]", std::to_string(outputSavedMs));
+        }
+        outputStatus.message = "saved " + std::to_string(static_cast<long>(savedMs)) + " ms";
+        diagnostics.status.push_back(outputStatus);
+
+        diagnostics_pub->publish(diagnostics);
     }
 
     void RgbdSlamNode::getMapServer(std::shared_ptr<rmw_request_id_t> request_header,
@@ -115,8 +1065,255 @@ namespace ORB_SLAM3_Wrapper
                                     std::shared_ptr<slam_msgs::srv::GetMap::Response> response)
     {
         RCLCPP_INFO(this->get_logger(), "GetMap2 service called.");
-        slam_msgs::msg::MapData mapDataMsg;
-        interface->mapDataToMsg(mapDataMsg, false, request->tracked_points, request->kf_id_for_landmarks);
-        response->data = mapDataMsg;
+        interface->mapDataToMsg(response->data, false, request->tracked_points, request->kf_id_for_landmarks);
+    }
+
+    void RgbdSlamNode::keyFrameImagesServer(std::shared_ptr<rmw_request_id_t> request_header,
+                                            std::shared_ptr<slam_msgs::srv::GetKeyFrameImages::Request> request,
+                                            std::shared_ptr<slam_msgs::srv::GetKeyFrameImages::Response> response)
+    {
+        ORB_SLAM3_Wrapper::KeyFrameImages images;
+        response->success = request->kf_id >= 0 && keyFrameImageCache_->get(request->kf_id, images);
+        if (!response->success)
+        {
+            RCLCPP_WARN_STREAM(this->get_logger(), "Images of keyframe " << request->kf_id << " are not cached.");
+            return;
+        }
+        std_msgs::msg::Header header;
+        header.stamp = rclcpp::Time(static_cast<int64_t>(images.stamp * 1e9));
+        cv_bridge::CvImage(header, images.rgbEncoding, images.rgb).toImageMsg(response->rgb);
+        cv_bridge::CvImage(header, images.depthEncoding, images.depth).toImageMsg(response->depth);
+    }
+
+    void RgbdSlamNode::denseCloudServer(std::shared_ptr<rmw_request_id_t> request_header,
+                                        std::shared_ptr<slam_msgs::srv::GetDenseCloud::Request> request,
+                                        std::shared_ptr<slam_msgs::srv::GetDenseCloud::Response> response)
+    {
+        response->success = static_cast<bool>(tsdfFusion_);
+        if (!tsdfFusion_)
+        {
+            RCLCPP_WARN(this->get_logger(), "TSDF fusion is disabled.");
+            return;
+        }
+        std::vector<Eigen::Vector3f> surfacePoints;
+        tsdfFusion_->extractSurfacePoints(surfacePoints, request->min_weight);
+        ORB_SLAM3_Wrapper::WrapperTypeConversions typeConversions;
+        typeConversions.MapPointsToPCL(surfacePoints, response->cloud);
+        response->cloud.header.frame_id = global_frame_;
+        response->cloud.header.stamp = this->now();
+    }
+
+    void RgbdSlamNode::exportTrajectoryServer(std::shared_ptr<rmw_request_id_t> request_header,
+                                              std::shared_ptr<slam_msgs::srv::ExportTrajectory::Request> request,
+                                              std::shared_ptr<slam_msgs::srv::ExportTrajectory::Response> response)
+    {
+        std::string path = request->path.empty() ? trajectoryExportFile_ : request->path;
+        response->success = exportTrajectory(path);
+        // written by the logger thread, so the call returns before the file is complete.
+        response->message = response->success ? "Exporting the corrected trajectory to " + path : "Trajectory logging is disabled.";
+    }
+
+    void RgbdSlamNode::startProfilingServer(std::shared_ptr<rmw_request_id_t> request_header,
+                                            std::shared_ptr<slam_msgs::srv::StartProfiling::Request> request,
+                                            std::shared_ptr<slam_msgs::srv::StartProfiling::Response> response)
+    {
+        std::string path = request->path;
+        if (path.empty())
+        {
+            path = profilerDirectory_ + "/orb_slam3_profile_" + std::to_string(static_cast<long>(this->now().seconds())) + ".folded";
+        }
+        int frequency = request->frequency > 0 ? request->frequency : 199;
+        // the profile is written by the profiler thread, so the call returns before the file exists.
+        response->success = samplingProfiler_->start(request->duration, frequency, path, response->message);
+        RCLCPP_INFO_STREAM(this->get_logger(), "Profiling service called: " << response->message);
+    }
+
+    void RgbdSlamNode::setInitialPoseServer(std::shared_ptr<rmw_request_id_t> request_header,
+                                            std::shared_ptr<slam_msgs::srv::SetInitialPose::Request> request,
+                                            std::shared_ptr<slam_msgs::srv::SetInitialPose::Response> response)
+    {
+        Eigen::Affine3d pose;
+        tf2::fromMsg(request->pose, pose);
+        double radius = request->radius > 0.0 ? request->radius : initialPoseRadius_;
+        // the prior is kept until the next relocalization or new map used it.
+        interface->setPosePrior(pose, radius);
+        response->success = true;
+        response->message = "Pose prior set with a radius of " + std::to_string(radius) + " m.";
+        RCLCPP_INFO_STREAM(this->get_logger(), "Initial pose service called: " << response->message);
+    }
+
+    void RgbdSlamNode::localizationModeServer(std::shared_ptr<rmw_request_id_t> request_header,
+                                              std::shared_ptr<std_srvs::srv::SetBool::Request> request,
+                                              std::shared_ptr<std_srvs::srv::SetBool::Response> response)
+    {
+        RCLCPP_INFO(this->get_logger(), "Localization mode service called.");
+        // go through the parameter so that the parameter and the mode never disagree.
+        auto result = this->set_parameter(rclcpp::Parameter("localization_mode", request->data));
+        response->success = result.successful;
+        response->message = request->data ? "Mapping disabled, tracking in localization mode." : "Mapping enabled.";
+        if (!result.successful)
+        {
+            response->message = result.reason;
+        }
+    }
+
+    void RgbdSlamNode::performanceProfileServer(std::shared_ptr<rmw_request_id_t> request_header,
+                                                std::shared_ptr<slam_msgs::srv::SetPerformanceProfile::Request> request,
+                                                std::shared_ptr<slam_msgs::srv::SetPerformanceProfile::Response> response)
+    {
+        RCLCPP_INFO_STREAM(this->get_logger(), "Performance profile service called with profile " << request->profile << ".");
+        std::string reason;
+        response->success = applyPerformanceProfile(request->profile, reason);
+        response->message = response->success ? "Switched to profile " + request->profile + "." : reason;
+    }
+
+    ORB_SLAM3_Wrapper::OrbExtractorSettings RgbdSlamNode::getOrbExtractorLimit()
+    {
+        ORB_SLAM3_Wrapper::OrbExtractorSettings orbExtractor = orbExtractor_;
+        if (orbFeatures_ > 0)
+        {
+            orbExtractor.nFeatures = orbFeatures_;
+        }
+        if (orbLevels_ > 0)
+        {
+            orbExtractor.nLevels = orbLevels_;
+        }
+        return orbExtractor;
+    }
+
+    bool RgbdSlamNode::applyPerformanceProfile(const std::string &name, std::string &reason)
+    {
+        auto profile = performanceProfiles_.find(name);
+        if (profile == performanceProfiles_.end())
+        {
+            reason = "Unknown performance profile " + name + ".";
+            return false;
+        }
+        // all parameters are set atomically, the atlas and the tracking state are untouched.
+        auto result = this->set_parameters_atomically(profile->second.toParameters());
+        if (!result.successful)
+        {
+            reason = result.reason;
+            return false;
+        }
+        activeProfile_ = name;
+        RCLCPP_INFO_STREAM(this->get_logger(), "Performance profile " << name << " is active.");
+        return true;
+    }
+
+    rcl_interfaces::msg::SetParametersResult RgbdSlamNode::onParameterChange(const std::vector<rclcpp::Parameter> &parameters)
+    {
+        rcl_interfaces::msg::SetParametersResult result;
+        result.successful = true;
+        // validate everything first, set_parameters_atomically expects all or nothing.
+        for (const auto &parameter : parameters)
+        {
+            const auto &name = parameter.get_name();
+            if ((name == "max_frame_stride" || name == "min_orb_features" || name == "min_orb_levels") && parameter.as_int() < 1)
+            {
+                result.successful = false;
+                result.reason = name + " has to be at least 1.";
+                return result;
+            }
+            if ((name == "ros_visualization_rate" || name == "map_data_rate" || name == "map_points_rate") && parameter.as_double() < 0.0)
+            {
+                result.successful = false;
+                result.reason = name + " can not be negative.";
+                return result;
+            }
+            if ((name == "orb_features" || name == "orb_levels") && parameter.as_int() < 0)
+            {
+                result.successful = false;
+                result.reason = name + " can not be negative.";
+                return result;
+            }
+        }
+        bool trackingLoadChanged = false;
+        for (const auto &parameter : parameters)
+        {
+            const auto &name = parameter.get_name();
+            if (name == "localization_mode")
+            {
+                bool localizationMode = parameter.as_bool();
+                RCLCPP_INFO_STREAM(this->get_logger(), "Switching to " << (localizationMode ? "localization" : "mapping") << " mode.");
+                interface->setLocalizationMode(localizationMode);
+            }
+            else if (name == "ros_visualization")
+            {
+                rosViz_ = parameter.as_bool();
+                // markers sent before turning the output off might be stale, send everything again.
+                mapVisualizer_->reset();
+            }
+            else if (name == "ros_visualization_rate")
+            {
+                rosVizRate_ = parameter.as_double();
+            }
+            else if (name == "map_data_rate")
+            {
+                mapDataRate_ = parameter.as_double();
+            }
+            else if (name == "map_points_rate")
+            {
+                mapPointsRate_ = parameter.as_double();
+            }
+            else if (name == "adaptive_tracking_load")
+            {
+                adaptiveTrackingLoad_ = parameter.as_bool();
+                if (!adaptiveTrackingLoad_)
+                {
+                    // the full extractor is restored with the next frame.
+                    trackingLoadController_->reset();
+                }
+            }
+            else if (name == "max_frame_stride")
+            {
+                maxFrameStride_ = parameter.as_int();
+                trackingLoadChanged = true;
+            }
+            else if (name == "min_tracked_inliers")
+            {
+                minTrackedInliers_ = parameter.as_int();
+                trackingLoadChanged = true;
+            }
+            else if (name == "tracking_latency_budget_ms" && parameter.as_double() > 0.0)
+            {
+                trackingLatencyBudgetMs_ = parameter.as_double();
+                trackingLoadChanged = true;
+            }
+            else if (name == "orb_features")
+            {
+                orbFeatures_ = parameter.as_int();
+                trackingLoadChanged = true;
+            }
+            else if (name == "orb_levels")
+            {
+                orbLevels_ = parameter.as_int();
+                trackingLoadChanged = true;
+            }
+            else if (name == "min_orb_features")
+            {
+                minOrbFeatures_ = parameter.as_int();
+                trackingLoadChanged = true;
+            }
+            else if (name == "min_orb_levels")
+            {
+                minOrbLevels_ = parameter.as_int();
+                trackingLoadChanged = true;
+            }
+        }
+        if (trackingLoadChanged)
+        {
+            trackingLoadController_->setBounds(trackingLatencyBudgetMs_, minTrackedInliers_, maxFrameStride_);
+            if (orbExtractorControl_)
+            {
+                trackingLoadController_->setExtractorBounds(getOrbExtractorLimit(), minOrbFeatures_, minOrbLevels_);
+            }
+            if (!adaptiveTrackingLoad_)
+            {
+                // without the control the extractor follows its upper bounds.
+                trackingLoadController_->reset();
+            }
+        }
+        return result;
     }
 }
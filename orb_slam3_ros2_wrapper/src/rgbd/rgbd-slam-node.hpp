@@ -20,6 +20,10 @@
 #include "geometry_msgs/msg/pose.hpp"
 #include "geometry_msgs/msg/pose_stamped.hpp"
 #include <geometry_msgs/msg/pose_array.hpp>
+#include <visualization_msgs/msg/marker_array.hpp>
+#include <nav_msgs/msg/occupancy_grid.hpp>
+#include <map_msgs/msg/occupancy_grid_update.hpp>
+#include <diagnostic_msgs/msg/diagnostic_array.hpp>
 #include "geometry_msgs/msg/transform_stamped.hpp"
 
 #include "tf2_ros/transform_broadcaster.h"
@@ -30,10 +34,35 @@
 #include "message_filters/sync_policies/approximate_time.h"
 
 #include <slam_msgs/msg/map_data.hpp>
+#include <slam_msgs/msg/key_frame_pose.hpp>
+#include <slam_msgs/msg/trajectory_error.hpp>
 #include <slam_msgs/srv/get_map.hpp>
+#include <slam_msgs/srv/set_performance_profile.hpp>
+#include <slam_msgs/srv/get_key_frame_images.hpp>
+#include <slam_msgs/srv/get_dense_cloud.hpp>
+#include <slam_msgs/srv/export_trajectory.hpp>
+#include <slam_msgs/srv/start_profiling.hpp>
+#include <slam_msgs/srv/set_initial_pose.hpp>
+#include <std_srvs/srv/set_bool.hpp>
 
 #include "type_conversion.hpp"
 #include "orb_slam3_interface.hpp"
+#include "map_visualizer.hpp"
+#include "tracking_load_controller.hpp"
+#include "performance_profile.hpp"
+#include "keyframe_image_cache.hpp"
+#include "occupancy_grid_builder.hpp"
+#include "tsdf_fusion.hpp"
+#include "map_type_adapters.hpp"
+#include "map_output_cache.hpp"
+#include "output_gate.hpp"
+#include "trajectory_logger.hpp"
+#include "trajectory_evaluator.hpp"
+#include "sampling_profiler.hpp"
+#include "stage_timer.hpp"
+#include "allocation_counter.hpp"
+#include "stationary_gate.hpp"
+#include "image_quality_filter.hpp"
 
 namespace ORB_SLAM3_Wrapper
 {
@@ -42,7 +71,8 @@ namespace ORB_SLAM3_Wrapper
     public:
         RgbdSlamNode(const std::string &strVocFile,
                      const std::string &strSettingsFile,
-                     ORB_SLAM3::System::eSensor sensor);
+                     ORB_SLAM3::System::eSensor sensor,
+                     const rclcpp::NodeOptions &options = rclcpp::NodeOptions());
         ~RgbdSlamNode();
 
     private:
@@ -51,6 +81,7 @@ namespace ORB_SLAM3_Wrapper
         // ROS 2 Callbacks.
         void ImuCallback(const sensor_msgs::msg::Imu::SharedPtr msgIMU);
         void OdomCallback(const nav_msgs::msg::Odometry::SharedPtr msgOdom);
+        void GroundTruthCallback(const nav_msgs::msg::Odometry::SharedPtr msgGroundTruth);
         void RGBDCallback(const sensor_msgs::msg::Image::SharedPtr msgRGB,
                        const sensor_msgs::msg::Image::SharedPtr msgD);
 
@@ -61,8 +92,28 @@ namespace ORB_SLAM3_Wrapper
          */
         void publishMapData();
 
+        /**
+         * @brief Rebuilds the map data snapshot if the reference poses changed since the last one.
+         */
+        void refreshMapDataCache();
+
+        /**
+         * @brief Publishes the map points and the keyframe poses.
+         * @note Intra-process subscribers receive the internal arrays, the messages are only built for other processes.
+         */
         void publishMapPointCloud();
 
+        /**
+         * @brief Publishes the throttled keyframe, camera and covisibility markers.
+         * @note Built from the same snapshot as the last published map data.
+         */
+        void publishKeyFrameMarkers();
+
+        /**
+         * @brief Publishes the stage latencies and the tracking load on /diagnostics.
+         */
+        void publishDiagnostics();
+
         /**
          * @brief Callback function for GetMap service.
          * @param request_header Request header.
@@ -73,6 +124,156 @@ namespace ORB_SLAM3_Wrapper
                           std::shared_ptr<slam_msgs::srv::GetMap::Request> request,
                           std::shared_ptr<slam_msgs::srv::GetMap::Response> response);
 
+        /**
+         * @brief Callback function for the localization mode service.
+         * @param request_header Request header.
+         * @param request True to turn mapping off, false to turn it back on.
+         * @param response Response message.
+         */
+        void localizationModeServer(std::shared_ptr<rmw_request_id_t> request_header,
+                                    std::shared_ptr<std_srvs::srv::SetBool::Request> request,
+                                    std::shared_ptr<std_srvs::srv::SetBool::Response> response);
+
+        /**
+         * @brief Callback function for the performance profile service.
+         * @param request_header Request header.
+         * @param request Name of the profile to switch to.
+         * @param response Response message.
+         */
+        void performanceProfileServer(std::shared_ptr<rmw_request_id_t> request_header,
+                                      std::shared_ptr<slam_msgs::srv::SetPerformanceProfile::Request> request,
+                                      std::shared_ptr<slam_msgs::srv::SetPerformanceProfile::Response> response);
+
+        /**
+         * @brief Callback function for the keyframe images service.
+         * @param request_header Request header.
+         * @param request ID of the keyframe.
+         * @param response RGB and depth images of the keyframe.
+         */
+        void keyFrameImagesServer(std::shared_ptr<rmw_request_id_t> request_header,
+                                  std::shared_ptr<slam_msgs::srv::GetKeyFrameImages::Request> request,
+                                  std::shared_ptr<slam_msgs::srv::GetKeyFrameImages::Response> response);
+
+        /**
+         * @brief Callback function for the dense cloud service.
+         * @param request_header Request header.
+         * @param request Minimum integration weight of the exported voxels.
+         * @param response Surface points of the TSDF.
+         */
+        void denseCloudServer(std::shared_ptr<rmw_request_id_t> request_header,
+                              std::shared_ptr<slam_msgs::srv::GetDenseCloud::Request> request,
+                              std::shared_ptr<slam_msgs::srv::GetDenseCloud::Response> response);
+
+        /**
+         * @brief Callback function for the trajectory export service.
+         * @param request_header Request header.
+         * @param request Destination of the corrected trajectory.
+         * @param response Whether the export was queued.
+         */
+        void exportTrajectoryServer(std::shared_ptr<rmw_request_id_t> request_header,
+                                    std::shared_ptr<slam_msgs::srv::ExportTrajectory::Request> request,
+                                    std::shared_ptr<slam_msgs::srv::ExportTrajectory::Response> response);
+
+        /**
+         * @brief Callback function for the profiling service.
+         * @param request_header Request header.
+         * @param request Duration, sampling frequency and destination of the profile.
+         * @param response Whether the profiler was started.
+         */
+        void startProfilingServer(std::shared_ptr<rmw_request_id_t> request_header,
+                                  std::shared_ptr<slam_msgs::srv::StartProfiling::Request> request,
+                                  std::shared_ptr<slam_msgs::srv::StartProfiling::Response> response);
+
+        /**
+         * @brief Callback function for the initial pose service.
+         * @param request_header Request header.
+         * @param request Pose prior in the global frame and the radius around it.
+         * @param response Whether the prior was set.
+         */
+        void setInitialPoseServer(std::shared_ptr<rmw_request_id_t> request_header,
+                                  std::shared_ptr<slam_msgs::srv::SetInitialPose::Request> request,
+                                  std::shared_ptr<slam_msgs::srv::SetInitialPose::Response> response);
+
+        /**
+         * @brief Switches all the parameters of a performance profile at once.
+         * @param name Name of the profile.
+         * @param reason Reason of the failure.
+         * @return True if the profile was applied.
+         */
+        bool applyPerformanceProfile(const std::string &name, std::string &reason);
+
+        /**
+         * @brief Returns the upper bounds of the ORB extractor, the settings file with orb_features and orb_levels applied.
+         */
+        ORB_SLAM3_Wrapper::OrbExtractorSettings getOrbExtractorLimit();
+
+        /**
+         * @brief Integrates new and moved keyframes into the occupancy grid and publishes the changed region.
+         */
+        void publishOccupancyGrid();
+
+        /**
+         * @brief Runs the stationary gate on a frame and publishes the last pose for a skipped frame.
+         * @param msgRGB RGB image of the frame.
+         * @return True if the frame should be tracked.
+         */
+        bool admitStationaryFrame(const sensor_msgs::msg::Image::SharedPtr msgRGB);
+
+        /**
+         * @brief Runs the image quality filter on a frame.
+         * @param msgRGB RGB image of the frame.
+         * @param msgD Depth image of the frame.
+         * @return True if the frame should be tracked.
+         */
+        bool admitQualityFrame(const sensor_msgs::msg::Image::SharedPtr msgRGB, const sensor_msgs::msg::Image::SharedPtr msgD);
+
+        /**
+         * @brief Publishes the input images and the pose of a new keyframe.
+         * The incoming messages are published as they are, so the images are neither decoded nor copied again.
+         * @param msgRGB RGB image of the keyframe.
+         * @param msgD Depth image of the keyframe.
+         */
+        void publishKeyFrameStream(const sensor_msgs::msg::Image::SharedPtr msgRGB, const sensor_msgs::msg::Image::SharedPtr msgD);
+
+        /**
+         * @brief Appends the pose of the last frame to the trajectory log.
+         * @param tracked True if the frame was tracked.
+         */
+        void logTrajectory(const sensor_msgs::msg::Image::SharedPtr msgRGB, bool tracked);
+
+        /**
+         * @brief Queues the export of the loop corrected trajectory.
+         * @return False if trajectory logging is disabled.
+         */
+        bool exportTrajectory(const std::string &path);
+
+        /**
+         * @brief Publishes the running ATE and RPE against the ground truth.
+         */
+        void publishTrajectoryError();
+
+        /**
+         * @brief Checks if a throttled output should be published and updates its last publish time.
+         * @param lastPublished Time of the last publish of the output.
+         * @param rate Maximum rate of the output in Hz. 0 publishes on every tracked frame.
+         */
+        bool isOutputDue(rclcpp::Time &lastPublished, double rate);
+
+        /**
+         * @brief Checks if an output has to be computed, based on its subscribers and rate.
+         * @param output Name of the output, also used for its statistics.
+         * @param rate Maximum rate of the output in Hz. 0 computes it on every tracked frame.
+         * @param subscribers Number of subscribers of the topics of the output.
+         */
+        bool isOutputNeeded(const std::string &output, double rate, size_t subscribers);
+
+        /**
+         * @brief Applies runtime changes of the node parameters.
+         * @param parameters Parameters to be set.
+         * @return Result of the parameter update.
+         */
+        rcl_interfaces::msg::SetParametersResult onParameterChange(const std::vector<rclcpp::Parameter> &parameters);
+
         /**
          * Member variables
          */
@@ -82,9 +283,30 @@ namespace ORB_SLAM3_Wrapper
         // ROS Publishers and Subscribers
         rclcpp::Subscription<sensor_msgs::msg::Imu>::SharedPtr imu_sub;
         rclcpp::Subscription<nav_msgs::msg::Odometry>::SharedPtr odom_sub;
+        rclcpp::Subscription<nav_msgs::msg::Odometry>::SharedPtr ground_truth_sub;
         rclcpp::Publisher<slam_msgs::msg::MapData>::SharedPtr map_data_pub;
-        rclcpp::Publisher<sensor_msgs::msg::PointCloud2>::SharedPtr map_points_pub;
+        rclcpp::Publisher<ORB_SLAM3_Wrapper::MapPointArrayAdapter>::SharedPtr map_points_pub;
+        rclcpp::Publisher<ORB_SLAM3_Wrapper::KeyFramePoseArrayAdapter>::SharedPtr keyframe_poses_pub;
+        rclcpp::Publisher<visualization_msgs::msg::MarkerArray>::SharedPtr keyframe_markers_pub;
+        rclcpp::Publisher<diagnostic_msgs::msg::DiagnosticArray>::SharedPtr diagnostics_pub;
+        rclcpp::Publisher<ORB_SLAM3_Wrapper::SharedImageAdapter>::SharedPtr keyframe_rgb_pub;
+        rclcpp::Publisher<ORB_SLAM3_Wrapper::SharedImageAdapter>::SharedPtr keyframe_depth_pub;
+        rclcpp::Publisher<slam_msgs::msg::KeyFramePose>::SharedPtr keyframe_pose_pub;
+        rclcpp::Publisher<nav_msgs::msg::OccupancyGrid>::SharedPtr occupancy_grid_pub;
+        rclcpp::Publisher<map_msgs::msg::OccupancyGridUpdate>::SharedPtr occupancy_grid_updates_pub;
+        rclcpp::Publisher<slam_msgs::msg::TrajectoryError>::SharedPtr trajectory_error_pub;
+        rclcpp::TimerBase::SharedPtr diagnostics_timer_;
+        rclcpp::TimerBase::SharedPtr memory_timer_;
+        rclcpp::TimerBase::SharedPtr evaluation_timer_;
         rclcpp::Service<slam_msgs::srv::GetMap>::SharedPtr get_map_data_service;
+        rclcpp::Service<std_srvs::srv::SetBool>::SharedPtr localization_mode_service;
+        rclcpp::Service<slam_msgs::srv::SetPerformanceProfile>::SharedPtr performance_profile_service;
+        rclcpp::Service<slam_msgs::srv::GetKeyFrameImages>::SharedPtr keyframe_images_service;
+        rclcpp::Service<slam_msgs::srv::GetDenseCloud>::SharedPtr dense_cloud_service;
+        rclcpp::Service<slam_msgs::srv::ExportTrajectory>::SharedPtr export_trajectory_service;
+        rclcpp::Service<slam_msgs::srv::StartProfiling>::SharedPtr start_profiling_service;
+        rclcpp::Service<slam_msgs::srv::SetInitialPose>::SharedPtr set_initial_pose_service;
+        rclcpp::node_interfaces::OnSetParametersCallbackHandle::SharedPtr parameter_callback_handle_;
         std::shared_ptr<message_filters::Synchronizer<approximate_sync_policy>> syncApproximate;
         std::shared_ptr<tf2_ros::TransformBroadcaster> tf_broadcaster_;
 
@@ -94,9 +316,86 @@ namespace ORB_SLAM3_Wrapper
         std::string global_frame_;
         double robot_x_, robot_y_;
         bool rosViz_;
+        double rosVizRate_;
+        double mapDataRate_;
+        double mapPointsRate_;
+        int covisibilityMinWeight_;
         ORB_SLAM3_Wrapper::WrapperTypeConversions conversions;
         std::shared_ptr<ORB_SLAM3_Wrapper::ORBSLAM3Interface> interface;
         geometry_msgs::msg::TransformStamped tfMapOdom;
+        std::shared_ptr<ORB_SLAM3_Wrapper::MapVisualizer> mapVisualizer_;
+        // demand driven outputs and the time spent computing them.
+        std::map<std::string, ORB_SLAM3_Wrapper::OutputGate> outputGates_;
+        ORB_SLAM3_Wrapper::StageTimer outputTimer_;
+        rclcpp::Time lastTsdfPoseUpdateTime_;
+        visualization_msgs::msg::MarkerArray markers_;
+        std::vector<std::pair<int, int>> covisibilityEdges_;
+        // adaptive tracking load.
+        bool adaptiveTrackingLoad_;
+        double trackingLatencyBudgetMs_;
+        int minTrackedInliers_;
+        int maxFrameStride_;
+        // extractor of the settings file, orb_features and orb_levels override it, the controller lowers it down to the minimums.
+        ORB_SLAM3_Wrapper::OrbExtractorSettings orbExtractor_;
+        bool orbExtractorControl_ = false;
+        int orbFeatures_;
+        int orbLevels_;
+        int minOrbFeatures_;
+        int minOrbLevels_;
+        std::shared_ptr<ORB_SLAM3_Wrapper::TrackingLoadController> trackingLoadController_;
+        // performance profiles.
+        std::map<std::string, ORB_SLAM3_Wrapper::PerformanceProfile> performanceProfiles_;
+        std::string activeProfile_;
+        // 2D occupancy grid for Nav2.
+        bool occupancyGrid_;
+        double occupancyGridRate_;
+        std::shared_ptr<ORB_SLAM3_Wrapper::OccupancyGridBuilder> occupancyGridBuilder_;
+        unsigned long occupancyGridVersion_ = 0;
+        ORB_SLAM3_Wrapper::KeyFramePoses occupancyKeyFramePoses_;
+        std::vector<long unsigned int> occupancyChangedKeyFrames_;
+        ORB_SLAM3_Wrapper::KeyFrameLandmarksList occupancyLandmarks_;
+        nav_msgs::msg::OccupancyGrid occupancyGridMsg_;
+        map_msgs::msg::OccupancyGridUpdate occupancyGridUpdateMsg_;
+        // dense reconstruction, nullptr if disabled.
+        std::shared_ptr<ORB_SLAM3_Wrapper::TsdfFusion> tsdfFusion_;
+        double tsdfPoseUpdateRate_;
+        ORB_SLAM3_Wrapper::KeyFramePoses tsdfKeyFramePoses_;
+        std::vector<long unsigned int> tsdfRemovedKeyFrames_;
+        // log of all frames, nullptr if disabled.
+        std::shared_ptr<ORB_SLAM3_Wrapper::TrajectoryLogger> trajectoryLogger_;
+        std::string trajectoryExportFile_;
+        // accuracy against the ground truth, nullptr if disabled.
+        std::shared_ptr<ORB_SLAM3_Wrapper::TrajectoryEvaluator> trajectoryEvaluator_;
+        // recording of the tracker inputs, nullptr if disabled.
+        std::shared_ptr<ORB_SLAM3_Wrapper::InputRecorder> inputRecorder_;
+        // allocation statistics of the frame callback at the last diagnostics, 0 budget disables the warning.
+        ORB_SLAM3_Wrapper::StageStatistics lastCallbackStatistics_;
+        unsigned long allocationBudget_;
+        // sampling profiler, nullptr if disabled.
+        std::shared_ptr<ORB_SLAM3_Wrapper::SamplingProfiler> samplingProfiler_;
+        std::string profilerDirectory_;
+        // default radius of the pose priors.
+        double initialPoseRadius_;
+        // skips frames while the robot stands still, nullptr if disabled.
+        std::shared_ptr<ORB_SLAM3_Wrapper::StationaryGate> stationaryGate_;
+        // tracks the frames between two ORB-SLAM3 frames, nullptr if disabled.
+        std::shared_ptr<ORB_SLAM3_Wrapper::KltFrameTracker> kltTracker_;
+        int kltFrameStride_;
+        int framesSinceFullTrack_ = 0;
+        // skips frames which can not be tracked, nullptr if disabled.
+        std::shared_ptr<ORB_SLAM3_Wrapper::ImageQualityFilter> imageQualityFilter_;
+        // odometry motion prior, nullptr if disabled.
+        std::shared_ptr<ORB_SLAM3_Wrapper::OdometryMotionPrior> motionPrior_;
+        // input images of the keyframes.
+        std::shared_ptr<ORB_SLAM3_Wrapper::KeyFrameImageCache> keyFrameImageCache_;
+        // Map exports are only rebuilt when the reference poses were recalculated.
+        // While in localization mode this happens only once after the switch.
+        // They are kept across publishes. The map data is published by reference, its message has unbounded
+        // sequences, so it can not be loaned, and publishing a unique_ptr would give the buffers away.
+        // The map points and keyframe poses are shared with intra-process subscribers, see MapOutputCache.
+        slam_msgs::msg::MapData mapDataCache_;
+        ORB_SLAM3_Wrapper::MapOutputCache mapOutputCache_;
+        unsigned long mapDataCacheVersion_ = 0;
     };
 }
 #endif
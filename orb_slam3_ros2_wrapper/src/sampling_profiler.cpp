@@ -0,0 +1,303 @@
+/**
+ * @file sampling_profiler.cpp
+ * @brief Implementation of the SamplingProfiler class.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#include "sampling_profiler.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <unordered_map>
+
+#include <cxxabi.h>
+#include <dirent.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+namespace ORB_SLAM3_Wrapper
+{
+    namespace
+    {
+        const int maxFrames = 48;
+        // about 40 MB, enough for 10 s of 20 busy threads at 500 Hz.
+        const size_t maxSamples = 100000;
+
+        struct Sample
+        {
+            pid_t tid;
+            int depth;
+            void *frames[maxFrames];
+        };
+
+        // written by the signal handler, so they can not be members.
+        std::atomic<bool> sampling(false);
+        std::atomic<size_t> nextSample(0);
+        Sample *samples = nullptr;
+        std::once_flag handlerInstalled;
+
+        void handleSignal(int, siginfo_t *, void *)
+        {
+            if (!sampling.load(std::memory_order_acquire))
+            {
+                return;
+            }
+            int savedErrno = errno;
+            size_t index = nextSample.fetch_add(1, std::memory_order_relaxed);
+            if (index < maxSamples)
+            {
+                Sample &sample = samples[index];
+                sample.tid = static_cast<pid_t>(syscall(SYS_gettid));
+                sample.depth = backtrace(sample.frames, maxFrames);
+            }
+            errno = savedErrno;
+        }
+
+        /**
+         * @brief The clock measuring the CPU time of any thread of the process (MAKE_THREAD_CPUCLOCK of the kernel).
+         */
+        clockid_t threadCpuClock(pid_t tid)
+        {
+            return static_cast<clockid_t>((~static_cast<unsigned int>(tid) << 3) | 6);
+        }
+
+        std::vector<pid_t> listThreads()
+        {
+            std::vector<pid_t> threads;
+            DIR *directory = opendir("/proc/self/task");
+            if (!directory)
+            {
+                return threads;
+            }
+            while (dirent *entry = readdir(directory))
+            {
+                if (entry->d_name[0] != '.')
+                {
+                    threads.push_back(static_cast<pid_t>(std::atoi(entry->d_name)));
+                }
+            }
+            closedir(directory);
+            return threads;
+        }
+
+        std::string threadName(pid_t tid)
+        {
+            std::ifstream comm("/proc/self/task/" + std::to_string(tid) + "/comm");
+            std::string name;
+            std::getline(comm, name);
+            if (name.empty())
+            {
+                name = "thread";
+            }
+            // the folded format separates the frames by ';' and the count by ' '.
+            std::replace(name.begin(), name.end(), ' ', '_');
+            std::replace(name.begin(), name.end(), ';', '_');
+            return name + "-" + std::to_string(tid);
+        }
+
+        std::string symbolize(void *address)
+        {
+            Dl_info info;
+            if (dladdr(address, &info) == 0 || !info.dli_fname)
+            {
+                char buffer[32];
+                std::snprintf(buffer, sizeof(buffer), "%p", address);
+                return buffer;
+            }
+            std::string name;
+            if (info.dli_sname)
+            {
+                int status = 0;
+                std::unique_ptr<char, decltype(&std::free)> demangled(abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status), &std::free);
+                name = status == 0 && demangled ? demangled.get() : info.dli_sname;
+            }
+            else
+            {
+                // static functions have no dynamic symbol, the module and offset still allow addr2line.
+                const char *module = std::strrchr(info.dli_fname, '/');
+                char buffer[32];
+                std::snprintf(buffer, sizeof(buffer), "+0x%lx", static_cast<unsigned long>(static_cast<char *>(address) - static_cast<char *>(info.dli_fbase)));
+                name = std::string(module ? module + 1 : info.dli_fname) + buffer;
+            }
+            std::replace(name.begin(), name.end(), ';', ':');
+            std::replace(name.begin(), name.end(), ' ', '_');
+            return name;
+        }
+    }
+
+    SamplingProfiler::SamplingProfiler()
+        : running_(false)
+    {
+    }
+
+    SamplingProfiler::~SamplingProfiler()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (worker_.joinable())
+        {
+            worker_.join();
+        }
+    }
+
+    bool SamplingProfiler::isRunning()
+    {
+        return running_;
+    }
+
+    bool SamplingProfiler::start(double duration, int frequency, const std::string &path, std::string &message)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (running_ || sampling)
+        {
+            message = "A profile is already running.";
+            return false;
+        }
+        if (duration <= 0.0 || frequency <= 0 || frequency > 10000)
+        {
+            message = "The duration has to be positive and the frequency within 1-10000 Hz.";
+            return false;
+        }
+        if (worker_.joinable())
+        {
+            worker_.join();
+        }
+
+        std::call_once(handlerInstalled, []()
+                       {
+            // backtrace loads libgcc on its first call, which must not happen in the signal handler.
+            void *frames[maxFrames];
+            backtrace(frames, maxFrames);
+            // the handler stays installed, a late signal after the profile finds sampling false and returns.
+            struct sigaction action;
+            std::memset(&action, 0, sizeof(action));
+            action.sa_sigaction = handleSignal;
+            action.sa_flags = SA_SIGINFO | SA_RESTART;
+            sigemptyset(&action.sa_mask);
+            sigaction(SIGPROF, &action, nullptr); });
+
+        if (!samples)
+        {
+            samples = new Sample[maxSamples];
+        }
+        nextSample = 0;
+        sampling.store(true, std::memory_order_release);
+
+        long periodNs = 1000000000L / frequency;
+        struct itimerspec interval;
+        interval.it_interval.tv_sec = periodNs / 1000000000L;
+        interval.it_interval.tv_nsec = periodNs % 1000000000L;
+        interval.it_value = interval.it_interval;
+        for (pid_t tid : listThreads())
+        {
+            struct sigevent event;
+            std::memset(&event, 0, sizeof(event));
+            event.sigev_notify = SIGEV_THREAD_ID;
+            event.sigev_signo = SIGPROF;
+            event.sigev_notify_thread_id = tid;
+            timer_t timer;
+            if (timer_create(threadCpuClock(tid), &event, &timer) != 0)
+            {
+                // the thread may have exited since the directory was read.
+                continue;
+            }
+            if (timer_settime(timer, 0, &interval, nullptr) != 0)
+            {
+                timer_delete(timer);
+                continue;
+            }
+            timers_.push_back(timer);
+        }
+        if (timers_.empty())
+        {
+            sampling = false;
+            message = std::string("Could not create the profiling timers: ") + std::strerror(errno);
+            return false;
+        }
+        running_ = true;
+        message = "Profiling " + std::to_string(timers_.size()) + " threads for " + std::to_string(duration) + " s into " + path;
+        worker_ = std::thread(&SamplingProfiler::run, this, duration, path);
+        return true;
+    }
+
+    void SamplingProfiler::run(double duration, std::string path)
+    {
+        std::this_thread::sleep_for(std::chrono::duration<double>(duration));
+        stopTimers();
+        writeFoldedStacks(path);
+        running_ = false;
+    }
+
+    void SamplingProfiler::stopTimers()
+    {
+        for (timer_t timer : timers_)
+        {
+            timer_delete(timer);
+        }
+        timers_.clear();
+        sampling.store(false, std::memory_order_release);
+        // a handler may still be unwinding into its sample.
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    void SamplingProfiler::writeFoldedStacks(const std::string &path)
+    {
+        size_t count = std::min(nextSample.load(), maxSamples);
+        std::unordered_map<void *, std::string> symbols;
+        std::map<pid_t, std::string> threadNames;
+        std::map<std::string, unsigned long> stacks;
+        for (size_t i = 0; i < count; i++)
+        {
+            const Sample &sample = samples[i];
+            auto name = threadNames.find(sample.tid);
+            if (name == threadNames.end())
+            {
+                name = threadNames.emplace(sample.tid, threadName(sample.tid)).first;
+            }
+            std::string stack = name->second;
+            // the innermost two frames are the handler and the signal trampoline.
+            for (int frame = sample.depth - 1; frame >= 2; frame--)
+            {
+                auto symbol = symbols.find(sample.frames[frame]);
+                if (symbol == symbols.end())
+                {
+                    symbol = symbols.emplace(sample.frames[frame], symbolize(sample.frames[frame])).first;
+                }
+                stack += ";" + symbol->second;
+            }
+            stacks[stack]++;
+        }
+
+        std::FILE *file = std::fopen(path.c_str(), "w");
+        if (!file)
+        {
+            std::cerr << "Could not write the profile to " << path << ": " << std::strerror(errno) << std::endl;
+            return;
+        }
+        for (const auto &stack : stacks)
+        {
+            std::fprintf(file, "%s %lu\n", stack.first.c_str(), stack.second);
+        }
+        std::fclose(file);
+        std::cout << "Wrote " << count << " samples (" << stacks.size() << " stacks) to " << path;
+        if (nextSample > maxSamples)
+        {
+            std::cout << ", " << nextSample - maxSamples << " samples did not fit";
+        }
+        std::cout << std::endl;
+    }
+}
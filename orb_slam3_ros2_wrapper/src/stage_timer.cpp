@@ -0,0 +1,69 @@
+/**
+ * @file stage_timer.cpp
+ * @brief Implementation of the StageTimer class.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#include "stage_timer.hpp"
+
+#include <algorithm>
+
+namespace ORB_SLAM3_Wrapper
+{
+    void StageTimer::record(const std::string &stage, double elapsedMs, const AllocationCount &allocations)
+    {
+        std::lock_guard<std::mutex> lock(statsMutex_);
+        StageStatistics &stageStats = stats_[stage];
+        stageStats.count++;
+        stageStats.lastMs = elapsedMs;
+        stageStats.maxMs = std::max(stageStats.maxMs, elapsedMs);
+        stageStats.totalMs += elapsedMs;
+        stageStats.lastAllocations = allocations.allocations;
+        stageStats.totalAllocations += allocations.allocations;
+        stageStats.totalAllocatedBytes += allocations.bytes;
+    }
+
+    StageStatistics StageTimer::get(const std::string &stage)
+    {
+        std::lock_guard<std::mutex> lock(statsMutex_);
+        auto it = stats_.find(stage);
+        if (it == stats_.end())
+        {
+            return StageStatistics();
+        }
+        return it->second;
+    }
+
+    std::map<std::string, StageStatistics> StageTimer::snapshot()
+    {
+        std::lock_guard<std::mutex> lock(statsMutex_);
+        return stats_;
+    }
+
+    void StageTimer::reset()
+    {
+        std::lock_guard<std::mutex> lock(statsMutex_);
+        stats_.clear();
+    }
+
+    ScopedStage::ScopedStage(StageTimer &timer, const std::string &stage)
+        : timer_(timer),
+          stage_(stage),
+          start_(std::chrono::steady_clock::now()),
+          startAllocations_(AllocationCounter::thread())
+    {
+    }
+
+    ScopedStage::~ScopedStage()
+    {
+        AllocationCount allocations = AllocationCounter::thread();
+        allocations.allocations -= startAllocations_.allocations;
+        allocations.bytes -= startAllocations_.bytes;
+        timer_.record(stage_, elapsedMs(), allocations);
+    }
+
+    double ScopedStage::elapsedMs()
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_).count();
+    }
+}
@@ -0,0 +1,125 @@
+/**
+ * @file stationary_gate.cpp
+ * @brief Implementation of the StationaryGate class.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#include "stationary_gate.hpp"
+
+#include <cmath>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+namespace ORB_SLAM3_Wrapper
+{
+    namespace
+    {
+        // sensors which did not report for this long are not used for the decision.
+        const double sensorTimeout = 0.5;
+        // 1200 pixels, nearest neighbour sampling touches only these.
+        const cv::Size thumbnailSize(40, 30);
+    }
+
+    StationaryGate::StationaryGate(double maxLinearSpeed, double maxAngularSpeed, double maxImageDifference, double holdTime, double trackInterval)
+        : maxLinearSpeed_(maxLinearSpeed),
+          maxAngularSpeed_(maxAngularSpeed),
+          maxImageDifference_(maxImageDifference),
+          holdTime_(holdTime),
+          trackInterval_(trackInterval),
+          odometryStamp_(0.0),
+          odometryMoving_(false),
+          imuStamp_(0.0),
+          imuMoving_(false),
+          hasStationarySince_(false),
+          stationarySince_(0.0),
+          lastTrackedStamp_(0.0),
+          stationary_(false),
+          skippedFrames_(0)
+    {
+    }
+
+    void StationaryGate::addOdometry(double stamp, double linearSpeed, double angularSpeed)
+    {
+        odometryStamp_ = stamp;
+        odometryMoving_ = std::abs(linearSpeed) > maxLinearSpeed_ || std::abs(angularSpeed) > maxAngularSpeed_;
+    }
+
+    void StationaryGate::addImu(double stamp, double angularSpeed)
+    {
+        // the IMU runs far faster than the camera, a single rate above the threshold marks the frame as moving.
+        if (!imuMoving_ || stamp - imuStamp_ > sensorTimeout)
+        {
+            imuMoving_ = angularSpeed > maxAngularSpeed_;
+        }
+        imuStamp_ = stamp;
+    }
+
+    bool StationaryGate::sensorsMoving(double stamp)
+    {
+        bool moving = (std::abs(stamp - odometryStamp_) < sensorTimeout && odometryMoving_) ||
+                      (std::abs(stamp - imuStamp_) < sensorTimeout && imuMoving_);
+        // the IMU flag collects the rates since the last frame.
+        imuMoving_ = false;
+        return moving;
+    }
+
+    bool StationaryGate::admitFrame(double stamp, const cv::Mat &image)
+    {
+        bool moving = sensorsMoving(stamp);
+        cv::resize(image, thumbnail_, thumbnailSize, 0.0, 0.0, cv::INTER_NEAREST);
+        if (thumbnail_.channels() == 3)
+        {
+            cv::cvtColor(thumbnail_, thumbnail_, cv::COLOR_RGB2GRAY);
+        }
+        else if (thumbnail_.channels() == 4)
+        {
+            cv::cvtColor(thumbnail_, thumbnail_, cv::COLOR_RGBA2GRAY);
+        }
+        if (!moving && !referenceThumbnail_.empty() && referenceThumbnail_.type() == thumbnail_.type())
+        {
+            cv::absdiff(thumbnail_, referenceThumbnail_, difference_);
+            moving = cv::mean(difference_)[0] > maxImageDifference_;
+        }
+        else
+        {
+            moving = true;
+        }
+
+        if (moving)
+        {
+            hasStationarySince_ = false;
+        }
+        else if (!hasStationarySince_)
+        {
+            hasStationarySince_ = true;
+            stationarySince_ = stamp;
+        }
+        stationary_ = hasStationarySince_ && stamp - stationarySince_ >= holdTime_;
+        if (stationary_ && stamp - lastTrackedStamp_ < trackInterval_)
+        {
+            skippedFrames_++;
+            return false;
+        }
+        lastTrackedStamp_ = stamp;
+        std::swap(referenceThumbnail_, thumbnail_);
+        return true;
+    }
+
+    void StationaryGate::reset()
+    {
+        hasStationarySince_ = false;
+        stationary_ = false;
+        // without a reference the next frame is admitted.
+        referenceThumbnail_.release();
+    }
+
+    bool StationaryGate::isStationary()
+    {
+        return stationary_;
+    }
+
+    unsigned long StationaryGate::getSkippedFrames()
+    {
+        return skippedFrames_;
+    }
+}
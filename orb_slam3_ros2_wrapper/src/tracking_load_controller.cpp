@@ -0,0 +1,236 @@
+/**
+ * @file tracking_load_controller.cpp
+ * @brief Implementation of the TrackingLoadController class.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#include "tracking_load_controller.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include <opencv2/core/persistence.hpp>
+
+namespace ORB_SLAM3_Wrapper
+{
+    namespace
+    {
+        // tracked frames between two adjustments, the filtered latency needs a few frames to follow one.
+        const int adjustmentInterval = 10;
+        // the latency has to stay below this share of the budget before the load is raised again.
+        const double headroom = 0.8;
+        const double featuresDecrease = 0.85;
+        const double featuresIncrease = 1.1;
+    }
+
+    bool OrbExtractorSettings::fromSettingsFile(const std::string &settingsFile, OrbExtractorSettings &settings)
+    {
+        cv::FileStorage fsSettings(settingsFile, cv::FileStorage::READ);
+        if (!fsSettings.isOpened() || fsSettings["ORBextractor.nFeatures"].empty())
+        {
+            return false;
+        }
+        settings.nFeatures = (int)fsSettings["ORBextractor.nFeatures"];
+        settings.scaleFactor = (float)fsSettings["ORBextractor.scaleFactor"];
+        settings.nLevels = (int)fsSettings["ORBextractor.nLevels"];
+        settings.iniThFAST = (int)fsSettings["ORBextractor.iniThFAST"];
+        settings.minThFAST = (int)fsSettings["ORBextractor.minThFAST"];
+        return settings.nFeatures > 0 && settings.nLevels > 0;
+    }
+
+    bool OrbExtractorSettings::operator==(const OrbExtractorSettings &other) const
+    {
+        return nFeatures == other.nFeatures && scaleFactor == other.scaleFactor && nLevels == other.nLevels &&
+               iniThFAST == other.iniThFAST && minThFAST == other.minThFAST;
+    }
+
+    TrackingLoadController::TrackingLoadController(double latencyBudgetMs, int minInliers, int maxStride)
+        : latencyBudgetMs_(latencyBudgetMs),
+          minInliers_(minInliers),
+          maxStride_(std::max(1, maxStride)),
+          extractorControl_(false),
+          minFeatures_(0),
+          minLevels_(0),
+          extractorChanged_(false),
+          stride_(1),
+          framesSinceTracked_(0),
+          framesSinceAdjustment_(0),
+          filteredLatencyMs_(0.0),
+          hasLatency_(false),
+          skippedFrames_(0)
+    {
+    }
+
+    bool TrackingLoadController::admitFrame()
+    {
+        framesSinceTracked_++;
+        if (framesSinceTracked_ < stride_)
+        {
+            skippedFrames_++;
+            return false;
+        }
+        framesSinceTracked_ = 0;
+        return true;
+    }
+
+    void TrackingLoadController::update(double trackingLatencyMs, int trackedInliers)
+    {
+        // exponential moving average to avoid reacting on single spikes.
+        const double alpha = 0.2;
+        filteredLatencyMs_ = hasLatency_ ? (1.0 - alpha) * filteredLatencyMs_ + alpha * trackingLatencyMs : trackingLatencyMs;
+        hasLatency_ = true;
+        framesSinceAdjustment_++;
+
+        // few inliers means fast motion or little texture, tracking needs every frame and more features right away.
+        if (trackedInliers < minInliers_)
+        {
+            stride_ = 1;
+            if (raiseExtractor())
+            {
+                framesSinceAdjustment_ = 0;
+            }
+            return;
+        }
+        if (latencyBudgetMs_ <= 0.0 || framesSinceAdjustment_ < adjustmentInterval)
+        {
+            return;
+        }
+        // a tracked frame may use the budget of all the frames it stands for.
+        if (filteredLatencyMs_ > latencyBudgetMs_ * stride_)
+        {
+            // cheaper frames first, fewer frames only with the extractor at its minimum.
+            if (!lowerExtractor())
+            {
+                int requiredStride = static_cast<int>(std::ceil(filteredLatencyMs_ / latencyBudgetMs_));
+                stride_ = std::min(std::max(requiredStride, stride_), maxStride_);
+            }
+            framesSinceAdjustment_ = 0;
+        }
+        else if (stride_ > 1)
+        {
+            // hysteresis, only step down if the lower stride has some headroom.
+            if (filteredLatencyMs_ < headroom * latencyBudgetMs_ * (stride_ - 1))
+            {
+                stride_--;
+                framesSinceAdjustment_ = 0;
+            }
+        }
+        else if (filteredLatencyMs_ < headroom * latencyBudgetMs_ && raiseExtractor())
+        {
+            framesSinceAdjustment_ = 0;
+        }
+    }
+
+    bool TrackingLoadController::lowerExtractor()
+    {
+        if (!extractorControl_)
+        {
+            return false;
+        }
+        if (extractor_.nFeatures > minFeatures_)
+        {
+            extractor_.nFeatures = std::max(minFeatures_, static_cast<int>(extractor_.nFeatures * featuresDecrease));
+        }
+        else if (extractor_.nLevels > minLevels_)
+        {
+            // the coarse levels cost little, but they are what is left.
+            extractor_.nLevels--;
+        }
+        else
+        {
+            return false;
+        }
+        extractorChanged_ = true;
+        return true;
+    }
+
+    bool TrackingLoadController::raiseExtractor()
+    {
+        if (!extractorControl_)
+        {
+            return false;
+        }
+        // the reverse order of lowerExtractor.
+        if (extractor_.nLevels < maxExtractor_.nLevels)
+        {
+            extractor_.nLevels++;
+        }
+        else if (extractor_.nFeatures < maxExtractor_.nFeatures)
+        {
+            extractor_.nFeatures = std::min(maxExtractor_.nFeatures, static_cast<int>(std::ceil(extractor_.nFeatures * featuresIncrease)));
+        }
+        else
+        {
+            return false;
+        }
+        extractorChanged_ = true;
+        return true;
+    }
+
+    void TrackingLoadController::setExtractorBounds(const OrbExtractorSettings &maxSettings, int minFeatures, int minLevels)
+    {
+        maxExtractor_ = maxSettings;
+        minFeatures_ = std::min(std::max(1, minFeatures), maxSettings.nFeatures);
+        minLevels_ = std::min(std::max(1, minLevels), maxSettings.nLevels);
+        OrbExtractorSettings extractor = extractorControl_ ? extractor_ : maxSettings;
+        extractor.scaleFactor = maxSettings.scaleFactor;
+        extractor.iniThFAST = maxSettings.iniThFAST;
+        extractor.minThFAST = maxSettings.minThFAST;
+        extractor.nFeatures = std::min(std::max(extractor.nFeatures, minFeatures_), maxSettings.nFeatures);
+        extractor.nLevels = std::min(std::max(extractor.nLevels, minLevels_), maxSettings.nLevels);
+        extractorChanged_ = extractorChanged_ || !extractorControl_ || !(extractor == extractor_);
+        extractor_ = extractor;
+        extractorControl_ = true;
+    }
+
+    bool TrackingLoadController::takeExtractorChange(OrbExtractorSettings &settings)
+    {
+        if (!extractorChanged_)
+        {
+            return false;
+        }
+        settings = extractor_;
+        extractorChanged_ = false;
+        return true;
+    }
+
+    void TrackingLoadController::reset()
+    {
+        stride_ = 1;
+        framesSinceTracked_ = 0;
+        framesSinceAdjustment_ = 0;
+        if (extractorControl_ && !(extractor_ == maxExtractor_))
+        {
+            extractor_ = maxExtractor_;
+            extractorChanged_ = true;
+        }
+    }
+
+    int TrackingLoadController::getStride()
+    {
+        return stride_;
+    }
+
+    OrbExtractorSettings TrackingLoadController::getExtractor()
+    {
+        return extractor_;
+    }
+
+    double TrackingLoadController::getFilteredLatencyMs()
+    {
+        return filteredLatencyMs_;
+    }
+
+    unsigned long TrackingLoadController::getSkippedFrames()
+    {
+        return skippedFrames_;
+    }
+
+    void TrackingLoadController::setBounds(double latencyBudgetMs, int minInliers, int maxStride)
+    {
+        latencyBudgetMs_ = latencyBudgetMs;
+        minInliers_ = minInliers;
+        maxStride_ = std::max(1, maxStride);
+        stride_ = std::min(stride_, maxStride_);
+    }
+}
@@ -0,0 +1,239 @@
+/**
+ * @file trajectory_evaluator.cpp
+ * @brief Implementation of the TrajectoryEvaluator class.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#include "trajectory_evaluator.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <Eigen/SVD>
+
+namespace ORB_SLAM3_Wrapper
+{
+    namespace
+    {
+        // estimates are dropped if the ground truth stops, ground truth is dropped if the estimates stop.
+        const size_t maxPendingEstimates = 1000;
+        const size_t maxGroundTruth = 100000;
+    }
+
+    TrajectoryEvaluator::TrajectoryEvaluator(double maxTimeDifference, double rpeDelta)
+        : maxTimeDifference_(maxTimeDifference),
+          rpeDelta_(rpeDelta)
+    {
+        reset();
+    }
+
+    void TrajectoryEvaluator::reset()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        groundTruth_.clear();
+        pendingEstimates_.clear();
+        recentPairs_.clear();
+        lastEstimateStamp_ = -std::numeric_limits<double>::infinity();
+        pairs_ = 0;
+        unmatched_ = 0;
+        sumP_.setZero();
+        sumQ_.setZero();
+        sumQP_.setZero();
+        sumPP_ = 0.0;
+        sumQQ_ = 0.0;
+        lastP_.setZero();
+        lastQ_.setZero();
+        rpePairs_ = 0;
+        sumRpeTranslation2_ = 0.0;
+        sumRpeRotation2_ = 0.0;
+    }
+
+    double TrajectoryEvaluator::getRpeDelta()
+    {
+        return rpeDelta_;
+    }
+
+    void TrajectoryEvaluator::addGroundTruth(double stamp, const Eigen::Affine3d &pose)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        StampedPose groundTruth{stamp, pose};
+        // usually appended, out of order messages are inserted at their place.
+        if (groundTruth_.empty() || groundTruth_.back().stamp < stamp)
+        {
+            groundTruth_.push_back(groundTruth);
+        }
+        else
+        {
+            auto position = std::upper_bound(groundTruth_.begin(), groundTruth_.end(), stamp,
+                                             [](double value, const StampedPose &element)
+                                             { return value < element.stamp; });
+            groundTruth_.insert(position, groundTruth);
+        }
+        associate();
+    }
+
+    void TrajectoryEvaluator::addEstimate(double stamp, const Eigen::Affine3d &pose)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // the estimates come in tracking order.
+        if (stamp <= lastEstimateStamp_)
+        {
+            return;
+        }
+        lastEstimateStamp_ = stamp;
+        pendingEstimates_.push_back({stamp, pose});
+        if (pendingEstimates_.size() > maxPendingEstimates)
+        {
+            pendingEstimates_.pop_front();
+            unmatched_++;
+        }
+        associate();
+    }
+
+    void TrajectoryEvaluator::associate()
+    {
+        while (!pendingEstimates_.empty())
+        {
+            const StampedPose &estimate = pendingEstimates_.front();
+            PosePair pair;
+            int result = interpolateGroundTruth(estimate.stamp, pair.groundTruth);
+            if (result == 0)
+            {
+                break;
+            }
+            if (result > 0)
+            {
+                pair.stamp = estimate.stamp;
+                pair.estimate = estimate.pose;
+                addPair(pair);
+            }
+            else
+            {
+                unmatched_++;
+            }
+            pendingEstimates_.pop_front();
+        }
+        // the next estimates are not older than the last one, so older ground truth is not needed anymore.
+        double keepFrom = pendingEstimates_.empty() ? lastEstimateStamp_ : pendingEstimates_.front().stamp;
+        while (groundTruth_.size() > 1 &&
+               (groundTruth_[1].stamp <= keepFrom - maxTimeDifference_ || groundTruth_.size() > maxGroundTruth))
+        {
+            groundTruth_.pop_front();
+        }
+    }
+
+    int TrajectoryEvaluator::interpolateGroundTruth(double stamp, Eigen::Affine3d &pose)
+    {
+        if (groundTruth_.empty() || groundTruth_.back().stamp < stamp)
+        {
+            return 0;
+        }
+        auto next = std::lower_bound(groundTruth_.begin(), groundTruth_.end(), stamp,
+                                     [](const StampedPose &element, double value)
+                                     { return element.stamp < value; });
+        if (next == groundTruth_.begin())
+        {
+            if (next->stamp - stamp > maxTimeDifference_)
+            {
+                return -1;
+            }
+            pose = next->pose;
+            return 1;
+        }
+        auto previous = next - 1;
+        double gap = next->stamp - previous->stamp;
+        if (gap <= 2.0 * maxTimeDifference_)
+        {
+            double alpha = (stamp - previous->stamp) / gap;
+            Eigen::Quaterniond q0(previous->pose.linear());
+            Eigen::Quaterniond q1(next->pose.linear());
+            pose = Eigen::Translation3d((1.0 - alpha) * previous->pose.translation() + alpha * next->pose.translation()) *
+                   q0.slerp(alpha, q1);
+            return 1;
+        }
+        // a gap in the ground truth, only use it if one of the neighbours is close enough.
+        auto nearest = stamp - previous->stamp < next->stamp - stamp ? previous : next;
+        if (std::abs(nearest->stamp - stamp) > maxTimeDifference_)
+        {
+            return -1;
+        }
+        pose = nearest->pose;
+        return 1;
+    }
+
+    void TrajectoryEvaluator::addPair(const PosePair &pair)
+    {
+        const Eigen::Vector3d p = pair.estimate.translation();
+        const Eigen::Vector3d q = pair.groundTruth.translation();
+        pairs_++;
+        sumP_ += p;
+        sumQ_ += q;
+        sumQP_ += q * p.transpose();
+        sumPP_ += p.squaredNorm();
+        sumQQ_ += q.squaredNorm();
+        lastP_ = p;
+        lastQ_ = q;
+
+        // the pair closest to rpeDelta_ ago starts the relative pose error.
+        recentPairs_.push_back(pair);
+        while (recentPairs_.size() > 1 && recentPairs_[1].stamp <= pair.stamp - rpeDelta_)
+        {
+            recentPairs_.pop_front();
+        }
+        const PosePair &start = recentPairs_.front();
+        double elapsed = pair.stamp - start.stamp;
+        // gaps while tracking was lost would give errors over longer intervals.
+        if (elapsed < rpeDelta_ || elapsed > 1.5 * rpeDelta_)
+        {
+            return;
+        }
+        Eigen::Affine3d relativeGroundTruth = start.groundTruth.inverse() * pair.groundTruth;
+        Eigen::Affine3d relativeEstimate = start.estimate.inverse() * pair.estimate;
+        Eigen::Affine3d error = relativeGroundTruth.inverse() * relativeEstimate;
+        rpePairs_++;
+        sumRpeTranslation2_ += error.translation().squaredNorm();
+        double angle = Eigen::AngleAxisd(Eigen::Quaterniond(error.linear()).normalized()).angle();
+        sumRpeRotation2_ += angle * angle;
+    }
+
+    TrajectoryErrorStatistics TrajectoryEvaluator::getStatistics()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        TrajectoryErrorStatistics statistics;
+        statistics.pairs = pairs_;
+        statistics.unmatched = unmatched_;
+        statistics.rpePairs = rpePairs_;
+        if (rpePairs_ > 0)
+        {
+            statistics.rpeTranslationRmse = std::sqrt(sumRpeTranslation2_ / rpePairs_);
+            statistics.rpeRotationRmse = std::sqrt(sumRpeRotation2_ / rpePairs_);
+        }
+        if (pairs_ < 3)
+        {
+            return statistics;
+        }
+        // Umeyama without scale, from the running sums.
+        double n = static_cast<double>(pairs_);
+        Eigen::Vector3d meanP = sumP_ / n;
+        Eigen::Vector3d meanQ = sumQ_ / n;
+        Eigen::Matrix3d covariance = sumQP_ / n - meanQ * meanP.transpose();
+        Eigen::JacobiSVD<Eigen::Matrix3d> svd(covariance, Eigen::ComputeFullU | Eigen::ComputeFullV);
+        Eigen::Matrix3d S = Eigen::Matrix3d::Identity();
+        if (svd.matrixU().determinant() * svd.matrixV().determinant() < 0.0)
+        {
+            S(2, 2) = -1.0;
+        }
+        Eigen::Matrix3d R = svd.matrixU() * S * svd.matrixV().transpose();
+        Eigen::Vector3d t = meanQ - R * meanP;
+        // sum of |R (p - meanP) - (q - meanQ)|^2 expanded into the sums.
+        double spreadP = sumPP_ - n * meanP.squaredNorm();
+        double spreadQ = sumQQ_ - n * meanQ.squaredNorm();
+        double squaredError = spreadP + spreadQ - 2.0 * n * (R * covariance.transpose()).trace();
+        statistics.ateRmse = std::sqrt(std::max(0.0, squaredError) / n);
+        statistics.ateLast = (R * lastP_ + t - lastQ_).norm();
+        statistics.alignment.linear() = R;
+        statistics.alignment.translation() = t;
+        return statistics;
+    }
+}
@@ -0,0 +1,222 @@
+/**
+ * @file trajectory_logger.cpp
+ * @brief Implementation of the TrajectoryLogger class.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#include "trajectory_logger.hpp"
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+namespace ORB_SLAM3_Wrapper
+{
+    namespace
+    {
+        // a full batch is written without waiting for the flush period.
+        const size_t batchSize = 256;
+        const char binaryMagic[] = "ORBTRAJ1";
+
+        void writeTumPose(std::FILE *file, double stamp, const Eigen::Affine3d &pose)
+        {
+            Eigen::Quaterniond q(pose.linear());
+            const Eigen::Vector3d &t = pose.translation();
+            std::fprintf(file, "%.9f %.6f %.6f %.6f %.9f %.9f %.9f %.9f\n", stamp, t.x(), t.y(), t.z(), q.x(), q.y(), q.z(), q.w());
+        }
+
+        void appendPose(std::vector<unsigned char> &buffer, const Eigen::Affine3d &pose)
+        {
+            Eigen::Quaterniond q(pose.linear());
+            double values[7] = {pose.translation().x(), pose.translation().y(), pose.translation().z(), q.x(), q.y(), q.z(), q.w()};
+            const unsigned char *bytes = reinterpret_cast<const unsigned char *>(values);
+            buffer.insert(buffer.end(), bytes, bytes + sizeof(values));
+        }
+    }
+
+    TrajectoryLogger::TrajectoryLogger(const std::string &path, bool binary, double flushPeriod)
+        : path_(path),
+          binary_(binary),
+          flushPeriod_(flushPeriod > 0.0 ? flushPeriod : 1.0),
+          file_(nullptr),
+          stop_(false)
+    {
+        // keep the log of the last run, it may be the one of a crash.
+        std::rename(path_.c_str(), (path_ + ".old").c_str());
+        file_ = std::fopen(path_.c_str(), binary_ ? "wb" : "w");
+        if (!file_)
+        {
+            std::cerr << "Could not open the trajectory log " << path_ << ": " << std::strerror(errno) << std::endl;
+            statistics_.failed = true;
+        }
+        else if (binary_)
+        {
+            std::fwrite(binaryMagic, 1, sizeof(binaryMagic) - 1, file_);
+        }
+        else
+        {
+            std::fprintf(file_, "# timestamp tx ty tz qx qy qz qw\n");
+        }
+        worker_ = std::thread(&TrajectoryLogger::run, this);
+    }
+
+    TrajectoryLogger::~TrajectoryLogger()
+    {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex_);
+            stop_ = true;
+        }
+        queueCondition_.notify_all();
+        worker_.join();
+        if (file_)
+        {
+            std::fclose(file_);
+        }
+    }
+
+    void TrajectoryLogger::log(const TrajectoryRecord &record)
+    {
+        bool batchFull;
+        {
+            std::lock_guard<std::mutex> lock(queueMutex_);
+            queue_.push_back(record);
+            statistics_.records++;
+            statistics_.pending = queue_.size();
+            batchFull = queue_.size() >= batchSize;
+        }
+        if (batchFull)
+        {
+            queueCondition_.notify_one();
+        }
+    }
+
+    void TrajectoryLogger::exportCorrected(const std::string &path, std::shared_ptr<const KeyFramePoses> anchorPoses)
+    {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex_);
+            exports_.push_back({path, anchorPoses});
+        }
+        queueCondition_.notify_one();
+    }
+
+    TrajectoryLoggerStatistics TrajectoryLogger::getStatistics()
+    {
+        std::lock_guard<std::mutex> lock(queueMutex_);
+        return statistics_;
+    }
+
+    void TrajectoryLogger::run()
+    {
+        Records batch;
+        std::deque<ExportJob> exports;
+        std::unique_lock<std::mutex> lock(queueMutex_);
+        while (true)
+        {
+            queueCondition_.wait_for(lock, std::chrono::duration<double>(flushPeriod_), [this]()
+                                     { return stop_ || queue_.size() >= batchSize || !exports_.empty(); });
+            bool stop = stop_;
+            batch.swap(queue_);
+            exports.swap(exports_);
+            statistics_.pending = 0;
+            lock.unlock();
+
+            // the exports include the records logged before they were requested.
+            if (!batch.empty())
+            {
+                writeBatch(batch);
+                history_.insert(history_.end(), batch.begin(), batch.end());
+            }
+            for (const auto &job : exports)
+            {
+                writeCorrected(job);
+            }
+
+            lock.lock();
+            statistics_.written += batch.size();
+            statistics_.batches += batch.empty() ? 0 : 1;
+            statistics_.exports += exports.size();
+            batch.clear();
+            exports.clear();
+            if (stop && queue_.empty() && exports_.empty())
+            {
+                return;
+            }
+        }
+    }
+
+    void TrajectoryLogger::writeBatch(const Records &batch)
+    {
+        if (!file_)
+        {
+            return;
+        }
+        if (binary_)
+        {
+            std::vector<unsigned char> buffer;
+            buffer.reserve(batch.size() * (sizeof(double) + sizeof(int32_t) + sizeof(int64_t) + 14 * sizeof(double)));
+            for (const auto &record : batch)
+            {
+                int32_t state = record.trackingState;
+                int64_t anchorId = record.anchorId;
+                const unsigned char *stamp = reinterpret_cast<const unsigned char *>(&record.stamp);
+                buffer.insert(buffer.end(), stamp, stamp + sizeof(double));
+                buffer.insert(buffer.end(), reinterpret_cast<const unsigned char *>(&state), reinterpret_cast<const unsigned char *>(&state) + sizeof(state));
+                buffer.insert(buffer.end(), reinterpret_cast<const unsigned char *>(&anchorId), reinterpret_cast<const unsigned char *>(&anchorId) + sizeof(anchorId));
+                appendPose(buffer, record.pose);
+                appendPose(buffer, record.anchorRelative);
+            }
+            std::fwrite(buffer.data(), 1, buffer.size(), file_);
+        }
+        else
+        {
+            for (const auto &record : batch)
+            {
+                if (record.anchorId < 0)
+                {
+                    std::fprintf(file_, "# %.9f state %d\n", record.stamp, record.trackingState);
+                }
+                else
+                {
+                    writeTumPose(file_, record.stamp, record.pose);
+                }
+            }
+        }
+        // handed to the kernel, so the batch survives a crash of the process.
+        if (std::fflush(file_) != 0)
+        {
+            std::lock_guard<std::mutex> lock(queueMutex_);
+            statistics_.failed = true;
+        }
+    }
+
+    void TrajectoryLogger::writeCorrected(const ExportJob &job)
+    {
+        std::FILE *file = std::fopen(job.path.c_str(), "w");
+        if (!file)
+        {
+            std::cerr << "Could not export the trajectory to " << job.path << ": " << std::strerror(errno) << std::endl;
+            return;
+        }
+        std::fprintf(file, "# timestamp tx ty tz qx qy qz qw\n");
+        for (const auto &record : history_)
+        {
+            if (record.anchorId < 0)
+            {
+                continue;
+            }
+            auto anchor = job.anchorPoses->find(record.anchorId);
+            if (anchor != job.anchorPoses->end())
+            {
+                writeTumPose(file, record.stamp, anchor->second * record.anchorRelative);
+            }
+            else
+            {
+                writeTumPose(file, record.stamp, record.pose);
+            }
+        }
+        std::fclose(file);
+        std::cout << "Exported " << history_.size() << " trajectory records to " << job.path << std::endl;
+    }
+}
@@ -0,0 +1,361 @@
+/**
+ * @file tsdf_fusion.cpp
+ * @brief Implementation of the TsdfFusion class.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#include "tsdf_fusion.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+#include <cv_bridge/cv_bridge.h>
+#include <opencv2/core/persistence.hpp>
+
+namespace ORB_SLAM3_Wrapper
+{
+    bool DepthCameraIntrinsics::fromSettingsFile(const std::string &settingsFile, DepthCameraIntrinsics &intrinsics)
+    {
+        cv::FileStorage fsSettings(settingsFile, cv::FileStorage::READ);
+        if (!fsSettings.isOpened())
+        {
+            return false;
+        }
+        // settings files of ORB-SLAM3 v1.0 use Camera1.*, older ones Camera.*.
+        std::string prefix = fsSettings["Camera1.fx"].empty() ? "Camera." : "Camera1.";
+        intrinsics.fx = (float)fsSettings[prefix + "fx"];
+        intrinsics.fy = (float)fsSettings[prefix + "fy"];
+        intrinsics.cx = (float)fsSettings[prefix + "cx"];
+        intrinsics.cy = (float)fsSettings[prefix + "cy"];
+        cv::FileNode depthMapFactor = fsSettings["RGBD.DepthMapFactor"].empty() ? fsSettings["DepthMapFactor"] : fsSettings["RGBD.DepthMapFactor"];
+        intrinsics.depthMapFactor = depthMapFactor.empty() ? 1.0f : (float)depthMapFactor;
+        if (std::abs(intrinsics.depthMapFactor) < 1e-5f)
+        {
+            intrinsics.depthMapFactor = 1.0f;
+        }
+        return intrinsics.fx > 0.0f && intrinsics.fy > 0.0f;
+    }
+
+    TsdfFusion::TsdfFusion(const DepthCameraIntrinsics &intrinsics, float voxelSize, float truncation, float maxDepth, int pixelStride,
+                           size_t maxKeyFrames)
+        : intrinsics_(intrinsics),
+          voxelSize_(voxelSize),
+          truncation_(truncation),
+          maxDepth_(maxDepth),
+          pixelStride_(std::max(1, pixelStride)),
+          maxKeyFrames_(maxKeyFrames),
+          stop_(false)
+    {
+        for (int z = 0; z < blockSide; z++)
+        {
+            for (int y = 0; y < blockSide; y++)
+            {
+                for (int x = 0; x < blockSide; x++)
+                {
+                    voxelOffsets_.col((z * blockSide + y) * blockSide + x) = (Eigen::Vector3f(x, y, z) + Eigen::Vector3f::Constant(0.5f)) * voxelSize_;
+                }
+            }
+        }
+        worker_ = std::thread(&TsdfFusion::run, this);
+    }
+
+    TsdfFusion::~TsdfFusion()
+    {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex_);
+            stop_ = true;
+        }
+        queueCondition_.notify_all();
+        worker_.join();
+    }
+
+    void TsdfFusion::addKeyFrame(long unsigned int kFId, const Eigen::Affine3d &pose, const sensor_msgs::msg::Image::SharedPtr depth)
+    {
+        std::shared_ptr<Job> job(new Job());
+        job->kFId = kFId;
+        job->pose = pose;
+        job->depth = depth;
+        {
+            std::lock_guard<std::mutex> lock(queueMutex_);
+            jobs_.push_back(job);
+        }
+        queueCondition_.notify_one();
+    }
+
+    void TsdfFusion::updatePoses(const KeyFramePoses &poses, const std::vector<long unsigned int> &removedKeyFrames)
+    {
+        std::shared_ptr<Job> job(new Job());
+        job->poses = std::make_shared<KeyFramePoses>(poses);
+        job->removedKeyFrames = removedKeyFrames;
+        {
+            std::lock_guard<std::mutex> lock(queueMutex_);
+            // the update goes behind the queued keyframes, a removed keyframe may be one of them.
+            for (auto it = jobs_.begin(); it != jobs_.end(); ++it)
+            {
+                if ((*it)->poses)
+                {
+                    job->removedKeyFrames.insert(job->removedKeyFrames.end(), (*it)->removedKeyFrames.begin(), (*it)->removedKeyFrames.end());
+                    jobs_.erase(it);
+                    break;
+                }
+            }
+            jobs_.push_back(job);
+        }
+        queueCondition_.notify_one();
+    }
+
+    void TsdfFusion::run()
+    {
+        while (true)
+        {
+            std::shared_ptr<Job> job;
+            {
+                std::unique_lock<std::mutex> lock(queueMutex_);
+                queueCondition_.wait(lock, [this]()
+                                     { return stop_ || !jobs_.empty(); });
+                if (stop_)
+                {
+                    return;
+                }
+                job = jobs_.front();
+                jobs_.pop_front();
+            }
+            if (job->poses)
+            {
+                processPoses(*job->poses, job->removedKeyFrames);
+                continue;
+            }
+            KeyFrameDepth keyFrame;
+            keyFrame.pose = job->pose;
+            if (!prepareDepth(job->depth, keyFrame.depth))
+            {
+                continue;
+            }
+            auto start = std::chrono::steady_clock::now();
+            std::lock_guard<std::mutex> lock(volumeMutex_);
+            auto existing = keyFrames_.find(job->kFId);
+            if (existing != keyFrames_.end())
+            {
+                integrate(existing->second, -1.0f);
+            }
+            integrate(keyFrame, 1.0f);
+            keyFrames_[job->kFId] = keyFrame;
+            // the oldest keyframes are the least likely to be corrected again.
+            while (maxKeyFrames_ > 0 && keyFrames_.size() > maxKeyFrames_)
+            {
+                keyFrames_.erase(keyFrames_.begin());
+                statistics_.frozenKeyFrames++;
+            }
+            statistics_.lastIntegrationMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+    }
+
+    void TsdfFusion::processPoses(const KeyFramePoses &poses, const std::vector<long unsigned int> &removedKeyFrames)
+    {
+        for (auto kFId : removedKeyFrames)
+        {
+            auto keyFrame = keyFrames_.find(kFId);
+            if (keyFrame == keyFrames_.end())
+            {
+                continue;
+            }
+            std::lock_guard<std::mutex> lock(volumeMutex_);
+            integrate(keyFrame->second, -1.0f);
+            keyFrames_.erase(keyFrame);
+            statistics_.removedKeyFrames++;
+        }
+        // keyframes missing from the poses (not in a map yet) keep the geometry they observed.
+        for (auto &keyFrame : keyFrames_)
+        {
+            auto pose = poses.find(keyFrame.first);
+            if (pose == poses.end())
+            {
+                continue;
+            }
+            Eigen::Affine3d delta = keyFrame.second.pose.inverse() * pose->second;
+            if (delta.translation().norm() < 0.5 * voxelSize_ && Eigen::AngleAxisd(delta.rotation()).angle() < 0.01)
+            {
+                continue;
+            }
+            // one keyframe at a time, so that exports are not blocked for the whole correction.
+            std::lock_guard<std::mutex> lock(volumeMutex_);
+            integrate(keyFrame.second, -1.0f);
+            keyFrame.second.pose = pose->second;
+            integrate(keyFrame.second, 1.0f);
+            statistics_.reintegratedKeyFrames++;
+        }
+    }
+
+    bool TsdfFusion::prepareDepth(const sensor_msgs::msg::Image::SharedPtr msg, cv::Mat &depth)
+    {
+        cv_bridge::CvImageConstPtr cvDepth;
+        try
+        {
+            cvDepth = cv_bridge::toCvShare(msg);
+        }
+        catch (cv_bridge::Exception &e)
+        {
+            std::cerr << "cv_bridge exception in the TSDF fusion!" << std::endl;
+            return false;
+        }
+        const cv::Mat &raw = cvDepth->image;
+        if (raw.type() != CV_16UC1 && raw.type() != CV_32FC1)
+        {
+            std::cerr << "Depth image type " << raw.type() << " is not supported by the TSDF fusion." << std::endl;
+            return false;
+        }
+        depth.create(raw.rows / pixelStride_, raw.cols / pixelStride_, CV_32FC1);
+        for (int v = 0; v < depth.rows; v++)
+        {
+            float *row = depth.ptr<float>(v);
+            for (int u = 0; u < depth.cols; u++)
+            {
+                float d = raw.type() == CV_16UC1 ? raw.at<uint16_t>(v * pixelStride_, u * pixelStride_)
+                                                 : raw.at<float>(v * pixelStride_, u * pixelStride_);
+                d /= intrinsics_.depthMapFactor;
+                row[u] = std::isfinite(d) && d > 0.0f && d <= maxDepth_ ? d : 0.0f;
+            }
+        }
+        return true;
+    }
+
+    int64_t TsdfFusion::blockKey(const Eigen::Vector3i &index)
+    {
+        return ((static_cast<int64_t>(index.x()) & 0x1FFFFF) << 42) |
+               ((static_cast<int64_t>(index.y()) & 0x1FFFFF) << 21) |
+               (static_cast<int64_t>(index.z()) & 0x1FFFFF);
+    }
+
+    void TsdfFusion::integrate(const KeyFrameDepth &keyFrame, float sign)
+    {
+        const cv::Mat &depth = keyFrame.depth;
+        const float fx = intrinsics_.fx / pixelStride_, fy = intrinsics_.fy / pixelStride_;
+        const float cx = intrinsics_.cx / pixelStride_, cy = intrinsics_.cy / pixelStride_;
+        const float blockSize = blockSide * voxelSize_;
+
+        // the poses are in ROS convention (x forward), the depth image in the optical frame (z forward).
+        Eigen::Matrix3f rosToOptical;
+        rosToOptical << 0, -1, 0,
+            0, 0, -1,
+            1, 0, 0;
+        Eigen::Affine3f worldToOptical = Eigen::Affine3f(rosToOptical) * keyFrame.pose.inverse().cast<float>();
+        Eigen::Affine3f opticalToWorld = worldToOptical.inverse();
+
+        // blocks within the truncation band around the observed surface.
+        touched_.clear();
+        touchedIndices_.clear();
+        for (int v = 0; v < depth.rows; v++)
+        {
+            const float *row = depth.ptr<float>(v);
+            for (int u = 0; u < depth.cols; u++)
+            {
+                if (row[u] <= 0.0f)
+                {
+                    continue;
+                }
+                Eigen::Vector3f ray((u - cx) / fx, (v - cy) / fy, 1.0f);
+                for (float s = row[u] - truncation_; s <= row[u] + truncation_; s += 0.5f * blockSize)
+                {
+                    Eigen::Vector3f point = opticalToWorld * (ray * s);
+                    Eigen::Vector3i index = (point / blockSize).array().floor().cast<int>();
+                    if (touched_.insert(blockKey(index)).second)
+                    {
+                        touchedIndices_.push_back(index);
+                    }
+                }
+            }
+        }
+
+        // fixed size, so that nothing is allocated per block.
+        Eigen::Matrix<float, 3, blockVoxels> camera;
+        Eigen::Array<float, blockVoxels, 1> z, u, v, observation, mask;
+        for (const auto &index : touchedIndices_)
+        {
+            int64_t key = blockKey(index);
+            auto it = blocks_.find(key);
+            if (it == blocks_.end())
+            {
+                if (sign < 0.0f)
+                {
+                    continue;
+                }
+                std::unique_ptr<Block> block(new Block());
+                block->index = index;
+                block->tsdf.setOnes();
+                block->weight.setZero();
+                it = blocks_.emplace(key, std::move(block)).first;
+            }
+            Block &block = *it->second;
+
+            // project all voxels of the block at once.
+            Eigen::Vector3f origin = index.cast<float>() * blockSize;
+            camera.noalias() = worldToOptical.linear() * voxelOffsets_;
+            camera.colwise() += worldToOptical * origin;
+            z = camera.row(2).transpose().array();
+            u = (camera.row(0).transpose().array() / z) * fx + cx + 0.5f;
+            v = (camera.row(1).transpose().array() / z) * fy + cy + 0.5f;
+
+            // the depth lookup is a gather, everything else is done on whole arrays.
+            mask.setZero();
+            observation.setZero();
+            for (int i = 0; i < blockVoxels; i++)
+            {
+                int ui = static_cast<int>(std::floor(u(i))), vi = static_cast<int>(std::floor(v(i)));
+                if (z(i) <= 0.0f || ui < 0 || vi < 0 || ui >= depth.cols || vi >= depth.rows)
+                {
+                    continue;
+                }
+                float d = depth.at<float>(vi, ui);
+                float sdf = d - z(i);
+                if (d <= 0.0f || sdf < -truncation_)
+                {
+                    continue;
+                }
+                observation(i) = std::min(1.0f, sdf / truncation_);
+                mask(i) = sign;
+            }
+            Eigen::Array<float, blockVoxels, 1> weight = block.weight + mask;
+            Eigen::Array<float, blockVoxels, 1> tsdf = (block.tsdf * block.weight + observation * mask) / weight.max(1e-6f);
+            block.tsdf = (weight > 0.0f).select(tsdf, 1.0f);
+            block.weight = weight.max(0.0f);
+            if (sign < 0.0f && (block.weight <= 0.0f).all())
+            {
+                blocks_.erase(it);
+            }
+        }
+        statistics_.blocks = blocks_.size();
+    }
+
+    void TsdfFusion::extractSurfacePoints(std::vector<Eigen::Vector3f> &points, float minWeight)
+    {
+        points.clear();
+        const float blockSize = blockSide * voxelSize_;
+        std::lock_guard<std::mutex> lock(volumeMutex_);
+        for (const auto &entry : blocks_)
+        {
+            const Block &block = *entry.second;
+            Eigen::Vector3f origin = block.index.cast<float>() * blockSize;
+            for (int i = 0; i < blockVoxels; i++)
+            {
+                if (block.weight(i) >= minWeight && std::abs(block.tsdf(i)) * truncation_ < voxelSize_)
+                {
+                    points.push_back(origin + voxelOffsets_.col(i));
+                }
+            }
+        }
+    }
+
+    TsdfStatistics TsdfFusion::getStatistics()
+    {
+        TsdfStatistics statistics;
+        {
+            std::lock_guard<std::mutex> lock(volumeMutex_);
+            statistics = statistics_;
+            statistics.keyFrames = keyFrames_.size();
+        }
+        std::lock_guard<std::mutex> lock(queueMutex_);
+        statistics.pendingJobs = jobs_.size();
+        return statistics;
+    }
+}
@@ -106,6 +106,13 @@ namespace ORB_SLAM3_Wrapper
     }
 
     sensor_msgs::msg::PointCloud2 WrapperTypeConversions::MapPointsToPCL(std::vector<Eigen::Vector3f>& mapPoints)
+    {
+        sensor_msgs::msg::PointCloud2 cloud;
+        MapPointsToPCL(mapPoints, cloud);
+        return cloud;
+    }
+
+    void WrapperTypeConversions::MapPointsToPCL(const std::vector<Eigen::Vector3f> &mapPoints, sensor_msgs::msg::PointCloud2 &cloud)
     {
         const int numChannels = 3; // x y z
 
@@ -114,8 +121,6 @@ namespace ORB_SLAM3_Wrapper
             std::cout << "Map point vector is empty!" << std::endl;
         }
 
-        sensor_msgs::msg::PointCloud2 cloud;
-
         // cloud.header.stamp = current_frame_time;
         cloud.header.frame_id = "map";
         cloud.height = 1;
@@ -136,13 +141,18 @@ namespace ORB_SLAM3_Wrapper
             cloud.fields[i].datatype = sensor_msgs::msg::PointField::FLOAT32;
         }
 
+        // the data keeps its capacity, it only reallocates if the map grew past the largest snapshot so far.
         cloud.data.resize(cloud.row_step * cloud.height);
+        if (cloud.data.empty())
+        {
+            return;
+        }
 
         unsigned char *cloud_data_ptr = &(cloud.data[0]);
 
         for (unsigned int i = 0; i < cloud.width; i++)
         {
-            Eigen::Vector3f point_translation = mapPoints[i];
+            const Eigen::Vector3f &point_translation = mapPoints[i];
 
             float data_array[numChannels] = {
                 point_translation.x(), point_translation.y(), point_translation.z()};
@@ -150,7 +160,6 @@ namespace ORB_SLAM3_Wrapper
             memcpy(cloud_data_ptr + (i * cloud.point_step), data_array,
                     numChannels * sizeof(float));
         }
-        return cloud;
     }
 
     template <>
@@ -0,0 +1,129 @@
+/**
+ * @file test_map_conversions.cpp
+ * @brief Checks that the map exports are converted into reused messages without heap allocations.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <vector>
+
+#include "allocation_counter.hpp"
+#include "map_type_adapters.hpp"
+#include "type_conversion.hpp"
+
+using namespace ORB_SLAM3_Wrapper;
+
+namespace
+{
+    std::vector<Eigen::Vector3f> makePoints(size_t numPoints)
+    {
+        std::vector<Eigen::Vector3f> points;
+        for (size_t i = 0; i < numPoints; i++)
+        {
+            points.emplace_back(0.01f * i, -0.02f * i, 1.0f + 0.001f * i);
+        }
+        return points;
+    }
+
+    // allocations of the calling thread while function runs.
+    template <typename Function>
+    unsigned long long countAllocations(Function function)
+    {
+        AllocationCounter::setEnabled(true);
+        AllocationCount before = AllocationCounter::thread();
+        function();
+        AllocationCount after = AllocationCounter::thread();
+        AllocationCounter::setEnabled(false);
+        return after.allocations - before.allocations;
+    }
+}
+
+TEST(MapConversions, CounterSeesAllocations)
+{
+    // guards the other tests against a counter which never counts.
+    std::unique_ptr<std::vector<int>> allocated;
+    EXPECT_GT(countAllocations([&allocated]()
+                               { allocated.reset(new std::vector<int>(16)); }),
+              0u);
+}
+
+TEST(MapConversions, MapPointsToPCLReusesTheMessage)
+{
+    WrapperTypeConversions conversions;
+    std::vector<Eigen::Vector3f> points = makePoints(1000);
+    sensor_msgs::msg::PointCloud2 cloud;
+    conversions.MapPointsToPCL(points, cloud);
+
+    EXPECT_EQ(countAllocations([&]()
+                               { conversions.MapPointsToPCL(points, cloud); }),
+              0u);
+    ASSERT_EQ(cloud.width, points.size());
+    ASSERT_EQ(cloud.data.size(), points.size() * 3 * sizeof(float));
+    const float *last = reinterpret_cast<const float *>(cloud.data.data()) + 3 * (points.size() - 1);
+    EXPECT_FLOAT_EQ(last[0], points.back().x());
+    EXPECT_FLOAT_EQ(last[1], points.back().y());
+    EXPECT_FLOAT_EQ(last[2], points.back().z());
+}
+
+TEST(MapConversions, SmallerMapReusesTheMessage)
+{
+    WrapperTypeConversions conversions;
+    std::vector<Eigen::Vector3f> points = makePoints(1000);
+    sensor_msgs::msg::PointCloud2 cloud;
+    conversions.MapPointsToPCL(points, cloud);
+
+    // culling shrinks the map, the buffers of the larger snapshot are kept.
+    points.resize(400);
+    EXPECT_EQ(countAllocations([&]()
+                               { conversions.MapPointsToPCL(points, cloud); }),
+              0u);
+    EXPECT_EQ(cloud.width, points.size());
+}
+
+TEST(MapConversions, MapPointArrayAdapterReusesTheMessage)
+{
+    MapPointArray array;
+    array.header.frame_id = "map";
+    array.points = std::make_shared<const std::vector<Eigen::Vector3f>>(makePoints(500));
+    sensor_msgs::msg::PointCloud2 cloud;
+    MapPointArrayAdapter::convert_to_ros_message(array, cloud);
+
+    EXPECT_EQ(countAllocations([&]()
+                               { MapPointArrayAdapter::convert_to_ros_message(array, cloud); }),
+              0u);
+    EXPECT_EQ(cloud.header.frame_id, "map");
+
+    MapPointArray converted;
+    MapPointArrayAdapter::convert_to_custom(cloud, converted);
+    ASSERT_TRUE(converted.points);
+    ASSERT_EQ(converted.points->size(), array.points->size());
+    EXPECT_TRUE(converted.points->back().isApprox(array.points->back()));
+}
+
+TEST(MapConversions, KeyFramePoseArrayAdapterReusesTheMessage)
+{
+    auto poses = std::make_shared<KeyFramePoses>();
+    for (long unsigned int kFId = 3; kFId < 203; kFId++)
+    {
+        (*poses)[kFId] = Eigen::Translation3d(0.1 * kFId, 0.0, 0.0) * Eigen::AngleAxisd(0.01 * kFId, Eigen::Vector3d::UnitZ());
+    }
+    KeyFramePoseArray array;
+    array.header.frame_id = "map";
+    array.poses = poses;
+    slam_msgs::msg::MapGraph graph;
+    KeyFramePoseArrayAdapter::convert_to_ros_message(array, graph);
+
+    EXPECT_EQ(countAllocations([&]()
+                               { KeyFramePoseArrayAdapter::convert_to_ros_message(array, graph); }),
+              0u);
+
+    // the keyframe IDs survive the round trip.
+    KeyFramePoseArray converted;
+    KeyFramePoseArrayAdapter::convert_to_custom(graph, converted);
+    ASSERT_TRUE(converted.poses);
+    ASSERT_EQ(converted.poses->size(), poses->size());
+    EXPECT_EQ(converted.poses->begin()->first, 3u);
+    EXPECT_TRUE(converted.poses->at(202).isApprox(poses->at(202)));
+}
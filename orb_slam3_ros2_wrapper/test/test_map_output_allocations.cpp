@@ -0,0 +1,199 @@
+/**
+ * @file test_map_output_allocations.cpp
+ * @brief Publishes the cached map outputs to intra-process subscriptions under the AllocationCounter, like the node does.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <vector>
+
+#include <rclcpp/rclcpp.hpp>
+
+#include "allocation_counter.hpp"
+#include "map_output_cache.hpp"
+#include "stage_timer.hpp"
+
+using namespace ORB_SLAM3_Wrapper;
+
+namespace
+{
+    // the first publishes create the stage entry and the publisher and subscription state.
+    const int warmupFrames = 7;
+    const int steadyFrames = 50;
+
+    /**
+     * @brief The map outputs of the node, with intra-process subscriptions which keep the last message.
+     */
+    class MapOutputLoop
+    {
+    public:
+        MapOutputLoop()
+            : node_(std::make_shared<rclcpp::Node>("map_output_allocations", rclcpp::NodeOptions().use_intra_process_comms(true))),
+              exports_(0)
+        {
+            mapPointsPub_ = node_->create_publisher<MapPointArrayAdapter>("map_points", 10);
+            keyFramePosesPub_ = node_->create_publisher<KeyFramePoseArrayAdapter>("keyframe_poses", 10);
+            mapPointsSub_ = node_->create_subscription<MapPointArrayAdapter>(
+                "map_points", 10, [this](std::unique_ptr<MapPointArray> msg)
+                { lastMapPoints_ = std::move(msg); });
+            keyFramePosesSub_ = node_->create_subscription<KeyFramePoseArrayAdapter>(
+                "keyframe_poses", 10, [this](std::unique_ptr<KeyFramePoseArray> msg)
+                { lastKeyFramePoses_ = std::move(msg); });
+            executor_.add_node(node_);
+        }
+
+        /**
+         * @brief The body of RgbdSlamNode::publishMapPointCloud, with a synthetic map per version.
+         */
+        void run(unsigned long version)
+        {
+            ScopedStage stage(stageTimer_, "map_points");
+            mapOutputCache_.update(version,
+                                   [this, version](std::vector<Eigen::Vector3f> &points, KeyFramePoses &keyFramePoses)
+                                   {
+                                       exports_++;
+                                       points.clear();
+                                       for (int i = 0; i < 1000; i++)
+                                       {
+                                           points.emplace_back(0.01f * i, 0.02f * version, 1.0f);
+                                       }
+                                       for (long unsigned int kFId = 0; kFId < 100; kFId++)
+                                       {
+                                           keyFramePoses[kFId] = Eigen::Translation3d(0.1 * kFId, 0.0, 0.0) * Eigen::Quaterniond::Identity();
+                                       }
+                                   });
+            mapOutputCache_.publish(rclcpp::Time(static_cast<int32_t>(version), 0), "map", *mapPointsPub_, *keyFramePosesPub_);
+        }
+
+        /**
+         * @brief Delivers the published messages to the subscriptions.
+         */
+        void spin()
+        {
+            executor_.spin_all(std::chrono::milliseconds(100));
+        }
+
+        /**
+         * @brief Lets the subscriptions release the messages they hold.
+         */
+        void release()
+        {
+            lastMapPoints_.reset();
+            lastKeyFramePoses_.reset();
+        }
+
+        MapOutputCache &getCache()
+        {
+            return mapOutputCache_;
+        }
+
+        StageTimer &getStageTimer()
+        {
+            return stageTimer_;
+        }
+
+        const MapPointArray *getLastMapPoints()
+        {
+            return lastMapPoints_.get();
+        }
+
+        const KeyFramePoseArray *getLastKeyFramePoses()
+        {
+            return lastKeyFramePoses_.get();
+        }
+
+        int getExports()
+        {
+            return exports_;
+        }
+
+    private:
+        rclcpp::Node::SharedPtr node_;
+        rclcpp::executors::SingleThreadedExecutor executor_;
+        rclcpp::Publisher<MapPointArrayAdapter>::SharedPtr mapPointsPub_;
+        rclcpp::Publisher<KeyFramePoseArrayAdapter>::SharedPtr keyFramePosesPub_;
+        rclcpp::Subscription<MapPointArrayAdapter>::SharedPtr mapPointsSub_;
+        rclcpp::Subscription<KeyFramePoseArrayAdapter>::SharedPtr keyFramePosesSub_;
+        std::unique_ptr<MapPointArray> lastMapPoints_;
+        std::unique_ptr<KeyFramePoseArray> lastKeyFramePoses_;
+        MapOutputCache mapOutputCache_;
+        StageTimer stageTimer_;
+        int exports_;
+    };
+
+    class MapOutputAllocations : public ::testing::Test
+    {
+    protected:
+        static void SetUpTestSuite()
+        {
+            rclcpp::init(0, nullptr);
+        }
+
+        static void TearDownTestSuite()
+        {
+            rclcpp::shutdown();
+        }
+    };
+}
+
+TEST_F(MapOutputAllocations, SteadyStatePublishesOnlyAllocateThePublishedArrays)
+{
+    MapOutputLoop loop;
+    for (int frame = 0; frame < warmupFrames; frame++)
+    {
+        loop.run(1);
+    }
+    loop.spin();
+
+    AllocationCounter::setEnabled(true);
+    AllocationCount before = AllocationCounter::thread();
+    unsigned long long stageAllocations = 0;
+    for (int frame = 0; frame < steadyFrames; frame++)
+    {
+        loop.run(1);
+        stageAllocations += loop.getStageTimer().get("map_points").lastAllocations;
+    }
+    AllocationCount after = AllocationCounter::thread();
+    AllocationCounter::setEnabled(false);
+
+    // the unique_ptr handed to each subscription is freed there, it is the only allocation of a publish.
+    // the points, the poses and the short frame ID are shared or kept, nothing else in the publish path allocates.
+    EXPECT_EQ(loop.getExports(), 1);
+    EXPECT_EQ(stageAllocations, 2u * steadyFrames);
+    EXPECT_EQ(after.allocations - before.allocations, 2u * steadyFrames);
+    EXPECT_EQ(after.bytes - before.bytes, steadyFrames * (sizeof(MapPointArray) + sizeof(KeyFramePoseArray)));
+
+    // the subscriptions got the exports of the cache, not copies.
+    loop.spin();
+    ASSERT_NE(loop.getLastMapPoints(), nullptr);
+    ASSERT_NE(loop.getLastKeyFramePoses(), nullptr);
+    EXPECT_EQ(loop.getLastMapPoints()->points, loop.getCache().getMapPoints().points);
+    EXPECT_EQ(loop.getLastKeyFramePoses()->poses, loop.getCache().getKeyFramePoses().poses);
+    EXPECT_EQ(loop.getLastMapPoints()->points->size(), 1000u);
+}
+
+TEST_F(MapOutputAllocations, HeldPointsAreNotRefilled)
+{
+    MapOutputLoop loop;
+    loop.run(1);
+    loop.spin();
+    ASSERT_NE(loop.getLastMapPoints(), nullptr);
+    const std::vector<Eigen::Vector3f> *firstPoints = loop.getLastMapPoints()->points.get();
+
+    // the subscription still holds the points of version 1, so version 2 is exported into new ones.
+    loop.run(2);
+    const std::vector<Eigen::Vector3f> *secondPoints = loop.getCache().getMapPoints().points.get();
+    EXPECT_NE(secondPoints, firstPoints);
+    EXPECT_EQ(loop.getLastMapPoints()->points.get(), firstPoints);
+    EXPECT_FLOAT_EQ(firstPoints->front().y(), 0.02f);
+
+    // once released, the points of the last export are refilled in place.
+    loop.spin();
+    loop.release();
+    loop.run(3);
+    EXPECT_EQ(loop.getCache().getMapPoints().points.get(), secondPoints);
+    EXPECT_FLOAT_EQ(secondPoints->front().y(), 0.06f);
+    EXPECT_EQ(loop.getExports(), 3);
+}
@@ -0,0 +1,129 @@
+/**
+ * @file test_stage_allocations.cpp
+ * @brief Drives a per frame loop of timed stages under the AllocationCounter, like the replay does with a recording.
+ * @author Suchetan R S (rssuchetan@gmail.com)
+ */
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <vector>
+
+#include "allocation_counter.hpp"
+#include "map_type_adapters.hpp"
+#include "stage_timer.hpp"
+#include "type_conversion.hpp"
+
+using namespace ORB_SLAM3_Wrapper;
+
+namespace
+{
+    // the first frames create the stage entries and grow the buffers to the largest map (frame % 7 == 6),
+    // like the map initialization in the replay.
+    const int warmupFrames = 7;
+    const int steadyFrames = 50;
+
+    /**
+     * @brief Per frame work of the node outputs, all of it into buffers which are reused across frames.
+     */
+    class FrameLoop
+    {
+    public:
+        FrameLoop()
+        {
+            points_.reserve(2000);
+            auto poses = std::make_shared<KeyFramePoses>();
+            for (long unsigned int kFId = 0; kFId < 100; kFId++)
+            {
+                (*poses)[kFId] = Eigen::Translation3d(0.1 * kFId, 0.0, 0.0) * Eigen::Quaterniond::Identity();
+            }
+            keyFramePoses_.header.frame_id = "map";
+            keyFramePoses_.poses = poses;
+        }
+
+        void run(int frame)
+        {
+            {
+                ScopedStage stage(stageTimer_, "map_points");
+                // the map grows and shrinks between the frames, but stays within the reserved size.
+                points_.clear();
+                for (int i = 0; i < 1000 + (frame % 7) * 100; i++)
+                {
+                    points_.emplace_back(0.01f * i, 0.02f * frame, 1.0f);
+                }
+                conversions_.MapPointsToPCL(points_, cloud_);
+            }
+            {
+                ScopedStage stage(stageTimer_, "keyframe_poses");
+                KeyFramePoseArrayAdapter::convert_to_ros_message(keyFramePoses_, graph_);
+            }
+        }
+
+        StageTimer &getStageTimer()
+        {
+            return stageTimer_;
+        }
+
+    private:
+        StageTimer stageTimer_;
+        WrapperTypeConversions conversions_;
+        std::vector<Eigen::Vector3f> points_;
+        sensor_msgs::msg::PointCloud2 cloud_;
+        KeyFramePoseArray keyFramePoses_;
+        slam_msgs::msg::MapGraph graph_;
+    };
+}
+
+TEST(StageAllocations, SteadyStateFramesDoNotAllocate)
+{
+    FrameLoop loop;
+    AllocationCounter::setEnabled(true);
+    int frame = 0;
+    for (; frame < warmupFrames; frame++)
+    {
+        loop.run(frame);
+    }
+    AllocationCount before = AllocationCounter::thread();
+    unsigned long long stageAllocations = 0;
+    for (; frame < warmupFrames + steadyFrames; frame++)
+    {
+        loop.run(frame);
+        stageAllocations += loop.getStageTimer().get("map_points").lastAllocations;
+        stageAllocations += loop.getStageTimer().get("keyframe_poses").lastAllocations;
+    }
+    AllocationCount after = AllocationCounter::thread();
+    AllocationCounter::setEnabled(false);
+
+    // the stages and the bookkeeping of the timer around them.
+    EXPECT_EQ(stageAllocations, 0u);
+    EXPECT_EQ(after.allocations - before.allocations, 0u);
+    StageStatistics mapPoints = loop.getStageTimer().get("map_points");
+    EXPECT_EQ(mapPoints.count, static_cast<unsigned long>(warmupFrames + steadyFrames));
+}
+
+TEST(StageAllocations, AllocatingStageIsReported)
+{
+    StageTimer stageTimer;
+    AllocationCounter::setEnabled(true);
+    for (int frame = 0; frame < warmupFrames + 1; frame++)
+    {
+        ScopedStage stage(stageTimer, "allocating");
+        std::unique_ptr<std::vector<float>> buffer(new std::vector<float>(64));
+    }
+    AllocationCounter::setEnabled(false);
+
+    StageStatistics statistics = stageTimer.get("allocating");
+    EXPECT_EQ(statistics.lastAllocations, 2u);
+    EXPECT_EQ(statistics.totalAllocations, 2u * (warmupFrames + 1));
+    EXPECT_GE(statistics.totalAllocatedBytes, (64 * sizeof(float) + sizeof(std::vector<float>)) * (warmupFrames + 1));
+}
+
+TEST(StageAllocations, DisabledCounterReportsNothing)
+{
+    StageTimer stageTimer;
+    {
+        ScopedStage stage(stageTimer, "allocating");
+        std::unique_ptr<std::vector<float>> buffer(new std::vector<float>(64));
+    }
+    EXPECT_EQ(stageTimer.get("allocating").totalAllocations, 0u);
+}